@@ -15,7 +15,9 @@ DEFINE_string(arc_filter, "any",
               "this only affects the counts of (co)accessible states, "
               "connected states, and (strongly) connected components");
 DEFINE_string(info_type, "auto",
-              "Info format: one of: \"auto\", \"long\", \"short\"");
+              "Info format: one of: \"auto\", \"fast\", \"long\", "
+              "\"short\"; \"fast\" skips verification, property testing "
+              "and the connectivity counts");
 DEFINE_bool(pipe, false, "Send info to stderr, input to stdout");
 DEFINE_bool(test_properties, true,
             "Compute property values (if unknown to FST)");
@@ -0,0 +1,102 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Renumbers the states of an FST for memory locality.
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fst/compat.h>
+#include <fst/script/getters.h>
+#include <fst/script/state-reorder.h>
+
+DEFINE_string(reorder_type, "bfs",
+              "State order: one of: \"bfs\", \"dfs\", \"profile\"");
+DEFINE_string(profile, "",
+              "Trace of visited input states, as whitespace-separated state "
+              "IDs; required by \"profile\" and used by --report");
+DEFINE_int64(states_per_page, 256,
+             "Number of consecutive states assumed to share a page");
+DEFINE_bool(report, false,
+            "Print the page locality before and after reordering to stderr");
+
+int main(int argc, char **argv) {
+  namespace s = fst::script;
+  using fst::script::MutableFstClass;
+
+  string usage = "Renumbers the states of an FST for memory locality.\n\n"
+                 "  Usage: ";
+  usage += argv[0];
+  usage += " [in.fst [out.fst]]\n";
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(usage.c_str(), &argc, &argv, true);
+  if (argc > 3) {
+    ShowUsage();
+    return 1;
+  }
+
+  string in_name = (argc > 1 && (strcmp(argv[1], "-") != 0)) ? argv[1] : "";
+  string out_name = argc > 2 ? argv[2] : "";
+
+  fst::StateReorderType reorder_type;
+  if (!s::GetStateReorderType(FLAGS_reorder_type, &reorder_type)) {
+    LOG(ERROR) << argv[0] << ": Unknown or unsupported reorder type: "
+               << FLAGS_reorder_type;
+    return 1;
+  }
+  if (reorder_type == fst::PROFILE_STATE_REORDER && FLAGS_profile.empty()) {
+    LOG(ERROR) << argv[0] << ": Profile reorder type requires --profile";
+    return 1;
+  }
+
+  std::unique_ptr<MutableFstClass> fst(MutableFstClass::Read(in_name, true));
+  if (!fst) return 1;
+
+  std::vector<int64> trace;
+  std::vector<size_t> counts;
+  if (!FLAGS_profile.empty()) {
+    std::ifstream strm(FLAGS_profile);
+    if (!strm) {
+      LOG(ERROR) << argv[0] << ": Open failed, file = " << FLAGS_profile;
+      return 1;
+    }
+    counts.resize(fst->NumStates(), 0);
+    for (int64 s; strm >> s;) {
+      if (s < 0 || s >= fst->NumStates()) {
+        LOG(ERROR) << argv[0] << ": Bad state ID in profile: " << s;
+        return 1;
+      }
+      trace.push_back(s);
+      ++counts[s];
+    }
+  }
+
+  double locality = 0.0;
+  if (FLAGS_report) locality = s::ArcPageLocality(*fst, FLAGS_states_per_page);
+
+  std::vector<int64> order;
+  if (!s::StateReorder(fst.get(), reorder_type,
+                       counts.empty() ? nullptr : &counts, &order)) {
+    return 1;
+  }
+
+  if (FLAGS_report) {
+    std::cerr << "arc page locality: " << locality << " -> "
+              << s::ArcPageLocality(*fst, FLAGS_states_per_page) << std::endl;
+    if (!trace.empty()) {
+      std::cerr << "trace page touches: "
+                << fst::TracePageTouches(trace, FLAGS_states_per_page)
+                << " -> "
+                << fst::TracePageTouches(trace, FLAGS_states_per_page, &order)
+                << std::endl;
+    }
+  }
+
+  fst->Write(out_name);
+
+  return 0;
+}
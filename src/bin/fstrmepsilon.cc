@@ -15,8 +15,8 @@ DEFINE_int64(nstate, fst::kNoStateId, "State number threshold");
 DEFINE_bool(reverse, false, "Perform in the reverse direction");
 DEFINE_string(weight, "", "Weight threshold");
 DEFINE_string(queue_type, "auto",
-              "Queue type: one of: \"auto\", "
-              "\"fifo\", \"lifo\", \"shortest\", \"state\", \"top\"");
+              "Queue type: one of: \"auto\", \"fifo\", \"lifo\", "
+              "\"radix\", \"shortest\", \"state\", \"top\"");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
@@ -15,8 +15,8 @@ DEFINE_bool(reverse, false, "Perform in the reverse direction");
 DEFINE_double(delta, fst::kDelta, "Comparison/quantization delta");
 DEFINE_int64(nstate, fst::kNoStateId, "State number threshold");
 DEFINE_string(queue_type, "auto",
-              "Queue type: one of: \"auto\", "
-              "\"fifo\", \"lifo\", \"shortest\", \"state\", \"top\"");
+              "Queue type: one of: \"auto\", \"fifo\", \"lifo\", "
+              "\"radix\", \"shortest\", \"state\", \"top\"");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
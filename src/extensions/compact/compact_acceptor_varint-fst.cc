@@ -0,0 +1,15 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/fst.h>
+#include <fst/compact-fst.h>
+
+using fst::FstRegisterer;
+using fst::VarintCompactAcceptorFst;
+using fst::LogArc;
+using fst::StdArc;
+
+static FstRegisterer<VarintCompactAcceptorFst<StdArc>>
+    VarintCompactAcceptorFst_StdArc_registerer;
+static FstRegisterer<VarintCompactAcceptorFst<LogArc>>
+    VarintCompactAcceptorFst_LogArc_registerer;
@@ -0,0 +1,15 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/fst.h>
+#include <fst/compact-fst.h>
+
+using fst::FstRegisterer;
+using fst::VarintCompactUnweightedAcceptorFst;
+using fst::LogArc;
+using fst::StdArc;
+
+static FstRegisterer<VarintCompactUnweightedAcceptorFst<StdArc>>
+    VarintCompactUnweightedAcceptorFst_StdArc_registerer;
+static FstRegisterer<VarintCompactUnweightedAcceptorFst<LogArc>>
+    VarintCompactUnweightedAcceptorFst_LogArc_registerer;
@@ -0,0 +1,129 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fst/compat.h>
+#include <fst/extensions/linear/linear-fst.h>
+#include <fst/extensions/linear/linear-tagger.h>
+#include <fst/symbol-table.h>
+
+DEFINE_string(unknown_symbol, "<unk>", "Unknown word symbol");
+DEFINE_int64(batch_size, 1024, "Number of sentences tagged per batch");
+
+namespace {
+
+// Tags a batch of sentences and writes the tags out in input order.
+bool TagAndWrite(const std::vector<std::vector<fst::StdArc::Label>> &batch,
+                 fst::LinearTagger<fst::StdArc> *tagger,
+                 const fst::SymbolTable &osyms, std::ostream &ostrm) {
+  std::vector<std::vector<fst::StdArc::Label>> tags;
+  tagger->TagBatch(batch, &tags);
+  for (size_t i = 0; i < tags.size(); ++i) {
+    if (tags[i].size() != batch[i].size()) {
+      LOG(WARNING) << "No tagging found for sentence of length "
+                   << batch[i].size();
+    }
+    for (size_t j = 0; j < tags[i].size(); ++j) {
+      if (j) ostrm << ' ';
+      ostrm << osyms.Find(tags[i][j]);
+    }
+    ostrm << '\n';
+  }
+  return !ostrm.fail();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string usage =
+      "Tags whitespace-separated sentences, one per line, with a linear "
+      "tagger.\n\n  Usage: ";
+  usage += argv[0];
+  usage += " linear.fst [in.txt [out.txt]]\n";
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(usage.c_str(), &argc, &argv, true);
+  if (argc < 2 || argc > 4) {
+    ShowUsage();
+    return 1;
+  }
+
+  const string linear_name = strcmp(argv[1], "-") != 0 ? argv[1] : "";
+  const string in_name =
+      (argc > 2 && strcmp(argv[2], "-") != 0) ? argv[2] : "";
+  const string out_name = argc > 3 ? argv[3] : "";
+
+  if (FLAGS_batch_size <= 0) {
+    LOG(ERROR) << argv[0] << ": Batch size must be positive: "
+               << FLAGS_batch_size;
+    return 1;
+  }
+
+  if (linear_name.empty() && in_name.empty()) {
+    LOG(ERROR) << argv[0] << ": Can't take both inputs from standard input.";
+    return 1;
+  }
+
+  std::unique_ptr<fst::LinearTaggerFst<fst::StdArc>> lfst(
+      fst::LinearTaggerFst<fst::StdArc>::Read(linear_name));
+  if (!lfst) return 1;
+  const fst::SymbolTable *isyms = lfst->InputSymbols();
+  const fst::SymbolTable *osyms = lfst->OutputSymbols();
+  if (!isyms || !osyms) {
+    LOG(ERROR) << argv[0] << ": Linear FST needs input and output symbols";
+    return 1;
+  }
+  const fst::StdArc::Label unknown = isyms->Find(FLAGS_unknown_symbol);
+
+  std::ifstream fstrm;
+  if (!in_name.empty()) {
+    fstrm.open(in_name);
+    if (!fstrm) {
+      LOG(ERROR) << argv[0] << ": Can't open file: " << in_name;
+      return 1;
+    }
+  }
+  std::istream &istrm = fstrm.is_open() ? fstrm : std::cin;
+
+  std::ofstream ofstrm;
+  if (!out_name.empty()) {
+    ofstrm.open(out_name);
+    if (!ofstrm) {
+      LOG(ERROR) << argv[0] << ": Can't open file: " << out_name;
+      return 1;
+    }
+  }
+  std::ostream &ostrm = ofstrm.is_open() ? ofstrm : std::cout;
+
+  fst::LinearTagger<fst::StdArc> tagger(*lfst);
+  if (tagger.Error()) return 1;
+  std::vector<std::vector<fst::StdArc::Label>> batch;
+  string line, token;
+  while (std::getline(istrm, line)) {
+    batch.emplace_back();
+    std::istringstream tokens(line);
+    while (tokens >> token) {
+      fst::StdArc::Label word = isyms->Find(token);
+      if (word == fst::kNoLabel) word = unknown;
+      if (word == fst::kNoLabel) {
+        LOG(ERROR) << argv[0] << ": Unknown word and no unknown symbol: "
+                   << token;
+        return 1;
+      }
+      batch.back().push_back(word);
+    }
+    if (batch.size() >= static_cast<size_t>(FLAGS_batch_size)) {
+      if (!TagAndWrite(batch, &tagger, *osyms, ostrm)) return 1;
+      batch.clear();
+    }
+  }
+  if (!TagAndWrite(batch, &tagger, *osyms, ostrm)) return 1;
+  return 0;
+}
@@ -19,6 +19,9 @@ DEFINE_bool(connect, true, "Trim output");
 DEFINE_string(compose_filter, "paren",
               "Composition filter, one of: \"expand\", \"expand_paren\", "
               "\"paren\"");
+DEFINE_bool(paren_lookahead, false,
+            "Skip open parentheses whose sub-graph cannot match the other "
+            "argument");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
@@ -68,7 +71,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  fst::MPdtComposeOptions copts(false, compose_filter);
+  fst::MPdtComposeOptions copts(false, compose_filter, FLAGS_paren_lookahead);
 
   s::MPdtCompose(*ifst1, *ifst2, parens, assignments, &ofst, copts,
                  FLAGS_left_mpdt);
@@ -17,6 +17,9 @@ DEFINE_bool(connect, true, "Trim output");
 DEFINE_string(compose_filter, "paren",
               "Composition filter, one of: \"expand\", \"expand_paren\", "
               "\"paren\"");
+DEFINE_bool(paren_lookahead, false,
+            "Skip open parentheses whose sub-graph cannot match the other "
+            "argument");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
@@ -64,7 +67,8 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  fst::PdtComposeOptions copts(FLAGS_connect, compose_filter);
+  fst::PdtComposeOptions copts(FLAGS_connect, compose_filter,
+                               FLAGS_paren_lookahead);
 
   s::PdtCompose(*ifst1, *ifst2, parens, &ofst, copts, FLAGS_left_pdt);
 
@@ -13,6 +13,10 @@ DEFINE_string(pdt_parentheses, "", "PDT parenthesis label pairs.");
 DEFINE_bool(connect, true, "Trim output");
 DEFINE_bool(keep_parentheses, false, "Keep PDT parentheses in result.");
 DEFINE_string(weight, "", "Weight threshold");
+DEFINE_bool(best_first, false,
+            "Prune in a single best-first pass (no reverse shortest path)");
+DEFINE_int64(max_stack_depth, -1,
+             "Maximum stack depth with --best_first (if non-negative)");
 
 int main(int argc, char **argv) {
   namespace s = fst::script;
@@ -31,6 +35,11 @@ int main(int argc, char **argv) {
   string in_name = (argc > 1 && (strcmp(argv[1], "-") != 0)) ? argv[1] : "";
   string out_name = argc > 2 ? argv[2] : "";
 
+  if (FLAGS_max_stack_depth >= 0 && !FLAGS_best_first) {
+    LOG(ERROR) << argv[0] << ": --max_stack_depth requires --best_first";
+    return 1;
+  }
+
   s::FstClass *ifst = s::FstClass::Read(in_name);
   if (!ifst) return 1;
 
@@ -49,7 +58,8 @@ int main(int argc, char **argv) {
   s::VectorFstClass ofst(ifst->ArcType());
   s::PdtExpand(*ifst, parens, &ofst,
                s::PdtExpandOptions(FLAGS_connect, FLAGS_keep_parentheses,
-                                   weight_threshold));
+                                   weight_threshold, FLAGS_best_first,
+                                   FLAGS_max_stack_depth));
 
   ofst.Write(out_name);
 
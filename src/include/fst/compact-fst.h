@@ -7,12 +7,17 @@
 #ifndef FST_LIB_COMPACT_FST_H_
 #define FST_LIB_COMPACT_FST_H_
 
+#include <algorithm>
+#include <cstring>
 #include <iterator>
+#include <limits>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <fst/cache.h>
 #include <fst/expanded-fst.h>
+#include <fst/float-weight.h>
 #include <fst/fst-decl.h>  // For optional argument declarations
 #include <fst/mapped-file.h>
 #include <fst/matcher.h>
@@ -109,6 +114,17 @@ struct CompactFstOptions : public CacheOptions {
 //
 // The unsigned type U is used to represent indices into the compacts_
 // array.
+//
+// A data storage may also define
+//
+//   template <class Iterator, class Compactor>
+//   void Refill(const Iterator &begin, const Iterator &end,
+//               const Compactor &compactor);
+//
+// which replaces its contents as the (begin, end, compactor) constructor
+// would. CompactFstImpl::SetCompactElements() uses it to refill a storage
+// not shared with another FST in place; without it, a new storage is
+// constructed.
 template <class E, class U>
 class DefaultCompactStore {
  public:
@@ -122,6 +138,8 @@ class DefaultCompactStore {
         ncompacts_(0),
         narcs_(0),
         start_(kNoStateId),
+        states_capacity_(0),
+        compacts_capacity_(0),
         error_(false) {}
 
   template <class A, class Compactor>
@@ -131,6 +149,12 @@ class DefaultCompactStore {
   DefaultCompactStore(const Iterator &begin, const Iterator &end,
                       const Compactor &compactor);
 
+  // Replaces the contents with the compacted transitions in [begin, end).
+  // The owned arrays are kept when they are large enough.
+  template <class Iterator, class Compactor>
+  void Refill(const Iterator &begin, const Iterator &end,
+              const Compactor &compactor);
+
   ~DefaultCompactStore() {
     if (!states_region_) {
       delete[] states_;
@@ -161,6 +185,37 @@ class DefaultCompactStore {
   static const string &Type();
 
  private:
+  // Points states_ at an owned array of at least n entries.
+  void ReserveStates(size_t n) {
+    if (!states_region_ && n <= states_capacity_) return;
+    ReleaseStates();
+    states_ = new Unsigned[n];
+    states_capacity_ = n;
+  }
+
+  // Drops the states array, which Write() takes as having none.
+  void ReleaseStates() {
+    if (states_region_) {
+      states_region_.reset();
+    } else {
+      delete[] states_;
+    }
+    states_ = nullptr;
+    states_capacity_ = 0;
+  }
+
+  // Points compacts_ at an owned array of at least n elements.
+  void ReserveCompacts(size_t n) {
+    if (!compacts_region_ && n <= compacts_capacity_) return;
+    if (compacts_region_) {
+      compacts_region_.reset();
+    } else {
+      delete[] compacts_;
+    }
+    compacts_ = new CompactElement[n];
+    compacts_capacity_ = n;
+  }
+
   std::unique_ptr<MappedFile> states_region_;
   std::unique_ptr<MappedFile> compacts_region_;
   Unsigned *states_;
@@ -169,6 +224,8 @@ class DefaultCompactStore {
   size_t ncompacts_;
   size_t narcs_;
   ssize_t start_;
+  size_t states_capacity_;    // Size of the owned states_ array.
+  size_t compacts_capacity_;  // Size of the owned compacts_ array.
   bool error_;
 };
 
@@ -176,13 +233,7 @@ template <class E, class U>
 template <class A, class C>
 DefaultCompactStore<E, U>::DefaultCompactStore(const Fst<A> &fst,
                                                const C &compactor)
-    : states_(nullptr),
-      compacts_(nullptr),
-      nstates_(0),
-      ncompacts_(0),
-      narcs_(0),
-      start_(kNoStateId),
-      error_(false) {
+    : DefaultCompactStore() {
   typedef typename A::StateId StateId;
   typedef typename A::Weight Weight;
   start_ = fst.Start();
@@ -197,19 +248,18 @@ DefaultCompactStore<E, U>::DefaultCompactStore(const Fst<A> &fst,
     if (fst.Final(s) != Weight::Zero()) ++nfinals;
   }
   if (compactor.Size() == -1) {
-    states_ = new Unsigned[nstates_ + 1];
+    ReserveStates(nstates_ + 1);
     ncompacts_ = narcs_ + nfinals;
-    compacts_ = new CompactElement[ncompacts_];
+    ReserveCompacts(ncompacts_);
     states_[nstates_] = ncompacts_;
   } else {
-    states_ = nullptr;
     ncompacts_ = nstates_ * compactor.Size();
     if ((narcs_ + nfinals) != ncompacts_) {
       FSTERROR() << "DefaultCompactStore: Compactor incompatible with Fst";
       error_ = true;
       return;
     }
-    compacts_ = new CompactElement[ncompacts_];
+    ReserveCompacts(ncompacts_);
   }
   size_t pos = 0, fpos = 0;
   for (StateId s = 0; s < nstates_; ++s) {
@@ -240,13 +290,20 @@ template <class Iterator, class C>
 DefaultCompactStore<E, U>::DefaultCompactStore(const Iterator &begin,
                                                const Iterator &end,
                                                const C &compactor)
-    : states_(nullptr),
-      compacts_(nullptr),
-      nstates_(0),
-      ncompacts_(0),
-      narcs_(0),
-      start_(kNoStateId),
-      error_(false) {
+    : DefaultCompactStore() {
+  Refill(begin, end, compactor);
+}
+
+template <class E, class U>
+template <class Iterator, class C>
+void DefaultCompactStore<E, U>::Refill(const Iterator &begin,
+                                       const Iterator &end,
+                                       const C &compactor) {
+  nstates_ = 0;
+  ncompacts_ = 0;
+  narcs_ = 0;
+  start_ = kNoStateId;
+  error_ = false;
   typedef typename C::Arc Arc;
   typedef typename Arc::Weight Weight;
   if (compactor.Size() != -1) {
@@ -270,7 +327,7 @@ DefaultCompactStore<E, U>::DefaultCompactStore(const Iterator &begin,
     if (ncompacts_ == 0) return;
     start_ = 0;
     nstates_ = ncompacts_ / compactor.Size();
-    compacts_ = new CompactElement[ncompacts_];
+    ReserveCompacts(ncompacts_);
     size_t i = 0;
     Iterator it = begin;
     for (; it != end; ++it, ++i) {
@@ -282,7 +339,10 @@ DefaultCompactStore<E, U>::DefaultCompactStore(const Iterator &begin,
           i, Arc(kNoLabel, kNoLabel, Weight::One(), kNoStateId));
     }
   } else {
-    if (std::distance(begin, end) == 0) return;
+    if (std::distance(begin, end) == 0) {
+      ReleaseStates();
+      return;
+    }
     // Count # of states, arcs and compacts.
     Iterator it = begin;
     for (size_t i = 0; it != end; ++it, ++i) {
@@ -296,8 +356,8 @@ DefaultCompactStore<E, U>::DefaultCompactStore(const Iterator &begin,
       }
     }
     start_ = 0;
-    compacts_ = new CompactElement[ncompacts_];
-    states_ = new Unsigned[nstates_ + 1];
+    ReserveCompacts(ncompacts_);
+    ReserveStates(nstates_ + 1);
     states_[nstates_] = ncompacts_;
     size_t i = 0, s = 0;
     for (it = begin; it != end; ++it) {
@@ -335,8 +395,9 @@ DefaultCompactStore<E, U> *DefaultCompactStore<E, U>::Read(
       return nullptr;
     }
     size_t b = (data->nstates_ + 1) * sizeof(Unsigned);
-    data->states_region_.reset(MappedFile::Map(
-        &strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+    data->states_region_.reset(
+        MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source,
+                        b, opts.map_advice, opts.map_hugepages));
     if (!strm || !data->states_region_) {
       LOG(ERROR) << "DefaultCompactStore::Read: Read failed: " << opts.source;
       return nullptr;
@@ -355,7 +416,8 @@ DefaultCompactStore<E, U> *DefaultCompactStore<E, U>::Read(
   }
   size_t b = data->ncompacts_ * sizeof(CompactElement);
   data->compacts_region_.reset(
-      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.map_advice, opts.map_hugepages));
   if (!strm || !data->compacts_region_) {
     LOG(ERROR) << "DefaultCompactStore::Read: Read failed: " << opts.source;
     return nullptr;
@@ -399,11 +461,503 @@ const string &DefaultCompactStore<E, U>::Type() {
   return type;
 }
 
+namespace internal {
+
+// Splits compact elements into a fixed number of int64 fields, and joins them
+// back, for VarintCompactStore.
+template <class E, class Enable = void>
+struct VarintCompactCodec;
+
+template <class E>
+struct VarintCompactCodec<
+    E, typename std::enable_if<std::is_integral<E>::value>::type> {
+  static constexpr int kNumFields = 1;
+
+  static void Split(const E &e, int64 *fields) { fields[0] = e; }
+
+  static void Join(const int64 *fields, E *e) {
+    *e = static_cast<E>(fields[0]);
+  }
+};
+
+// Float weights are stored by bit pattern, so that repeated weights cost a
+// single byte.
+template <class W>
+struct VarintCompactCodec<
+    W, typename std::enable_if<
+           std::is_base_of<FloatWeightTpl<typename W::ValueType>,
+                           W>::value>::type> {
+  typedef typename W::ValueType T;
+
+  static constexpr int kNumFields = 1;
+
+  static void Split(const W &w, int64 *fields) {
+    const T value = w.Value();
+    fields[0] = 0;
+    memcpy(fields, &value, sizeof(value));
+  }
+
+  static void Join(const int64 *fields, W *w) {
+    T value;
+    memcpy(&value, fields, sizeof(value));
+    *w = W(value);
+  }
+};
+
+template <class S, class T>
+struct VarintCompactCodec<std::pair<S, T>> {
+  typedef VarintCompactCodec<S> FirstCodec;
+  typedef VarintCompactCodec<T> SecondCodec;
+
+  static constexpr int kNumFields =
+      FirstCodec::kNumFields + SecondCodec::kNumFields;
+
+  static void Split(const std::pair<S, T> &e, int64 *fields) {
+    FirstCodec::Split(e.first, fields);
+    SecondCodec::Split(e.second, fields + FirstCodec::kNumFields);
+  }
+
+  static void Join(const int64 *fields, std::pair<S, T> *e) {
+    FirstCodec::Join(fields, &e->first);
+    SecondCodec::Join(fields + FirstCodec::kNumFields, &e->second);
+  }
+};
+
+}  // namespace internal
+
+// Varint-coded implementation data for CompactFst, an alternative to
+// DefaultCompactStore for large FSTs whose compacted transitions are
+// delta-compressible (e.g., label-sorted acceptors).
+//
+// The compacted transitions of each state (including the superfinal one, first
+// as above) form a block. Each element is split into integer fields by
+// VarintCompactCodec; within a block, every field is stored as the zig-zag
+// coded difference from the same field of the previous element, as a base-128
+// varint. A block starts with its number of elements, also as a varint.
+//
+// Rather than one offset per state, a sampled index holds the byte offset and
+// the index of the first compacted transition of every kSampleInterval-th
+// state; other states are reached by skipping over the preceding blocks.
+//
+// Both arrays can be memory-mapped. The store keeps no decoding state:
+// CompactFstImpl::Expand() and the ArcIterator specialization below decode the
+// block of a state at once with DecodeState(), while access to a single
+// element by index seeks from the nearest sampled state.
+//
+// Element types may be integers, float weights (e.g., TropicalWeight and
+// LogWeight) and std::pairs of these, which covers the compactors below.
+template <class E, class U>
+class VarintCompactStore {
+ public:
+  typedef E CompactElement;
+  typedef U Unsigned;
+
+  VarintCompactStore()
+      : samples_(nullptr),
+        bytes_(nullptr),
+        nstates_(0),
+        ncompacts_(0),
+        nbytes_(0),
+        narcs_(0),
+        start_(kNoStateId),
+        compactor_size_(-1),
+        error_(false) {}
+
+  template <class A, class Compactor>
+  VarintCompactStore(const Fst<A> &fst, const Compactor &compactor)
+      : VarintCompactStore() {
+    Encode(DefaultCompactStore<E, U>(fst, compactor), compactor.Size());
+  }
+
+  template <class Iterator, class Compactor>
+  VarintCompactStore(const Iterator &begin, const Iterator &end,
+                     const Compactor &compactor)
+      : VarintCompactStore() {
+    Encode(DefaultCompactStore<E, U>(begin, end, compactor),
+           compactor.Size());
+  }
+
+  // Replaces the contents with the compacted transitions in [begin, end).
+  template <class Iterator, class Compactor>
+  void Refill(const Iterator &begin, const Iterator &end,
+              const Compactor &compactor) {
+    error_ = false;
+    Encode(DefaultCompactStore<E, U>(begin, end, compactor),
+           compactor.Size());
+  }
+
+  template <class Compactor>
+  static VarintCompactStore<E, U> *Read(std::istream &strm,
+                                        const FstReadOptions &opts,
+                                        const FstHeader &hdr,
+                                        const Compactor &compactor);
+
+  bool Write(std::ostream &strm, const FstWriteOptions &opts) const;
+
+  Unsigned States(ssize_t i) const {
+    if (i >= static_cast<ssize_t>(nstates_)) return ncompacts_;
+    size_t first;
+    Seek(i, &first);
+    return first;
+  }
+
+  // Returns a copy, since elements are decoded on each call.
+  CompactElement Compacts(size_t i) const {
+    size_t first;
+    const uint8 *p = Seek(FindState(i), &first);
+    const size_t n = ReadVarint(&p, End());
+    int64 fields[Codec::kNumFields] = {};
+    for (size_t j = first; j <= i && j < first + n; ++j) {
+      DecodeFields(&p, fields);
+    }
+    CompactElement element;
+    Codec::Join(fields, &element);
+    return element;
+  }
+
+  size_t NumStates() const { return nstates_; }
+  size_t NumCompacts() const { return ncompacts_; }
+  size_t NumArcs() const { return narcs_; }
+  ssize_t Start() const { return start_; }
+
+  // Returns the size in bytes of the coded transitions.
+  size_t NumBytes() const { return nbytes_; }
+
+  bool Error() const { return error_; }
+
+  // Decodes the compacted transitions of state s into elements and returns
+  // the index of the first one.
+  size_t DecodeState(size_t s, std::vector<CompactElement> *elements) const {
+    size_t first;
+    DecodeBlock(Seek(s, &first), End(), elements);
+    return first;
+  }
+
+  // Returns a string identifying the type of data storage container.
+  static const string &Type();
+
+ private:
+  typedef internal::VarintCompactCodec<E> Codec;
+
+  static const size_t kSampleInterval = 32;
+  static const int kMaxVarintBytes = 10;  // Enough for any uint64.
+
+  const uint8 *End() const { return bytes_ + nbytes_; }
+
+  // Returns the start of the block of state s, and its first element index.
+  const uint8 *Seek(size_t s, size_t *first) const {
+    const size_t sample = s / kSampleInterval;
+    const uint8 *p = bytes_ + samples_[2 * sample];
+    *first = samples_[2 * sample + 1];
+    for (size_t t = sample * kSampleInterval; t < s; ++t) {
+      const uint64 n = ReadVarint(&p, End());
+      *first += n;
+      p = SkipVarints(p, End(), n * Codec::kNumFields);
+    }
+    return p;
+  }
+
+  // Returns the state whose block contains element i.
+  size_t FindState(size_t i) const {
+    if (compactor_size_ > 0) return i / compactor_size_;
+    size_t lo = 0, hi = (nstates_ + kSampleInterval - 1) / kSampleInterval;
+    while (hi - lo > 1) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (samples_[2 * mid + 1] <= i) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    const uint8 *p = bytes_ + samples_[2 * lo];
+    size_t first = samples_[2 * lo + 1];
+    size_t s = lo * kSampleInterval;
+    for (; s + 1 < nstates_; ++s) {
+      const uint64 n = ReadVarint(&p, End());
+      if (i < first + n) break;
+      first += n;
+      p = SkipVarints(p, End(), n * Codec::kNumFields);
+    }
+    return s;
+  }
+
+  // Adds the next element's zig-zag coded deltas to fields.
+  void DecodeFields(const uint8 **p, int64 *fields) const {
+    for (int f = 0; f < Codec::kNumFields; ++f) {
+      const uint64 z = ReadVarint(p, End());
+      fields[f] += static_cast<int64>((z >> 1) ^ (~(z & 1) + 1));
+    }
+  }
+
+  // Decodes the block starting at p and returns the start of the next one.
+  // A corrupt element count is bounded by the bytes left before end.
+  const uint8 *DecodeBlock(const uint8 *p, const uint8 *end,
+                           std::vector<CompactElement> *elements) const {
+    size_t n = ReadVarint(&p, end);
+    n = std::min<size_t>(n, (end - p) / Codec::kNumFields);
+    elements->resize(n);
+    int64 fields[Codec::kNumFields] = {};
+    for (size_t i = 0; i < n; ++i) {
+      DecodeFields(&p, fields);
+      Codec::Join(fields, &(*elements)[i]);
+    }
+    return p;
+  }
+
+  // Reads a varint of at most kMaxVarintBytes bytes, stopping at end. Corrupt
+  // input thus yields some value but never reads past the coded bytes.
+  static uint64 ReadVarint(const uint8 **p, const uint8 *end) {
+    const uint8 *q = *p;
+    uint64 value = 0;
+    for (int i = 0; i < kMaxVarintBytes && q < end; ++i) {
+      const uint8 byte = *q++;
+      value |= static_cast<uint64>(byte & 0x7F) << (7 * i);
+      if (!(byte & 0x80)) break;
+    }
+    *p = q;
+    return value;
+  }
+
+  static const uint8 *SkipVarints(const uint8 *p, const uint8 *end,
+                                  size_t n) {
+    while (n > 0 && p < end) {
+      if (!(*p++ & 0x80)) --n;
+    }
+    return p;
+  }
+
+  static void WriteVarint(uint64 value, std::vector<uint8> *bytes) {
+    while (value >= 0x80) {
+      bytes->push_back(static_cast<uint8>(value | 0x80));
+      value >>= 7;
+    }
+    bytes->push_back(static_cast<uint8>(value));
+  }
+
+  void Encode(const DefaultCompactStore<E, U> &data, ssize_t compactor_size);
+
+  // Checks the sizes and sampled offsets read from a file, so that decoding
+  // stays within the coded bytes.
+  bool Valid() const;
+
+  std::unique_ptr<MappedFile> samples_region_;
+  std::unique_ptr<MappedFile> bytes_region_;
+  const uint64 *samples_;  // Byte offset and first element of sampled states.
+  const uint8 *bytes_;
+  size_t nstates_;
+  size_t ncompacts_;
+  size_t nbytes_;
+  size_t narcs_;
+  ssize_t start_;
+  ssize_t compactor_size_;
+  bool error_;
+
+  VarintCompactStore(const VarintCompactStore &) = delete;
+  VarintCompactStore &operator=(const VarintCompactStore &) = delete;
+};
+
+template <class E, class U>
+const size_t VarintCompactStore<E, U>::kSampleInterval;
+
+template <class E, class U>
+const int VarintCompactStore<E, U>::kMaxVarintBytes;
+
+template <class E, class U>
+void VarintCompactStore<E, U>::Encode(const DefaultCompactStore<E, U> &data,
+                                      ssize_t compactor_size) {
+  if (data.Error()) {
+    error_ = true;
+    return;
+  }
+  nstates_ = data.NumStates();
+  ncompacts_ = data.NumCompacts();
+  narcs_ = data.NumArcs();
+  start_ = data.Start();
+  compactor_size_ = compactor_size;
+  const size_t nsamples = (nstates_ + kSampleInterval - 1) / kSampleInterval;
+  samples_region_.reset(MappedFile::Allocate(2 * nsamples * sizeof(uint64)));
+  uint64 *samples = static_cast<uint64 *>(samples_region_->mutable_data());
+  std::vector<uint8> bytes;
+  int64 prev[Codec::kNumFields];
+  int64 fields[Codec::kNumFields];
+  for (size_t s = 0; s < nstates_; ++s) {
+    const size_t begin =
+        compactor_size == -1 ? data.States(s) : s * compactor_size;
+    const size_t end =
+        compactor_size == -1 ? data.States(s + 1) : (s + 1) * compactor_size;
+    if (s % kSampleInterval == 0) {
+      samples[2 * (s / kSampleInterval)] = bytes.size();
+      samples[2 * (s / kSampleInterval) + 1] = begin;
+    }
+    WriteVarint(end - begin, &bytes);
+    std::fill(prev, prev + Codec::kNumFields, 0);
+    for (size_t i = begin; i < end; ++i) {
+      Codec::Split(data.Compacts(i), fields);
+      for (int f = 0; f < Codec::kNumFields; ++f) {
+        const int64 delta = static_cast<int64>(static_cast<uint64>(fields[f]) -
+                                               static_cast<uint64>(prev[f]));
+        WriteVarint((static_cast<uint64>(delta) << 1) ^ (delta >> 63), &bytes);
+        prev[f] = fields[f];
+      }
+    }
+  }
+  nbytes_ = bytes.size();
+  bytes_region_.reset(MappedFile::Allocate(nbytes_));
+  if (nbytes_ > 0) memcpy(bytes_region_->mutable_data(), bytes.data(), nbytes_);
+  samples_ = samples;
+  bytes_ = static_cast<const uint8 *>(bytes_region_->data());
+}
+
+template <class E, class U>
+template <class C>
+VarintCompactStore<E, U> *VarintCompactStore<E, U>::Read(
+    std::istream &strm, const FstReadOptions &opts, const FstHeader &hdr,
+    const C &compactor) {
+  std::unique_ptr<VarintCompactStore<E, U>> data(
+      new VarintCompactStore<E, U>());
+  data->start_ = hdr.Start();
+  data->nstates_ = hdr.NumStates();
+  data->narcs_ = hdr.NumArcs();
+  data->compactor_size_ = compactor.Size();
+  uint64 ncompacts = 0;
+  uint64 nbytes = 0;
+  ReadType(strm, &ncompacts);
+  ReadType(strm, &nbytes);
+  data->ncompacts_ = ncompacts;
+  data->nbytes_ = nbytes;
+  if ((hdr.GetFlags() & FstHeader::IS_ALIGNED) && !AlignInput(strm)) {
+    LOG(ERROR) << "VarintCompactStore::Read: Alignment failed: "
+               << opts.source;
+    return nullptr;
+  }
+  const size_t nsamples =
+      (data->nstates_ + kSampleInterval - 1) / kSampleInterval;
+  data->samples_region_.reset(
+      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source,
+                      2 * nsamples * sizeof(uint64), opts.map_advice,
+                      opts.map_hugepages));
+  if (!strm || !data->samples_region_) {
+    LOG(ERROR) << "VarintCompactStore::Read: Read failed: " << opts.source;
+    return nullptr;
+  }
+  data->samples_ = static_cast<const uint64 *>(data->samples_region_->data());
+  if ((hdr.GetFlags() & FstHeader::IS_ALIGNED) && !AlignInput(strm)) {
+    LOG(ERROR) << "VarintCompactStore::Read: Alignment failed: "
+               << opts.source;
+    return nullptr;
+  }
+  data->bytes_region_.reset(MappedFile::Map(
+      &strm, opts.mode == FstReadOptions::MAP, opts.source, data->nbytes_,
+      opts.map_advice, opts.map_hugepages));
+  if (!strm || !data->bytes_region_) {
+    LOG(ERROR) << "VarintCompactStore::Read: Read failed: " << opts.source;
+    return nullptr;
+  }
+  data->bytes_ = static_cast<const uint8 *>(data->bytes_region_->data());
+  if (!data->Valid()) {
+    LOG(ERROR) << "VarintCompactStore::Read: Corrupt data: " << opts.source;
+    return nullptr;
+  }
+  return data.release();
+}
+
+template <class E, class U>
+bool VarintCompactStore<E, U>::Valid() const {
+  if (ncompacts_ > std::numeric_limits<Unsigned>::max()) return false;
+  if (compactor_size_ > 0 && ncompacts_ != nstates_ * compactor_size_) {
+    return false;
+  }
+  // Every block holds at least its element count.
+  if (nbytes_ < nstates_) return false;
+  const size_t nsamples = (nstates_ + kSampleInterval - 1) / kSampleInterval;
+  for (size_t i = 0; i < nsamples; ++i) {
+    const uint64 offset = samples_[2 * i];
+    const uint64 first = samples_[2 * i + 1];
+    if (i == 0 ? (offset != 0 || first != 0)
+               : (offset <= samples_[2 * i - 2] ||
+                  first < samples_[2 * i - 1])) {
+      return false;
+    }
+    if (offset >= nbytes_ || first > ncompacts_) return false;
+  }
+  return true;
+}
+
+template <class E, class U>
+bool VarintCompactStore<E, U>::Write(std::ostream &strm,
+                                     const FstWriteOptions &opts) const {
+  WriteType(strm, static_cast<uint64>(ncompacts_));
+  WriteType(strm, static_cast<uint64>(nbytes_));
+  if (opts.align && !AlignOutput(strm)) {
+    LOG(ERROR) << "VarintCompactStore::Write: Alignment failed: "
+               << opts.source;
+    return false;
+  }
+  const size_t nsamples = (nstates_ + kSampleInterval - 1) / kSampleInterval;
+  strm.write(reinterpret_cast<const char *>(samples_),
+             2 * nsamples * sizeof(uint64));
+  if (opts.align && !AlignOutput(strm)) {
+    LOG(ERROR) << "VarintCompactStore::Write: Alignment failed: "
+               << opts.source;
+    return false;
+  }
+  strm.write(reinterpret_cast<const char *>(bytes_), nbytes_);
+  strm.flush();
+  if (!strm) {
+    LOG(ERROR) << "VarintCompactStore::Write: Write failed: " << opts.source;
+    return false;
+  }
+  return true;
+}
+
+template <class E, class U>
+const string &VarintCompactStore<E, U>::Type() {
+  static const string type = "varint";
+  return type;
+}
+
 template <class A, class C, class U, class S>
 class CompactFst;
 template <class F, class G>
 void Cast(const F &, G *);
 
+namespace internal {
+
+// Refills a data storage in place when it defines Refill(), returning
+// whether it did. Passing 0 for the last argument prefers the first
+// overload.
+template <class S, class Iterator, class C>
+auto RefillCompactStore(S *data, const Iterator &begin, const Iterator &end,
+                        const C &compactor, int)
+    -> decltype(data->Refill(begin, end, compactor), bool()) {
+  data->Refill(begin, end, compactor);
+  return true;
+}
+
+template <class S, class Iterator, class C>
+bool RefillCompactStore(S *data, const Iterator &begin, const Iterator &end,
+                        const C &compactor, ...) {
+  return false;
+}
+
+// Decodes all compacted transitions of state s when the data storage defines
+// DecodeState(), returning whether it did.
+template <class S, class E>
+auto DecodeCompactState(const S &data, size_t s, std::vector<E> *elements,
+                        int)
+    -> decltype(data.DecodeState(s, elements), bool()) {
+  data.DecodeState(s, elements);
+  return true;
+}
+
+template <class S, class E>
+bool DecodeCompactState(const S &data, size_t s, std::vector<E> *elements,
+                        ...) {
+  return false;
+}
+
+}  // namespace internal
+
 // Implementation class for CompactFst, which contains parametrizeable
 // Fst data storage (DefaultCompactStore by default) and Fst cache.
 template <class A, class C, class U,
@@ -417,6 +971,7 @@ class CompactFstImpl : public CacheImpl<A> {
   using FstImpl<A>::SetOutputSymbols;
   using FstImpl<A>::WriteHeader;
 
+  using CacheImpl<A>::Clear;
   using CacheImpl<A>::PushArc;
   using CacheImpl<A>::HasArcs;
   using CacheImpl<A>::HasFinal;
@@ -610,27 +1165,35 @@ class CompactFstImpl : public CacheImpl<A> {
     return compactor_->Expand(s, data_->Compacts(i), f);
   }
 
+  // A data storage that decodes (e.g., VarintCompactStore) provides all
+  // elements of the state at once, so they are not decoded one by one.
   void Expand(StateId s) {
-    size_t begin =
-        compactor_->Size() == -1 ? data_->States(s) : s * compactor_->Size();
-    size_t end = compactor_->Size() == -1 ? data_->States(s + 1)
-                                          : (s + 1) * compactor_->Size();
-    for (size_t i = begin; i < end; ++i) {
-      const Arc &arc = ComputeArc(s, i);
-      if (arc.ilabel == kNoLabel) {
-        SetFinal(s, arc.weight);
-      } else {
-        PushArc(s, arc);
+    if (internal::DecodeCompactState(*data_, s, &decoded_, 0)) {
+      for (const auto &element : decoded_) {
+        ExpandArc(s, compactor_->Expand(s, element, kArcValueFlags));
       }
+    } else {
+      size_t begin =
+          compactor_->Size() == -1 ? data_->States(s) : s * compactor_->Size();
+      size_t end = compactor_->Size() == -1 ? data_->States(s + 1)
+                                            : (s + 1) * compactor_->Size();
+      for (size_t i = begin; i < end; ++i) ExpandArc(s, ComputeArc(s, i));
     }
     if (!HasFinal(s)) SetFinal(s, Weight::Zero());
     SetArcs(s);
   }
 
+  // Replaces the FST contents. A store not shared with another FST is
+  // refilled in place when it supports it, so an FST reused across inputs
+  // keeps its buffers.
   template <class Iterator>
   void SetCompactElements(const Iterator &b, const Iterator &e) {
     SetProperties(kStaticProperties | compactor_->Properties());
-    data_ = std::make_shared<DataStorage>(b, e, *compactor_);
+    if (!data_ || data_.use_count() != 1 ||
+        !internal::RefillCompactStore(data_.get(), b, e, *compactor_, 0)) {
+      data_ = std::make_shared<DataStorage>(b, e, *compactor_);
+    }
+    Clear();  // Drops states cached from the previous contents.
     if (data_->Error()) SetProperties(kError, kError);
   }
 
@@ -698,6 +1261,10 @@ class CompactFstImpl : public CacheImpl<A> {
     }
     type += "_";
     type += compactor_->Type();
+    if (DataStorage::Type() != "compact") {
+      type += "_";
+      type += DataStorage::Type();
+    }
     SetType(type);
     SetProperties(kStaticProperties | compactor_->Properties());
     data_ = std::make_shared<DataStorage>(b, e, *compactor_);
@@ -711,8 +1278,18 @@ class CompactFstImpl : public CacheImpl<A> {
   // Minimum file format version supported
   static const int kMinFileVersion = 1;
 
+  void ExpandArc(StateId s, const Arc &arc) {
+    if (arc.ilabel == kNoLabel) {
+      SetFinal(s, arc.weight);
+    } else {
+      PushArc(s, arc);
+    }
+  }
+
   std::shared_ptr<C> compactor_;
   std::shared_ptr<DataStorage> data_;
+  // Elements of the state being expanded, for data storages that decode.
+  std::vector<CompactElement> decoded_;
 };
 
 template <class A, class C, class U, class S>
@@ -858,13 +1435,14 @@ class CompactFst : public ImplToExpandedFst<CompactFstImpl<A, C, U, S>> {
       : ImplToExpandedFst<Impl>(impl) {}
 
   // Use overloading to extract the type of the argument.
-  static Impl *GetImplIfCompactFst(const CompactFst<A, C, U, S> &compact_fst) {
+  static const Impl *GetImplIfCompactFst(
+      const CompactFst<A, C, U, S> &compact_fst) {
     return compact_fst.GetImpl();
   }
 
   // This does not give privileged treatment to subclasses of CompactFst.
   template <typename NonCompactFst>
-  static Impl *GetImplIfCompactFst(const NonCompactFst &fst) {
+  static const Impl *GetImplIfCompactFst(const NonCompactFst &fst) {
     return nullptr;
   }
 
@@ -882,11 +1460,19 @@ bool CompactFst<A, C, U, S>::WriteFst(const F &fst, const C &compactor,
   typedef U Unsigned;
   typedef typename C::Element CompactElement;
   typedef typename A::Weight Weight;
+  // The layout written below is that of DefaultCompactStore; other stores
+  // write their own from a compacted copy.
+  if (!std::is_same<S, DefaultCompactStore<CompactElement, U>>::value) {
+    if (const Impl *impl = GetImplIfCompactFst(fst)) {
+      return impl->Write(strm, opts);
+    }
+    return CompactFst<A, C, U, S>(fst, compactor).Write(strm, opts);
+  }
   int file_version =
       opts.align ? Impl::kAlignedFileVersion : Impl::kFileVersion;
   size_t num_arcs = -1, num_states = -1;
   C first_pass_compactor = compactor;
-  if (Impl *impl = GetImplIfCompactFst(fst)) {
+  if (const Impl *impl = GetImplIfCompactFst(fst)) {
     num_arcs = impl->Data()->NumArcs();
     num_states = impl->Data()->NumStates();
     first_pass_compactor = *impl->GetCompactor();
@@ -1065,6 +1651,67 @@ class ArcIterator<CompactFst<A, C, U>> {
   uint32 flags_;
 };
 
+// Specialization for CompactFst with VarintCompactStore. Decodes the
+// compacted transitions of the state once, then expands them on demand.
+template <class A, class C, class U, class E>
+class ArcIterator<CompactFst<A, C, U, VarintCompactStore<E, U>>> {
+ public:
+  typedef typename A::StateId StateId;
+  typedef typename C::Element CompactElement;
+
+  ArcIterator(const CompactFst<A, C, U, VarintCompactStore<E, U>> &fst,
+              StateId s)
+      : compactor_(fst.GetImpl()->GetCompactor()),
+        state_(s),
+        compacts_(nullptr),
+        pos_(0),
+        num_arcs_(0),
+        flags_(kArcValueFlags) {
+    fst.GetImpl()->Data()->DecodeState(s, &elements_);
+    num_arcs_ = elements_.size();
+    if (num_arcs_ > 0) {
+      compacts_ = elements_.data();
+      arc_ = compactor_->Expand(s, *compacts_, kArcILabelValue);
+      if (arc_.ilabel == kNoStateId) {
+        ++compacts_;
+        --num_arcs_;
+      }
+    }
+  }
+
+  bool Done() const { return pos_ >= num_arcs_; }
+
+  const A &Value() const {
+    arc_ = compactor_->Expand(state_, compacts_[pos_], flags_);
+    return arc_;
+  }
+
+  void Next() { ++pos_; }
+
+  size_t Position() const { return pos_; }
+
+  void Reset() { pos_ = 0; }
+
+  void Seek(size_t pos) { pos_ = pos; }
+
+  uint32 Flags() const { return flags_; }
+
+  void SetFlags(uint32 f, uint32 m) {
+    flags_ &= ~m;
+    flags_ |= (f & kArcValueFlags);
+  }
+
+ private:
+  const C *compactor_;  // Borrowed reference.
+  StateId state_;
+  std::vector<CompactElement> elements_;
+  const CompactElement *compacts_;  // Pointer into elements_.
+  size_t pos_;
+  size_t num_arcs_;
+  mutable A arc_;
+  uint32 flags_;
+};
+
 // // Specialization for CompactFst.
 // // This is an optionally caching arc iterator.
 // // TODO(allauzen): implements the kArcValueFlags, the current
@@ -1371,6 +2018,15 @@ using StdCompactUnweightedFst = CompactUnweightedFst<StdArc, uint32>;
 using StdCompactUnweightedAcceptorFst =
     CompactUnweightedAcceptorFst<StdArc, uint32>;
 
+template <class A, class U = uint32>
+using VarintCompactAcceptorFst =
+    CompactFst<A, AcceptorCompactor<A>, U,
+               VarintCompactStore<typename AcceptorCompactor<A>::Element, U>>;
+template <class A, class U = uint32>
+using VarintCompactUnweightedAcceptorFst = CompactFst<
+    A, UnweightedAcceptorCompactor<A>, U,
+    VarintCompactStore<typename UnweightedAcceptorCompactor<A>::Element, U>>;
+
 }  // namespace fst
 
 #endif  // FST_LIB_COMPACT_FST_H_
@@ -150,10 +150,7 @@ ConstFstImpl<A, U>::ConstFstImpl(const Fst<A> &fst) : nstates_(0), narcs_(0) {
   // Count # of states and arcs.
   for (StateIterator<Fst<A>> siter(fst); !siter.Done(); siter.Next()) {
     ++nstates_;
-    StateId s = siter.Value();
-    for (ArcIterator<Fst<A>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
-      ++narcs_;
-    }
+    narcs_ += fst.NumArcs(siter.Value());
   }
   states_region_.reset(MappedFile::Allocate(nstates_ * sizeof(*states_)));
   arcs_region_.reset(MappedFile::Allocate(narcs_ * sizeof(*arcs_)));
@@ -207,7 +204,8 @@ ConstFstImpl<A, U> *ConstFstImpl<A, U>::Read(std::istream &strm,
 
   size_t b = impl->nstates_ * sizeof(typename ConstFstImpl<A, U>::State);
   impl->states_region_.reset(
-      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.map_advice, opts.map_hugepages));
   if (!strm || !impl->states_region_) {
     LOG(ERROR) << "ConstFst::Read: Read failed: " << opts.source;
     return nullptr;
@@ -221,7 +219,8 @@ ConstFstImpl<A, U> *ConstFstImpl<A, U>::Read(std::istream &strm,
 
   b = impl->narcs_ * sizeof(A);
   impl->arcs_region_.reset(
-      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b));
+      MappedFile::Map(&strm, opts.mode == FstReadOptions::MAP, opts.source, b,
+                      opts.map_advice, opts.map_hugepages));
   if (!strm || !impl->arcs_region_) {
     LOG(ERROR) << "ConstFst::Read: Read failed: " << opts.source;
     return nullptr;
@@ -300,6 +299,18 @@ class ConstFst : public ImplToExpandedFst<ConstFstImpl<A, U>> {
 
   using ImplToFst<Impl, ExpandedFst<A>>::GetImpl;
 
+  // Number of states or arcs gathered before each write in WriteFst().
+  static const size_t kWriteBufferSize = 1 << 16;
+
+  // Writes out and clears the buffer.
+  template <class T>
+  static void WriteBuffer(std::ostream &strm, std::vector<T> *buffer) {
+    if (buffer->empty()) return;
+    strm.write(reinterpret_cast<const char *>(buffer->data()),
+               buffer->size() * sizeof(T));
+    buffer->clear();
+  }
+
   // Use overloading to extract the type of the argument.
   static const Impl *GetImplIfConstFst(const ConstFst &const_fst) {
     return const_fst.GetImpl();
@@ -314,6 +325,9 @@ class ConstFst : public ImplToExpandedFst<ConstFstImpl<A, U>> {
   ConstFst &operator=(const ConstFst &fst) = delete;
 };
 
+template <class A, class U>
+const size_t ConstFst<A, U>::kWriteBufferSize;
+
 // Writes Fst in Const format, potentially with a pass over the machine
 // before writing to compute number of states and arcs.
 //
@@ -326,7 +340,8 @@ bool ConstFst<A, U>::WriteFst(const F &fst, std::ostream &strm,
   size_t num_arcs = -1, num_states = -1;
   size_t start_offset = 0;
   bool update_header = true;
-  if (const Impl *impl = GetImplIfConstFst(fst)) {
+  const Impl *impl = GetImplIfConstFst(fst);
+  if (impl) {
     num_arcs = impl->narcs_;
     num_states = impl->nstates_;
     update_header = false;
@@ -358,29 +373,54 @@ bool ConstFst<A, U>::WriteFst(const F &fst, std::ostream &strm,
     LOG(ERROR) << "Could not align file during write after header";
     return false;
   }
+  // A ConstFst source is written straight from its state and arc arrays;
+  // otherwise, states and arcs are gathered into buffers written in blocks.
   size_t pos = 0, states = 0;
-  typename ConstFstImpl<A, U>::State state;
-  for (StateIterator<F> siter(fst); !siter.Done(); siter.Next()) {
-    state.final = fst.Final(siter.Value());
-    state.pos = pos;
-    state.narcs = fst.NumArcs(siter.Value());
-    state.niepsilons = fst.NumInputEpsilons(siter.Value());
-    state.noepsilons = fst.NumOutputEpsilons(siter.Value());
-    strm.write(reinterpret_cast<const char *>(&state), sizeof(state));
-    pos += state.narcs;
-    ++states;
+  if (impl) {
+    strm.write(reinterpret_cast<const char *>(impl->states_),
+               impl->nstates_ * sizeof(*impl->states_));
+    states = impl->nstates_;
+    pos = impl->narcs_;
+  } else {
+    std::vector<typename ConstFstImpl<A, U>::State> state_buffer;
+    state_buffer.reserve(kWriteBufferSize);
+    typename ConstFstImpl<A, U>::State state;
+    for (StateIterator<F> siter(fst); !siter.Done(); siter.Next()) {
+      state.final = fst.Final(siter.Value());
+      state.pos = pos;
+      state.narcs = fst.NumArcs(siter.Value());
+      state.niepsilons = fst.NumInputEpsilons(siter.Value());
+      state.noepsilons = fst.NumOutputEpsilons(siter.Value());
+      state_buffer.push_back(state);
+      if (state_buffer.size() == kWriteBufferSize) {
+        WriteBuffer(strm, &state_buffer);
+      }
+      pos += state.narcs;
+      ++states;
+    }
+    WriteBuffer(strm, &state_buffer);
   }
   hdr.SetNumStates(states);
   hdr.SetNumArcs(pos);
   if (opts.align && !AlignOutput(strm)) {
     LOG(ERROR) << "Could not align file during write after writing states";
   }
-  for (StateIterator<F> siter(fst); !siter.Done(); siter.Next()) {
-    StateId s = siter.Value();
-    for (ArcIterator<F> aiter(fst, s); !aiter.Done(); aiter.Next()) {
-      const A &arc = aiter.Value();
-      strm.write(reinterpret_cast<const char *>(&arc), sizeof(arc));
+  if (impl) {
+    strm.write(reinterpret_cast<const char *>(impl->arcs_),
+               impl->narcs_ * sizeof(*impl->arcs_));
+  } else {
+    std::vector<A> arc_buffer;
+    arc_buffer.reserve(kWriteBufferSize);
+    for (StateIterator<F> siter(fst); !siter.Done(); siter.Next()) {
+      StateId s = siter.Value();
+      for (ArcIterator<F> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        arc_buffer.push_back(aiter.Value());
+        if (arc_buffer.size() == kWriteBufferSize) {
+          WriteBuffer(strm, &arc_buffer);
+        }
+      }
     }
+    WriteBuffer(strm, &arc_buffer);
   }
   strm.flush();
   if (!strm) {
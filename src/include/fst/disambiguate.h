@@ -8,9 +8,13 @@
 
 #include <algorithm>
 #include <climits>
+#include <deque>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <fst/arcsort.h>
@@ -255,6 +259,17 @@ class Disambiguator {
     const std::vector<StateId> &head_;
   };
 
+  // Hashes a pair of state IDs, as the composition state tuples do.
+  class StatePairHash {
+   public:
+    size_t operator()(const std::pair<StateId, StateId> &pr) const {
+      return pr.first + pr.second * 7853;
+    }
+  };
+
+  typedef std::unordered_set<std::pair<StateId, StateId>, StatePairHash>
+      StatePairSet;
+
   // A relation that determines if two states share a common future.
   class CommonFuture {
    public:
@@ -262,7 +277,7 @@ class Disambiguator {
     typedef typename T::StateTuple StateTuple;
 
     // Needed for compilation with DeterminizeRelationFilter
-    CommonFuture() {
+    CommonFuture() : related_(std::make_shared<StatePairSet>()) {
       FSTERROR() << "Disambiguate::CommonFuture: Fst not provided";
     }
 
@@ -275,31 +290,36 @@ class Disambiguator {
       const Fst<Arc> *fsa =
           trans ? new ProjectFst<Arc>(ifst, PROJECT_INPUT) : &ifst;
 
-      opts.state_table = new T(*fsa, *fsa);
+      // The self-composition has at least one state per input state.
+      opts.state_table = new T(*fsa, *fsa, CountStates(ifst));
       ComposeFst<Arc> cfst(*fsa, *fsa, opts);
       std::vector<bool> coaccess;
       uint64 props = 0;
       SccVisitor<Arc> scc_visitor(nullptr, nullptr, &coaccess, &props);
       DfsVisit(cfst, &scc_visitor);
+      auto *related = new StatePairSet();
+      related->reserve(std::count(coaccess.begin(), coaccess.end(), true));
       for (StateId s = 0; s < coaccess.size(); ++s) {
         if (coaccess[s]) {
           const StateTuple &tuple = opts.state_table->Tuple(s);
-          related_.insert(tuple.StatePair());
+          related->insert(tuple.StatePair());
         }
       }
+      related_.reset(related);
       if (trans) delete fsa;
     }
 
     bool operator()(const StateId s1, StateId s2) const {
       std::pair<StateId, StateId> pr(s1, s2);
-      return related_.count(pr) > 0;
+      return related_->count(pr) > 0;
     }
 
    private:
     // States s1 and s2 resp. are in this relation iff they there is a
     // path from s1 to a final state that has the same label as some
-    // path from s2 to a final state.
-    std::set<std::pair<StateId, StateId>> related_;
+    // path from s2 to a final state. The relation is immutable once
+    // built, so copies of the filter share it.
+    std::shared_ptr<const StatePairSet> related_;
   };
 
   typedef std::multimap<ArcId, ArcId, ArcIdCompare> ArcIdMap;
@@ -342,10 +362,10 @@ class Disambiguator {
   // from the initial state to s1 that has the same label as some path
   // from the initial state to s2.  We store only state pairs s1, s2
   // such that s1 <= s2.
-  std::set<std::pair<StateId, StateId>> coreachable_;
+  StatePairSet coreachable_;
   // Queue of disambiguation-related states to be processed. We store
   // only state pairs s1, s2 such that s1 <= s2.
-  std::list<std::pair<StateId, StateId>> queue_;
+  std::deque<std::pair<StateId, StateId>> queue_;
   // Head state in the pre-disambiguation for a given state.
   std::vector<StateId> head_;
   // Maps from a candidate ambiguous arc A to each ambiguous candidate arc
@@ -8,6 +8,7 @@
 
 #include <fstream>
 #include <istream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -87,6 +88,12 @@ class StringReader {
     }
   }
 
+  // Compiles the current input into an existing FST, replacing its contents.
+  // Reusing one FST across inputs avoids a per-entry FST allocation.
+  bool GetCompactFst(CompactStringFst<A> *fst) {
+    return compiler_(content_, fst);
+  }
+
   CompactStringFst<A> *GetCompactFst(bool keep_symbols = false) {
     std::unique_ptr<CompactStringFst<A>> fst;
     if (keep_symbols) {
@@ -123,6 +130,15 @@ class StringReader {
 // number.
 int KeySize(const char *filename);
 
+// Appends a decimal number to a key, left-padded with zeros to the given
+// width.
+inline void AppendPadded(const string &number, int width, string *key) {
+  if (width > static_cast<int>(number.size())) {
+    key->append(width - number.size(), '0');
+  }
+  key->append(number);
+}
+
 template <class Arc>
 void FarCompileStrings(const std::vector<string> &in_fnames,
                        const string &out_fname, const string &fst_type,
@@ -210,17 +226,34 @@ void FarCompileStrings(const std::vector<string> &in_fnames,
     }
     std::istream &istrm = fstrm.is_open() ? fstrm : std::cin;
 
+    string base;
+    if (generate_keys == 0) {
+      std::unique_ptr<char[]> filename(new char[in_fname.size() + 1]);
+      strcpy(filename.get(), in_fname.c_str());
+      base = basename(filename.get());
+    }
+
+    // Entries without symbol tables are compiled into one reused compact FST
+    // and written straight to the archive.
+    CompactStringFst<Arc> compact_fst;
+    string key;
     bool keep_syms = keep_symbols;
     for (StringReader<Arc> reader(
              istrm, in_fname.empty() ? "stdin" : in_fname, entry_type,
              token_type, allow_negative_labels, syms.get(), unknown_label);
          !reader.Done(); reader.Next()) {
       ++n;
-      std::unique_ptr<const Fst<Arc>> fst;
-      if (compact) {
-        fst.reset(reader.GetCompactFst(keep_syms));
+      std::unique_ptr<const Fst<Arc>> owned_fst;
+      const Fst<Arc> *fst = nullptr;
+      if (compact && !keep_syms) {
+        if (reader.GetCompactFst(&compact_fst)) fst = &compact_fst;
       } else {
-        fst.reset(reader.GetVectorFst(keep_syms));
+        if (compact) {
+          owned_fst.reset(reader.GetCompactFst(keep_syms));
+        } else {
+          owned_fst.reset(reader.GetVectorFst(keep_syms));
+        }
+        fst = owned_fst.get();
       }
       if (initial_symbols) keep_syms = false;
       if (!fst) {
@@ -237,24 +270,19 @@ void FarCompileStrings(const std::vector<string> &in_fnames,
                            : (fet == FET_FILE ? "file" : "unknown"));
         return;
       }
-      std::ostringstream keybuf;
-      keybuf.width(key_size);
-      keybuf.fill('0');
-      keybuf << n;
-      string key;
+      const string number = std::to_string(n);
+      key.assign(key_prefix);
       if (generate_keys > 0) {
-        key = keybuf.str();
+        AppendPadded(number, key_size, &key);
       } else {
-        char *filename = new char[in_fname.size() + 1];
-        strcpy(filename, in_fname.c_str());
-        key = basename(filename);
+        key.append(base);
         if (entry_type != StringReader<Arc>::FILE) {
-          key += "-";
-          key += keybuf.str();
+          key.append("-");
+          AppendPadded(number, key_size, &key);
         }
-        delete[] filename;
       }
-      far_writer->Add(key_prefix + key + key_suffix, *fst);
+      key.append(key_suffix);
+      far_writer->Add(key, *fst);
     }
     if (generate_keys == 0) n = 0;
   }
@@ -251,12 +251,27 @@ FarWriter<A> *FarWriter<A>::Create(const string &filename, FarType type) {
   }
 }
 
+// Reads archive entries. Entries in vector format are read into a VectorFst
+// kept by the reader and returned as a copy sharing its implementation. Once
+// the previous entry has been released, the next one reuses its state and arc
+// storage, so scanning an archive does not allocate per state or arc. Copies
+// of an entry remain valid, since the shared implementation is not reused.
 template <class A>
 class FstReader {
  public:
-  Fst<A> *operator()(std::istream &strm) const {
-    return Fst<A>::Read(strm, FstReadOptions());
+  Fst<A> *operator()(std::istream &strm) {
+    if (!hdr_.Read(strm, opts_.source)) return nullptr;
+    opts_.header = &hdr_;
+    if (hdr_.FstType() == fst_.Type() && hdr_.ArcType() == A::Type()) {
+      return fst_.ReadInPlace(strm, opts_) ? new VectorFst<A>(fst_) : nullptr;
+    }
+    return Fst<A>::Read(strm, opts_);
   }
+
+ private:
+  FstHeader hdr_;
+  FstReadOptions opts_;
+  VectorFst<A> fst_;
 };
 
 template <class A>
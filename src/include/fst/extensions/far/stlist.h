@@ -95,7 +95,7 @@ class STListWriter {
 // following interface:
 //
 //   struct Reader {
-//     T *operator()(std::istream &) const;
+//     T *operator()(std::istream &);
 //   };
 //
 template <class T, class R>
@@ -203,6 +203,7 @@ class STListReader {
 
     if (!heap_.empty()) {
       current = heap_.top().second;
+      entry_.reset();  // Lets the reader reuse the previous entry's storage.
       entry_.reset(entry_reader_(*streams_[current]));
       if (!entry_ || !*streams_[current]) {
         FSTERROR() << "STListReader: Error reading entry for key: "
@@ -94,7 +94,7 @@ class STTableWriter {
 // following interface:
 //
 //   struct Reader {
-//     T *operator()(std::istream &) const;
+//     T *operator()(std::istream &);
 //   };
 //
 template <class T, class R>
@@ -277,6 +277,7 @@ class STTableReader {
   void PopHeap() {
     std::pop_heap(heap_.begin(), heap_.end(), *compare_);
     current_ = heap_.back();
+    entry_.reset();  // Lets the reader reuse the previous entry's storage.
     entry_.reset(entry_reader_(*streams_[current_]));
     if (!entry_) error_ = true;
     if (streams_[current_]->fail()) {
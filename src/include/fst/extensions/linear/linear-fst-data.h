@@ -31,8 +31,6 @@ class FeatureGroup;
 // either `LinearFstDataBuilder::Dump()` or `LinearFstData::Read()`
 // and usually used as refcount'd object shared across mutiple
 // `LinearTaggerFst` copies.
-//
-// TODO(wuke): more efficient trie implementation
 template <class A>
 class LinearFstData {
  public:
@@ -107,8 +105,11 @@ class LinearFstData {
             typename std::vector<Label>::const_iterator>
   PossibleOutputLabels(Label word) const;
 
-  static LinearFstData<A> *Read(std::istream &strm);  // NOLINT
-  std::ostream &Write(std::ostream &strm) const;      // NOLINT
+  // Reads the data; `legacy_trie` selects the hash map trie layout
+  // written by older file versions, which is compiled on load.
+  static LinearFstData<A> *Read(std::istream &strm,  // NOLINT
+                                bool legacy_trie = false);
+  std::ostream &Write(std::ostream &strm) const;  // NOLINT
 
  private:
   // Offsets in `output_pool_`
@@ -153,14 +154,28 @@ void LinearFstData<A>::TakeTransition(Iterator buffer_end,
   DCHECK_EQ(trie_state_end - trie_state_begin, groups_.size());
   DCHECK(ilabel > 0 || ilabel == kEndOfSentence);
   DCHECK(olabel > 0 || olabel == kStartOfSentence);
+  // All groups are walked in one pass. The per-group feature labels of
+  // a word are adjacent in `group_feat_map_`, so the row is looked up
+  // once per distinct (possibly delayed) input word rather than per group.
+  next->reserve(next->size() + groups_.size());
+  Label row_word = kNoLabel;
+  const Label *row = nullptr;
   size_t group_id = 0;
   for (Iterator it = trie_state_begin; it != trie_state_end; ++it, ++group_id) {
-    size_t delay = groups_[group_id]->Delay();
+    const FeatureGroup<A> &group = *groups_[group_id];
+    size_t delay = group.Delay();
     // On the buffer, there may also be `kStartOfSentence` from the
     // initial empty buffer.
     Label real_ilabel = delay == 0 ? ilabel : *(buffer_end - delay);
-    next->push_back(
-        GroupTransition(group_id, *it, real_ilabel, olabel, weight));
+    Label group_ilabel = real_ilabel;
+    if (real_ilabel > 0) {
+      if (real_ilabel != row_word) {
+        row_word = real_ilabel;
+        row = group_feat_map_.Row(real_ilabel);
+      }
+      group_ilabel = row[group_id];
+    }
+    next->push_back(group.Walk(*it, group_ilabel, olabel, weight));
   }
 }
 
@@ -199,7 +214,8 @@ LinearFstData<A>::PossibleOutputLabels(Label word) const {
 }
 
 template <class A>
-inline LinearFstData<A> *LinearFstData<A>::Read(std::istream &strm) {  // NOLINT
+inline LinearFstData<A> *LinearFstData<A>::Read(std::istream &strm,  // NOLINT
+                                                bool legacy_trie) {
   std::unique_ptr<LinearFstData<A>> data(new LinearFstData<A>());
   ReadType(strm, &(data->max_future_size_));
   ReadType(strm, &(data->max_input_label_));
@@ -208,7 +224,7 @@ inline LinearFstData<A> *LinearFstData<A>::Read(std::istream &strm) {  // NOLINT
   ReadType(strm, &num_groups);
   data->groups_.resize(num_groups);
   for (size_t i = 0; i < num_groups; ++i)
-    data->groups_[i].reset(FeatureGroup<A>::Read(strm));
+    data->groups_[i].reset(FeatureGroup<A>::Read(strm, legacy_trie));
   // Other data
   ReadType(strm, &(data->input_attribs_));
   ReadType(strm, &(data->output_pool_));
@@ -302,13 +318,21 @@ class FeatureGroup {
     return trie_[trie_state].final_weight;
   }
 
-  static FeatureGroup<A> *Read(std::istream &strm) {  // NOLINT
+  static FeatureGroup<A> *Read(std::istream &strm,  // NOLINT
+                               bool legacy_trie = false) {
     size_t delay;
     ReadType(strm, &delay);
     int start;
     ReadType(strm, &start);
     Trie trie;
-    ReadType(strm, &trie);
+    if (legacy_trie) {
+      LegacyTrie legacy;
+      ReadType(strm, &legacy);
+      Trie compiled(legacy);
+      trie.swap(compiled);
+    } else {
+      ReadType(strm, &trie);
+    }
     std::unique_ptr<FeatureGroup<A>> ret(new FeatureGroup<A>(delay, start));
     ret->trie_.swap(trie);
     ReadType(strm, &ret->next_state_);
@@ -364,8 +388,15 @@ class FeatureGroup {
     }
   };
 
-  typedef FlatTrieTopology<InputOutputLabel, InputOutputLabelHash> Topology;
+  // The trie is compiled into a flat edge table once it is built,
+  // since `Walk()` only ever looks edges up.
+  typedef CompiledTrieTopology<InputOutputLabel, InputOutputLabelHash>
+      Topology;
   typedef MutableTrie<InputOutputLabel, WeightBackLink, Topology> Trie;
+  // On-disk layout of file versions preceding the compiled trie.
+  typedef MutableTrie<InputOutputLabel, WeightBackLink,
+                      FlatTrieTopology<InputOutputLabel, InputOutputLabelHash>>
+      LegacyTrie;
 
   explicit FeatureGroup(size_t delay, int start)
       : delay_(delay), start_(start) {}
@@ -399,6 +430,10 @@ struct FeatureGroup<A>::InputOutputLabel {
     return input == that.input && output == that.output;
   }
 
+  bool operator<(InputOutputLabel that) const {
+    return input < that.input || (input == that.input && output < that.output);
+  }
+
   std::istream &Read(std::istream &strm) {  // NOLINT
     ReadType(strm, &input);
     ReadType(strm, &output);
@@ -487,6 +522,11 @@ class LinearFstData<A>::GroupFeatureMap {
     return pool_[IndexOf(group_id, ilabel)];
   }
 
+  // Returns the features of all groups for `ilabel`, indexed by group.
+  const Label *Row(Label ilabel) const {
+    return pool_.data() + IndexOf(0, ilabel);
+  }
+
   bool Set(size_t group_id, Label ilabel, Label feat) {
     size_t i = IndexOf(group_id, ilabel);
     if (pool_[i] != kNoLabel && pool_[i] != feat) {
@@ -139,6 +139,11 @@ class LinearTaggerFstImpl : public CacheImpl<A> {
   static LinearTaggerFstImpl *Read(std::istream &strm,
                                    const FstReadOptions &opts);
 
+  // Returns the shared immutable feature data.
+  const std::shared_ptr<const LinearFstData<A>> &Data() const {
+    return data_;
+  }
+
   bool Write(std::ostream &strm,  // NOLINT
              const FstWriteOptions &opts) const {
     FstHeader header;
@@ -282,7 +287,7 @@ template <class A>
 const int LinearTaggerFstImpl<A>::kMinFileVersion = 1;
 
 template <class A>
-const int LinearTaggerFstImpl<A>::kFileVersion = 1;
+const int LinearTaggerFstImpl<A>::kFileVersion = 2;
 
 template <class A>
 inline typename A::Label LinearTaggerFstImpl<A>::ShiftBuffer(
@@ -430,7 +435,9 @@ inline LinearTaggerFstImpl<A> *LinearTaggerFstImpl<A>::Read(
   if (!impl->ReadHeader(strm, opts, kMinFileVersion, &header)) {
     return nullptr;
   }
-  impl->data_ = std::shared_ptr<LinearFstData<A>>(LinearFstData<A>::Read(strm));
+  // Version 1 files store the feature tries as hash maps.
+  impl->data_ = std::shared_ptr<LinearFstData<A>>(
+      LinearFstData<A>::Read(strm, header.Version() < 2));
   if (!impl->data_) {
     return nullptr;
   }
@@ -488,6 +495,11 @@ class LinearTaggerFst : public ImplToFst<LinearTaggerFstImpl<A>> {
     return new LinearFstMatcherTpl<LinearTaggerFst<A>>(*this, match_type);
   }
 
+  // Returns the shared immutable feature data, e.g. for `LinearTagger`.
+  std::shared_ptr<const LinearFstData<A>> Data() const {
+    return GetImpl()->Data();
+  }
+
   static LinearTaggerFst<A> *Read(const string &filename) {
     if (!filename.empty()) {
       std::ifstream strm(filename.c_str(),
@@ -795,7 +807,7 @@ template <class A>
 const int LinearClassifierFstImpl<A>::kMinFileVersion = 0;
 
 template <class A>
-const int LinearClassifierFstImpl<A>::kFileVersion = 0;
+const int LinearClassifierFstImpl<A>::kFileVersion = 1;
 
 template <class A>
 void LinearClassifierFstImpl<A>::Expand(StateId s) {
@@ -870,7 +882,9 @@ inline LinearClassifierFstImpl<A> *LinearClassifierFstImpl<A>::Read(
   if (!impl->ReadHeader(strm, opts, kMinFileVersion, &header)) {
     return nullptr;
   }
-  impl->data_ = std::shared_ptr<LinearFstData<A>>(LinearFstData<A>::Read(strm));
+  // Version 0 files store the feature tries as hash maps.
+  impl->data_ = std::shared_ptr<LinearFstData<A>>(
+      LinearFstData<A>::Read(strm, header.Version() < 1));
   if (!impl->data_) {
     return nullptr;
   }
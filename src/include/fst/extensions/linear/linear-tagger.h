@@ -0,0 +1,242 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Direct Viterbi decoding of input sentences with the feature data of
+// a LinearTaggerFst.
+
+#ifndef FST_EXTENSIONS_LINEAR_LINEAR_TAGGER_H_
+#define FST_EXTENSIONS_LINEAR_LINEAR_TAGGER_H_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <fst/compat.h>
+#include <fst/extensions/linear/linear-fst-data.h>
+#include <fst/extensions/linear/linear-fst.h>
+#include <fst/weight.h>
+
+namespace fst {
+
+// Finds the best tag sequence of a sentence under a linear model. The
+// result is the same as the output projection of
+//
+//   ShortestPath(Compose(sentence_fst, LinearTaggerFst(data)))
+//
+// but the search runs directly over tuples of trie states, so no
+// ComposeFst or tagger cache is built. Since the input is a string,
+// the search is a left-to-right Viterbi pass that keeps one best
+// hypothesis per trie state tuple at each position.
+//
+// A tagger only holds scratch space; the `LinearFstData` is immutable
+// and may be shared by any number of taggers, e.g. one per worker.
+// The weight must have the path property.
+template <class A>
+class LinearTagger {
+ public:
+  typedef typename A::Label Label;
+  typedef typename A::Weight Weight;
+
+  explicit LinearTagger(std::shared_ptr<const LinearFstData<A>> data)
+      : data_(std::move(data)),
+        num_groups_(data_->NumGroups()),
+        delay_(data_->MaxFutureSize()),
+        error_(false) {
+    if ((Weight::Properties() & (kPath | kSemiring)) != (kPath | kSemiring)) {
+      FSTERROR() << "LinearTagger: Weight needs to have the path property: "
+                 << Weight::Type();
+      error_ = true;
+    }
+  }
+
+  explicit LinearTagger(const LinearTaggerFst<A> &fst)
+      : LinearTagger(fst.Data()) {}
+
+  // Tags `words` (all in `[MinInputLabel(), MaxInputLabel()]` of the
+  // data), writing one output label per word to `tags`. The weight of
+  // the best path is returned in `weight` if non-null. Returns false
+  // if there is no successful path.
+  bool Tag(const std::vector<Label> &words, std::vector<Label> *tags,
+           Weight *weight = nullptr);
+
+  // Tags each sentence in turn, reusing the scratch space. Sentences
+  // without a successful path are given no tags. Returns false if any
+  // sentence failed.
+  bool TagBatch(const std::vector<std::vector<Label>> &sentences,
+                std::vector<std::vector<Label>> *tags);
+
+  bool Error() const { return error_; }
+
+ private:
+  // A lattice entry: best weight of a trie state tuple at some
+  // position, with the back-pointer and output label reaching it.
+  struct Hyp {
+    Weight weight;
+    int back;
+    Label olabel;
+
+    Hyp(Weight w, int b, Label o) : weight(std::move(w)), back(b), olabel(o) {}
+  };
+
+  // Finds the hypothesis at the next position with trie state tuple
+  // `tuple`, adding it if missing. Returns the lattice index.
+  int FindOrAddNext(const std::vector<Label> &tuple, bool *added);
+
+  size_t TupleHash(const Label *tuple) const {
+    size_t h = 0;
+    for (size_t i = 0; i < num_groups_; ++i) h = h * 7853 + tuple[i];
+    return h;
+  }
+
+  std::shared_ptr<const LinearFstData<A>> data_;
+  size_t num_groups_;
+  size_t delay_;
+  bool error_;
+
+  std::vector<Hyp> lattice_;
+  // Trie state tuples of the current and next position, `num_groups_`
+  // labels each, parallel to the lattice entries of that position.
+  std::vector<Label> cur_tuples_, next_tuples_;
+  size_t next_begin_;  // Lattice index of the first next hypothesis.
+  // Open-addressing table over next hypotheses; -1 marks empty slots.
+  std::vector<int> next_table_;
+  std::vector<Label> padded_, next_stub_;
+};
+
+template <class A>
+int LinearTagger<A>::FindOrAddNext(const std::vector<Label> &tuple,
+                                   bool *added) {
+  const size_t num_next = lattice_.size() - next_begin_;
+  if (2 * (num_next + 1) > next_table_.size()) {
+    next_table_.assign(std::max<size_t>(16, 2 * next_table_.size()), -1);
+    const size_t mask = next_table_.size() - 1;
+    for (size_t i = 0; i < num_next; ++i) {
+      size_t slot = TupleHash(&next_tuples_[i * num_groups_]) & mask;
+      while (next_table_[slot] != -1) slot = (slot + 1) & mask;
+      next_table_[slot] = i;
+    }
+  }
+  const size_t mask = next_table_.size() - 1;
+  size_t slot = TupleHash(tuple.data()) & mask;
+  for (; next_table_[slot] != -1; slot = (slot + 1) & mask) {
+    const int i = next_table_[slot];
+    if (std::equal(tuple.begin(), tuple.end(),
+                   next_tuples_.begin() + i * num_groups_)) {
+      *added = false;
+      return next_begin_ + i;
+    }
+  }
+  next_table_[slot] = num_next;
+  next_tuples_.insert(next_tuples_.end(), tuple.begin(), tuple.end());
+  lattice_.emplace_back(Weight::Zero(), -1, kNoLabel);
+  *added = true;
+  return lattice_.size() - 1;
+}
+
+template <class A>
+bool LinearTagger<A>::Tag(const std::vector<Label> &words,
+                          std::vector<Label> *tags, Weight *weight) {
+  tags->clear();
+  if (error_) return false;
+  for (const auto word : words) {
+    if (word < data_->MinInputLabel() || word > data_->MaxInputLabel())
+      return false;
+  }
+  const Label kStart = LinearFstData<A>::kStartOfSentence;
+  const Label kEnd = LinearFstData<A>::kEndOfSentence;
+  const size_t n = words.size();
+  // The tagger reads the words and then flushes its look-ahead buffer
+  // with `delay_` end-of-sentence steps; with no input there is no
+  // buffer to flush.
+  const size_t num_steps = n == 0 ? 0 : n + delay_;
+  // Position `t` (1-based) of the sentence is `padded_[delay_ + t - 1]`,
+  // with start- and end-of-sentence paddings on either side, so that
+  // the buffer of the tagger before step `t` ends at `delay_ + t - 1`.
+  padded_.assign(delay_, kStart);
+  padded_.insert(padded_.end(), words.begin(), words.end());
+  padded_.insert(padded_.end(), delay_, kEnd);
+
+  lattice_.clear();
+  cur_tuples_.clear();
+  data_->EncodeStartState(&cur_tuples_);
+  lattice_.emplace_back(Weight::One(), -1, kNoLabel);
+  size_t cur_begin = 0;
+  NaturalLess<Weight> less;
+  const std::vector<Label> start_only(1, kStart);
+  for (size_t t = 1; t <= num_steps; ++t) {
+    const Label ilabel = t <= n ? words[t - 1] : kEnd;
+    // The output label is for the word `delay_` positions back; before
+    // the first word leaves the buffer, only start-of-sentence is output.
+    typename std::vector<Label>::const_iterator obegin = start_only.begin();
+    typename std::vector<Label>::const_iterator oend = start_only.end();
+    if (t > delay_) {
+      auto range = data_->PossibleOutputLabels(words[t - delay_ - 1]);
+      obegin = range.first;
+      oend = range.second;
+    }
+    const auto buffer_end = padded_.cbegin() + delay_ + t - 1;
+    next_begin_ = lattice_.size();
+    next_tuples_.clear();
+    std::fill(next_table_.begin(), next_table_.end(), -1);
+    const size_t cur_end = next_begin_;
+    for (size_t h = cur_begin; h < cur_end; ++h) {
+      const auto tuple_begin =
+          cur_tuples_.cbegin() + (h - cur_begin) * num_groups_;
+      for (auto it = obegin; it != oend; ++it) {
+        Weight w = Weight::One();
+        next_stub_.clear();
+        data_->TakeTransition(buffer_end, tuple_begin,
+                              tuple_begin + num_groups_, ilabel, *it,
+                              &next_stub_, &w);
+        w = Times(lattice_[h].weight, w);
+        if (w == Weight::Zero()) continue;
+        bool added;
+        const int next = FindOrAddNext(next_stub_, &added);
+        if (added || less(w, lattice_[next].weight)) {
+          lattice_[next].weight = w;
+          lattice_[next].back = h;
+          lattice_[next].olabel = *it;
+        }
+      }
+    }
+    cur_begin = next_begin_;
+    cur_tuples_.swap(next_tuples_);
+  }
+  // Picks the best final hypothesis.
+  int best = -1;
+  Weight best_weight = Weight::Zero();
+  for (size_t h = cur_begin; h < lattice_.size(); ++h) {
+    const auto tuple_begin =
+        cur_tuples_.cbegin() + (h - cur_begin) * num_groups_;
+    const Weight w =
+        Times(lattice_[h].weight,
+              data_->FinalWeight(tuple_begin, tuple_begin + num_groups_));
+    if (w != Weight::Zero() && (best == -1 || less(w, best_weight))) {
+      best = h;
+      best_weight = w;
+    }
+  }
+  if (best == -1) return false;
+  for (int h = best; h > 0; h = lattice_[h].back) {
+    if (lattice_[h].olabel != kStart) tags->push_back(lattice_[h].olabel);
+  }
+  std::reverse(tags->begin(), tags->end());
+  if (weight) *weight = best_weight;
+  return true;
+}
+
+template <class A>
+bool LinearTagger<A>::TagBatch(
+    const std::vector<std::vector<Label>> &sentences,
+    std::vector<std::vector<Label>> *tags) {
+  tags->resize(sentences.size());
+  bool ok = true;
+  for (size_t i = 0; i < sentences.size(); ++i) {
+    if (!Tag(sentences[i], &(*tags)[i])) ok = false;
+  }
+  return ok;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_LINEAR_LINEAR_TAGGER_H_
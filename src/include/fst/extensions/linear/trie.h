@@ -4,6 +4,8 @@
 #ifndef FST_EXTENSIONS_LINEAR_TRIE_H_
 #define FST_EXTENSIONS_LINEAR_TRIE_H_
 
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,6 +22,8 @@ template <class L, class H>
 class NestedTrieTopology;
 template <class L, class H>
 class FlatTrieTopology;
+template <class L, class H>
+class CompiledTrieTopology;
 
 // A pair of parent node id and label, part of a trie edge
 template <class L>
@@ -324,6 +328,205 @@ inline int FlatTrieTopology<L, H>::Find(int parent, const L &label) const {
   return it == next_.end() ? kNoTrieNodeId : it->second;
 }
 
+// An immutable-after-build trie topology stored in a single flat
+// open-addressing table of (parent, label, child) edges. Lookups touch
+// one contiguous array instead of following hash map node chains, which
+// makes it suitable for the hot `Find()` calls in decoding. The edges
+// are serialized as a list sorted by (parent, label) and the table is
+// rebuilt on load, so files do not depend on the hash function or on the
+// width of `size_t`. `L` must therefore also provide `operator<`.
+template <class L, class H>
+class CompiledTrieTopology {
+ public:
+  typedef L Label;
+  typedef H Hash;
+
+  CompiledTrieTopology() : num_edges_(0), table_(kMinTableSize) {}
+  template <class T>
+  explicit CompiledTrieTopology(const T &that);
+
+  void swap(CompiledTrieTopology &that) {
+    std::swap(num_edges_, that.num_edges_);
+    table_.swap(that.table_);
+  }
+
+  bool operator==(const CompiledTrieTopology &that) const;
+  bool operator!=(const CompiledTrieTopology &that) const {
+    return !(*this == that);
+  }
+
+  int Root() const { return 0; }
+  size_t NumNodes() const { return num_edges_ + 1; }
+  int Insert(int parent, const L &label);
+  int Find(int parent, const L &label) const;
+
+  std::istream &Read(std::istream &strm);         // NOLINT
+  std::ostream &Write(std::ostream &strm) const;  // NOLINT
+
+ private:
+  static constexpr size_t kMinTableSize = 8;
+
+  // An edge of the trie; `child == kNoTrieNodeId` marks an empty slot.
+  struct Edge {
+    int parent;
+    L label;
+    int child;
+
+    Edge() : parent(kNoTrieNodeId), label(), child(kNoTrieNodeId) {}
+
+    bool operator==(const Edge &that) const {
+      return parent == that.parent && label == that.label &&
+             child == that.child;
+    }
+
+    std::istream &Read(std::istream &strm) {  // NOLINT
+      ReadType(strm, &parent);
+      ReadType(strm, &label);
+      ReadType(strm, &child);
+      return strm;
+    }
+
+    std::ostream &Write(std::ostream &strm) const {  // NOLINT
+      WriteType(strm, parent);
+      WriteType(strm, label);
+      WriteType(strm, child);
+      return strm;
+    }
+  };
+
+  size_t Bucket(int parent, const L &label) const {
+    // Fibonacci hashing spreads the weak combined hash over the table.
+    const size_t hash =
+        ParentLabelHash<L, H>()(ParentLabel<L>(parent, label));
+    const uint64 h = static_cast<uint64>(hash) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h >> 32) & (table_.size() - 1);
+  }
+
+  // Places an edge known to be absent; keeps the load factor below 1/2
+  // since most lookups along back-off chains are misses.
+  void AddEdge(int parent, const L &label, int child);
+  void Resize(size_t size);
+
+  size_t num_edges_;
+  std::vector<Edge> table_;  // Size is a power of two.
+};
+
+template <class L, class H>
+constexpr size_t CompiledTrieTopology<L, H>::kMinTableSize;
+
+template <class L, class H>
+template <class T>
+CompiledTrieTopology<L, H>::CompiledTrieTopology(const T &that)
+    : num_edges_(0), table_(kMinTableSize) {
+  size_t size = kMinTableSize;
+  while (size < 2 * that.NumNodes()) size <<= 1;
+  Resize(size);
+  for (auto it = that.begin(); it != that.end(); ++it)
+    AddEdge(it->first.parent, it->first.label, it->second);
+}
+
+template <class L, class H>
+bool CompiledTrieTopology<L, H>::operator==(
+    const CompiledTrieTopology &that) const {
+  if (num_edges_ != that.num_edges_) return false;
+  for (const auto &edge : table_) {
+    if (edge.child != kNoTrieNodeId &&
+        that.Find(edge.parent, edge.label) != edge.child)
+      return false;
+  }
+  return true;
+}
+
+template <class L, class H>
+inline int CompiledTrieTopology<L, H>::Insert(int parent, const L &label) {
+  int ret = Find(parent, label);
+  if (ret == kNoTrieNodeId) {
+    ret = NumNodes();
+    AddEdge(parent, label, ret);
+  }
+  return ret;
+}
+
+template <class L, class H>
+inline int CompiledTrieTopology<L, H>::Find(int parent, const L &label) const {
+  const size_t mask = table_.size() - 1;
+  for (size_t i = Bucket(parent, label);; i = (i + 1) & mask) {
+    const Edge &edge = table_[i];
+    if (edge.child == kNoTrieNodeId) return kNoTrieNodeId;
+    if (edge.parent == parent && edge.label == label) return edge.child;
+  }
+}
+
+template <class L, class H>
+void CompiledTrieTopology<L, H>::AddEdge(int parent, const L &label,
+                                         int child) {
+  if (2 * (num_edges_ + 1) > table_.size()) Resize(2 * table_.size());
+  const size_t mask = table_.size() - 1;
+  size_t i = Bucket(parent, label);
+  while (table_[i].child != kNoTrieNodeId) i = (i + 1) & mask;
+  table_[i].parent = parent;
+  table_[i].label = label;
+  table_[i].child = child;
+  ++num_edges_;
+}
+
+template <class L, class H>
+void CompiledTrieTopology<L, H>::Resize(size_t size) {
+  std::vector<Edge> old(size);
+  old.swap(table_);
+  num_edges_ = 0;
+  for (const auto &edge : old) {
+    if (edge.child != kNoTrieNodeId)
+      AddEdge(edge.parent, edge.label, edge.child);
+  }
+}
+
+template <class L, class H>
+inline std::istream &CompiledTrieTopology<L, H>::Read(
+    std::istream &strm) {  // NOLINT
+  int64 num_edges;
+  if (!ReadType(strm, &num_edges)) return strm;
+  if (num_edges < 0 || num_edges >= std::numeric_limits<int>::max()) {
+    FSTERROR() << "CompiledTrieTopology::Read: Bad number of edges: "
+               << num_edges;
+    strm.setstate(std::ios_base::failbit);
+    return strm;
+  }
+  CompiledTrieTopology topology;
+  for (int64 i = 0; i < num_edges; ++i) {
+    Edge edge;
+    if (!edge.Read(strm)) return strm;
+    // Node ids are dense: the root is 0 and each edge adds one child.
+    if (edge.parent < 0 || edge.parent > num_edges || edge.child <= 0 ||
+        edge.child > num_edges ||
+        topology.Find(edge.parent, edge.label) != kNoTrieNodeId) {
+      FSTERROR() << "CompiledTrieTopology::Read: Corrupt edge list";
+      strm.setstate(std::ios_base::failbit);
+      return strm;
+    }
+    topology.AddEdge(edge.parent, edge.label, edge.child);
+  }
+  swap(topology);
+  return strm;
+}
+
+template <class L, class H>
+inline std::ostream &CompiledTrieTopology<L, H>::Write(
+    std::ostream &strm) const {  // NOLINT
+  // Sorts the edges so that the output does not depend on the hash order.
+  std::vector<Edge> edges;
+  edges.reserve(num_edges_);
+  for (const auto &edge : table_) {
+    if (edge.child != kNoTrieNodeId) edges.push_back(edge);
+  }
+  std::sort(edges.begin(), edges.end(), [](const Edge &x, const Edge &y) {
+    return x.parent < y.parent || (x.parent == y.parent && x.label < y.label);
+  });
+  WriteType(strm, static_cast<int64>(num_edges_));
+  for (const auto &edge : edges) edge.Write(strm);
+  return strm;
+}
+
 // A collection of implementations of the trie data structure. The key
 // is a sequence of type `L` which must be hashable. The value is of
 // `V` which must be default constructible and copyable. In addition,
@@ -36,12 +36,14 @@ class MPdtParenFilter {
                   Matcher1 *matcher1 = nullptr, Matcher2 *matcher2 = nullptr,
                   const std::vector<pair<Label, Label>> *parens = nullptr,
                   const std::vector<typename Arc::Label> *assignments = nullptr,
-                  bool expand = false, bool keep_parens = true)
+                  bool expand = false, bool keep_parens = true,
+                  bool lookahead = false)
       : filter_(fst1, fst2, matcher1, matcher2),
         parens_(parens ? *parens : std::vector<std::pair<Label, Label>>()),
         assignments_(assignments ? *assignments : std::vector<int>()),
         expand_(expand),
         keep_parens_(keep_parens),
+        lookahead_(lookahead),
         f_(FilterState::NoState()),
         stack_(parens_, assignments_),
         paren_id_(-1) {
@@ -57,6 +59,7 @@ class MPdtParenFilter {
         }
       }
     }
+    if (lookahead_) InitLookAhead();
   }
 
   MPdtParenFilter(const Filter &filter, bool safe = false)
@@ -64,9 +67,12 @@ class MPdtParenFilter {
         parens_(filter.parens_),
         expand_(filter.expand_),
         keep_parens_(filter.keep_parens_),
+        lookahead_(filter.lookahead_),
         f_(FilterState::NoState()),
         stack_(filter.parens_, filter.assignments_),
-        paren_id_(-1) {}
+        paren_id_(-1) {
+    if (lookahead_) InitLookAhead();
+  }
 
   FilterState Start() const {
     return FilterState(filter_.Start(), FilterState2(0));
@@ -97,6 +103,10 @@ class MPdtParenFilter {
     if (f1 == FilterState1::NoState()) return FilterState::NoState();
 
     if (arc1->olabel == kNoLabel && arc2->ilabel) {  // arc2 parentheses
+      if (lookahead_ && IsOpenParen(arc2->ilabel) &&
+          !lookahead2_->CanMatch(arc2->nextstate, arc1->nextstate)) {
+        return FilterState::NoState();
+      }
       if (keep_parens_) {
         arc1->ilabel = arc2->ilabel;
       } else if (arc2->ilabel) {
@@ -104,6 +114,10 @@ class MPdtParenFilter {
       }
       return FilterParen(arc2->ilabel, f1, f2);
     } else if (arc2->ilabel == kNoLabel && arc1->olabel) {  // arc1 parentheses
+      if (lookahead_ && IsOpenParen(arc1->olabel) &&
+          !lookahead1_->CanMatch(arc1->nextstate, arc2->nextstate)) {
+        return FilterState::NoState();
+      }
       if (keep_parens_) {
         arc2->olabel = arc1->olabel;
       } else {
@@ -130,6 +144,21 @@ class MPdtParenFilter {
   }
 
  private:
+  // Sets up the open paren lookahead for the PDT being either argument.
+  void InitLookAhead() {
+    const Fst<Arc> &fst1 = GetMatcher1()->GetFst();
+    const Fst<Arc> &fst2 = GetMatcher2()->GetFst();
+    lookahead1_.reset(
+        new ParenLookAhead<Arc>(fst1, fst2, MATCH_OUTPUT, parens_));
+    lookahead2_.reset(
+        new ParenLookAhead<Arc>(fst2, fst1, MATCH_INPUT, parens_));
+  }
+
+  bool IsOpenParen(Label label) const {
+    const ssize_t paren_id = stack_.ParenId(label);
+    return paren_id != -1 && parens_[paren_id].first == label;
+  }
+
   const FilterState FilterParen(Label label, const FilterState1 &f1,
                                 const FilterState2 &f2) const {
     if (!expand_) return FilterState(f1, f2);
@@ -147,6 +176,9 @@ class MPdtParenFilter {
   std::vector<typename Arc::Label> assignments_;
   bool expand_;       // Expands to FST
   bool keep_parens_;  // Retains parentheses in output
+  bool lookahead_;    // Skips open parens whose sub-graph cannot match
+  std::unique_ptr<ParenLookAhead<Arc>> lookahead1_;  // PDT as 1st arg
+  std::unique_ptr<ParenLookAhead<Arc>> lookahead2_;  // PDT as 2nd arg
   FilterState f_;     // Current filter state
   mutable ParenStack stack_;
   ssize_t paren_id_;
@@ -172,12 +204,12 @@ class MPdtComposeFstOptions
                         const std::vector<std::pair<Label, Label>> &parens,
                         const std::vector<typename Arc::Label> &assignments,
                         const Fst<Arc> &ifst2, bool expand = false,
-                        bool keep_parens = true) {
+                        bool keep_parens = true, bool lookahead = false) {
     matcher1 = new MPdtMatcher(ifst1, MATCH_OUTPUT, kParenList);
     matcher2 = new MPdtMatcher(ifst2, MATCH_INPUT, kParenLoop);
 
     filter = new MPdtFilter(ifst1, ifst2, matcher1, matcher2, &parens,
-                            &assignments, expand, keep_parens);
+                            &assignments, expand, keep_parens, lookahead);
   }
 };
 
@@ -200,22 +232,26 @@ class MPdtComposeFstOptions<Arc, false>
   MPdtComposeFstOptions(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
                         const std::vector<std::pair<Label, Label>> &parens,
                         const std::vector<typename Arc::Label> &assignments,
-                        bool expand = false, bool keep_parens = true) {
+                        bool expand = false, bool keep_parens = true,
+                        bool lookahead = false) {
     matcher1 = new MPdtMatcher(ifst1, MATCH_OUTPUT, kParenLoop);
     matcher2 = new MPdtMatcher(ifst2, MATCH_INPUT, kParenList);
 
     filter = new MPdtFilter(ifst1, ifst2, matcher1, matcher2, &parens,
-                            &assignments, expand, keep_parens);
+                            &assignments, expand, keep_parens, lookahead);
   }
 };
 
 struct MPdtComposeOptions {
   bool connect;                  // Connect output
   PdtComposeFilter filter_type;  // Which pre-defined filter to use
+  bool lookahead;                // Skip open parens that cannot match
 
-  explicit MPdtComposeOptions(bool c, PdtComposeFilter ft = PAREN_FILTER)
-      : connect(c), filter_type(ft) {}
-  MPdtComposeOptions() : connect(true), filter_type(PAREN_FILTER) {}
+  explicit MPdtComposeOptions(bool c, PdtComposeFilter ft = PAREN_FILTER,
+                              bool l = false)
+      : connect(c), filter_type(ft), lookahead(l) {}
+  MPdtComposeOptions()
+      : connect(true), filter_type(PAREN_FILTER), lookahead(false) {}
 };
 
 // Composes pushdown transducer (PDT) encoded as an FST (1st arg) and
@@ -234,7 +270,8 @@ void Compose(const Fst<Arc> &ifst1,
   bool expand = opts.filter_type != PAREN_FILTER;
   bool keep_parens = opts.filter_type != EXPAND_FILTER;
   MPdtComposeFstOptions<Arc, true> copts(ifst1, parens, assignments, ifst2,
-                                         expand, keep_parens);
+                                         expand, keep_parens,
+                                         opts.lookahead);
   copts.gc_limit = 0;
   *ofst = ComposeFst<Arc>(ifst1, ifst2, copts);
   if (opts.connect) Connect(ofst);
@@ -256,7 +293,8 @@ void Compose(
   bool expand = opts.filter_type != PAREN_FILTER;
   bool keep_parens = opts.filter_type != EXPAND_FILTER;
   MPdtComposeFstOptions<Arc, false> copts(ifst1, ifst2, parens, assignments,
-                                          expand, keep_parens);
+                                          expand, keep_parens,
+                                          opts.lookahead);
   copts.gc_limit = 0;
   *ofst = ComposeFst<Arc>(ifst1, ifst2, copts);
   if (opts.connect) Connect(ofst);
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include <fst/compat.h>
+#include <fst/bi-table.h>
 #include <fst/extensions/pdt/pdt.h>
 
 namespace fst {
@@ -20,19 +21,6 @@ enum MPdtType {
   MPDT_NO_RESTRICT,     // No read-write restrictions
 };
 
-// PLEASE READ THIS CAREFULLY:
-//
-// When USEVECTOR is set, the stack configurations --- the statewise
-// representation of the StackId's for each substack --- is stored in a vector.
-// I would like to do this using an array for efficiency reasons, thus the
-// definition of StackConfig below. However, while this *works* in that tests
-// pass, etc. It causes a memory leak in the compose and expand tests, evidently
-// in the map[] that is being used to store the mapping between these
-// StackConfigs and the external StackId that the caller sees. There are no
-// memory leaks when I use a vector, only with this StackId. Why there should be
-// memory leaks given that I am not mallocing anything is a mystery. In case you
-// were wondering, clearing the map at the end does not help.
-
 template <typename K, int nlevels>
 struct StackConfig {
   StackConfig() : array_() {}
@@ -55,18 +43,27 @@ struct StackConfig {
 };
 
 template <typename K, int nlevels>
-class CompConfig {
+class ConfigHash {
+ public:
+  size_t operator()(const StackConfig<K, nlevels> &config) const {
+    size_t h = 0;
+    for (size_t i = 0; i < nlevels; ++i) h = h * kPrime + config.array_[i];
+    return h;
+  }
+
+ private:
+  static const size_t kPrime = 7853;
+};
+
+template <typename K, int nlevels>
+class ConfigEqual {
  public:
   bool operator()(const StackConfig<K, nlevels> &a,
                   const StackConfig<K, nlevels> &b) const {
     for (size_t i = 0; i < nlevels; ++i) {
-      if (a.array_[i] < b.array_[i]) {
-        return true;
-      } else if (a.array_[i] > b.array_[i]) {
-        return false;
-      }
+      if (a.array_[i] != b.array_[i]) return false;
     }
-    return false;
+    return true;
   }
 };
 
@@ -98,7 +95,10 @@ class MPdtStack {
   typedef L Label;
   typedef L Level;  // Not really needed, but I find it confusing otherwise.
   typedef StackConfig<StackId, nlevels> Config;
-  typedef std::map<Config, StackId, CompConfig<StackId, nlevels>>
+  // Hash-consing bijection between configurations and the external stack
+  // IDs, which are thus dense; the empty configuration has ID 0.
+  typedef CompactHashBiTable<StackId, Config, ConfigHash<StackId, nlevels>,
+                             ConfigEqual<StackId, nlevels>>
       ConfigToStackId;
 
   MPdtStack(const std::vector<std::pair<Label, Label>> &parens,
@@ -118,7 +118,7 @@ class MPdtStack {
   // (or -1) if there is none. Then map that to the external stack_id to return
   ssize_t Top(StackId stack_id) const {
     if (stack_id == -1) return -1;
-    const Config config = InternalStackIds(stack_id);
+    const Config &config = InternalStackIds(stack_id);
     Level lev = 0;
     StackId underlying_id = -1;
     for (; lev < nlevels; ++lev) {
@@ -162,29 +162,19 @@ class MPdtStack {
   // configuration and label. This function relates a configuration of those to
   // the stack id that the caller of the mpdt sees.
   inline StackId ExternalStackId(const Config &config) {
-    typename ConfigToStackId::const_iterator idx =
-        config_to_stack_id_map_.find(config);
-    StackId result;
-    if (idx == config_to_stack_id_map_.end()) {
-      result = next_stack_id_++;
-      config_to_stack_id_map_.insert(
-          std::pair<Config, StackId>(config, result));
-      stack_id_to_config_map_[result] = config;
-    } else {
-      result = idx->second;
-    }
-    return result;
+    if (ConfigEqual<StackId, nlevels>()(config, neg_one_)) return -1;
+    return config_table_.FindId(config);
   }
 
   // This function gets the internal stack id from an external stack id
-  inline const Config InternalStackIds(StackId stack_id) const {
-    typename std::unordered_map<StackId, Config>::const_iterator idx =
-        stack_id_to_config_map_.find(stack_id);
-    if (idx == stack_id_to_config_map_.end())
-      idx = stack_id_to_config_map_.find(-1);
-    return idx->second;
+  inline const Config &InternalStackIds(StackId stack_id) const {
+    if (stack_id < 0 || stack_id >= config_table_.Size()) return neg_one_;
+    return config_table_.FindEntry(stack_id);
   }
 
+  // Returns the number of external stack IDs.
+  StackId NumStacks() const { return config_table_.Size(); }
+
   inline bool Empty(const Config &config, Level lev) const {
     return config[lev] <= 0;
   }
@@ -206,9 +196,8 @@ class MPdtStack {
   std::unordered_map<KeyPair<Level>, size_t, KeyPairHasher<Level>>
       paren_id_map_;
   // Maps between internal stack ids and external stack id.
-  ConfigToStackId config_to_stack_id_map_;
-  std::unordered_map<StackId, Config> stack_id_to_config_map_;
-  StackId next_stack_id_;
+  ConfigToStackId config_table_;
+  Config neg_one_;  // Configuration of stack ID -1
   // Underlying stacks
   PdtStack<StackId, Label> *stacks_[nlevels];  // Array of stacks
 };
@@ -220,14 +209,11 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
     : error_(false),
       min_paren_(kNoLabel),
       max_paren_(kNoLabel),
-      parens_(parens),
-      next_stack_id_(1) {
+      parens_(parens) {
   typedef K StackId;
   typedef L Label;
   typedef L Level;  // Not really needed, but I find it confusing otherwise.
   typedef StackConfig<StackId, nlevels> Config;
-  typedef std::map<Config, StackId, CompConfig<StackId, nlevels>>
-      ConfigToStackId;
   if (parens.size() != assignments.size()) {
     FSTERROR() << "MPdtStack: Parens of different size from assignments";
     error_ = true;
@@ -258,17 +244,13 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
     if (max_paren_ == kNoLabel || p.first > max_paren_) max_paren_ = p.first;
     if (p.second > max_paren_) max_paren_ = p.second;
   }
-  Config neg_one;
   Config zero;
   for (Level i = 0; i < nlevels; ++i) {
     stacks_[i] = new PdtStack<StackId, Label>(vectors[i]);
-    neg_one[i] = -1;
+    neg_one_[i] = -1;
     zero[i] = 0;
   }
-  config_to_stack_id_map_[neg_one] = -1;
-  config_to_stack_id_map_[zero] = 0;
-  stack_id_to_config_map_[-1] = neg_one;
-  stack_id_to_config_map_[0] = zero;
+  config_table_.FindId(zero);
 }
 
 template <typename K, typename L, L nlevels, MPdtType restrict>
@@ -277,35 +259,14 @@ MPdtStack<K, L, nlevels, restrict>::MPdtStack(
     : error_(mstack.error_),
       min_paren_(mstack.min_paren_),
       max_paren_(mstack.max_paren_),
+      paren_levels_(mstack.paren_levels_),
       parens_(mstack.parens_),
-      next_stack_id_(mstack.next_stack_id_) {
-  typedef K StackId;
-  typedef L Label;
-  typedef L Level;  // Not really needed, but I find it confusing otherwise.
-  typedef StackConfig<StackId, nlevels> Config;
-  for (const auto &kv : mstack.paren_levels_) {
-    paren_levels_[kv.first] = kv.second;
-  }
-  for (int i = 0; i < mstack.parens_.size(); ++i) {
-    parens_.push_back(mstack.parens_[i]);
-  }
-  for (const auto &kv : mstack.paren_map_) {
-    paren_map_[kv.first] = kv.second;
-  }
-  for (const auto &kv : mstack.paren_id_map_) {
-    paren_id_map_[kv.first] = kv.second;
-  }
-  for (typename ConfigToStackId::const_iterator ix =
-           mstack.config_to_stack_id_map_.begin();
-       ix != mstack.config_to_stack_id_map_.end(); ++ix) {
-    config_to_stack_id_map_[ix->first] = ix->second;
-  }
-  for (const auto &kv : mstack.stack_id_to_config_map_) {
-    Config config(kv.second);
-    stack_id_to_config_map_[kv.first] = config;
-  }
+      paren_map_(mstack.paren_map_),
+      paren_id_map_(mstack.paren_id_map_),
+      config_table_(mstack.config_table_),
+      neg_one_(mstack.neg_one_) {
   for (int i = 0; i < nlevels; ++i) {
-    stacks_[i] = mstack.stacks_[i];
+    stacks_[i] = new PdtStack<K, L>(*mstack.stacks_[i]);
   }
 }
 
@@ -6,7 +6,11 @@
 #ifndef FST_EXTENSIONS_PDT_COMPOSE_H__
 #define FST_EXTENSIONS_PDT_COMPOSE_H__
 
+#include <algorithm>
 #include <list>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <fst/extensions/pdt/pdt.h>
 #include <fst/compose.h>
@@ -241,6 +245,166 @@ inline bool ParenMatcher<F>::NextCloseParen() {
   return false;
 }
 
+// Lookahead on open parentheses for PDT composition. For an open paren arc
+// entering state 'd' of the PDT, computes the set of the first non-epsilon,
+// non-paren labels (on the matching side) that can be read inside the
+// paren-balanced sub-graph entered at 'd'. The open paren arc can then be
+// skipped when the current state of the other operand has no transition on
+// any of these labels. Only the paren nesting depth is tracked (not which
+// parens balance), so the label sets over-approximate the exact ones and no
+// successful path is ever removed. No pruning is done when the sub-graph
+// may be left without reading a label or when the search exceeds its limits.
+template <class Arc>
+class ParenLookAhead {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+
+  // The PDT 'pdt' is matched on its output labels when 'match_type' is
+  // MATCH_OUTPUT, and the FST 'fst' is then matched on its input labels.
+  // MATCH_INPUT is the reverse.
+  ParenLookAhead(const Fst<Arc> &pdt, const Fst<Arc> &fst,
+                 MatchType match_type,
+                 const std::vector<std::pair<Label, Label>> &parens)
+      : pdt_(pdt.Copy()), fst_(fst.Copy()), match_type_(match_type) {
+    for (size_t i = 0; i < parens.size(); ++i) {
+      open_parens_.insert(parens[i].first);
+      close_parens_.insert(parens[i].second);
+    }
+    const MatchType fst_match_type =
+        match_type == MATCH_OUTPUT ? MATCH_INPUT : MATCH_OUTPUT;
+    const uint64 sorted =
+        fst_match_type == MATCH_INPUT ? kILabelSorted : kOLabelSorted;
+    if (fst_->Properties(sorted, false)) {
+      matcher_.reset(new SortedMatcher<Fst<Arc>>(*fst_, fst_match_type));
+    }
+  }
+
+  // Returns false if the sub-graph of the PDT entered at state 'd' by an open
+  // paren certainly cannot match any path from state 's' of the FST. The
+  // result is cached per (d, s) pair.
+  bool CanMatch(StateId d, StateId s) {
+    const std::pair<StateId, StateId> key(d, s);
+    auto it = can_match_.find(key);
+    if (it != can_match_.end()) return it->second;
+    const bool can_match = ComputeCanMatch(d, s);
+    can_match_[key] = can_match;
+    return can_match;
+  }
+
+ private:
+  static const int kMaxDepth = 16;       // Maximum nesting depth searched
+  static const size_t kMaxVisits = 4096;  // Maximum (state, depth) pairs
+
+  struct FirstLabels {
+    bool nullable;               // Can be left without reading a label?
+    std::vector<Label> labels;   // Sorted first labels
+  };
+
+  // Hash for (open paren destination, FST state) pairs.
+  struct PairHash {
+    size_t operator()(const std::pair<StateId, StateId> &p) const {
+      return p.first + p.second * kPrime;
+    }
+  };
+
+  static const size_t kPrime = 7853;
+
+  // When the FST is sorted on the matching side and has more arcs at 's'
+  // than there are first labels, the first labels are looked up with the
+  // matcher; otherwise the arcs at 's' are scanned.
+  bool ComputeCanMatch(StateId d, StateId s) {
+    const FirstLabels &first = GetFirstLabels(d);
+    if (first.nullable) return true;
+    if (matcher_ && first.labels.size() < fst_->NumArcs(s)) {
+      const size_t neps = match_type_ == MATCH_OUTPUT
+                              ? fst_->NumInputEpsilons(s)
+                              : fst_->NumOutputEpsilons(s);
+      if (neps > 0) return true;
+      matcher_->SetState(s);
+      for (const Label label : first.labels) {
+        if (matcher_->Find(label)) return true;
+      }
+      return false;
+    }
+    for (ArcIterator<Fst<Arc>> aiter(*fst_, s); !aiter.Done(); aiter.Next()) {
+      const Label label = FstLabel(aiter.Value());
+      if (label == 0 ||
+          std::binary_search(first.labels.begin(), first.labels.end(), label))
+        return true;
+    }
+    return false;
+  }
+
+  Label PdtLabel(const Arc &arc) const {
+    return match_type_ == MATCH_OUTPUT ? arc.olabel : arc.ilabel;
+  }
+
+  Label FstLabel(const Arc &arc) const {
+    return match_type_ == MATCH_OUTPUT ? arc.ilabel : arc.olabel;
+  }
+
+  const FirstLabels &GetFirstLabels(StateId d) {
+    auto it = first_labels_.find(d);
+    if (it != first_labels_.end()) return it->second;
+    FirstLabels &first = first_labels_[d];
+    first.nullable = false;
+    std::set<std::pair<StateId, int>> visited;
+    std::vector<std::pair<StateId, int>> queue;
+    visited.insert(std::make_pair(d, 0));
+    queue.push_back(std::make_pair(d, 0));
+    while (!queue.empty() && !first.nullable) {
+      const StateId s = queue.back().first;
+      const int depth = queue.back().second;
+      queue.pop_back();
+      for (ArcIterator<Fst<Arc>> aiter(*pdt_, s); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        const Label label = PdtLabel(arc);
+        int ndepth = depth;
+        if (open_parens_.count(label)) {
+          ndepth = depth + 1;
+        } else if (close_parens_.count(label)) {
+          ndepth = depth - 1;
+        } else if (label != 0) {
+          first.labels.push_back(label);
+          continue;
+        }
+        if (ndepth < 0 || ndepth > kMaxDepth) {
+          first.nullable = true;
+          break;
+        }
+        if (visited.insert(std::make_pair(arc.nextstate, ndepth)).second)
+          queue.push_back(std::make_pair(arc.nextstate, ndepth));
+        if (visited.size() > kMaxVisits) {
+          first.nullable = true;
+          break;
+        }
+      }
+    }
+    if (first.nullable) {
+      first.labels.clear();
+    } else {
+      std::sort(first.labels.begin(), first.labels.end());
+      first.labels.erase(std::unique(first.labels.begin(), first.labels.end()),
+                         first.labels.end());
+    }
+    return first;
+  }
+
+  std::unique_ptr<const Fst<Arc>> pdt_;
+  std::unique_ptr<const Fst<Arc>> fst_;
+  MatchType match_type_;
+  std::unordered_set<Label> open_parens_;
+  std::unordered_set<Label> close_parens_;
+  std::unordered_map<StateId, FirstLabels> first_labels_;
+  std::unordered_map<std::pair<StateId, StateId>, bool, PairHash> can_match_;
+  std::unique_ptr<SortedMatcher<Fst<Arc>>> matcher_;  // If FST is sorted
+
+  ParenLookAhead(const ParenLookAhead &) = delete;
+  ParenLookAhead &operator=(const ParenLookAhead &) = delete;
+};
+
 template <class F>
 class ParenFilter {
  public:
@@ -262,11 +426,13 @@ class ParenFilter {
   ParenFilter(const FST1 &fst1, const FST2 &fst2, Matcher1 *matcher1 = 0,
               Matcher2 *matcher2 = 0,
               const std::vector<std::pair<Label, Label>> *parens = 0,
-              bool expand = false, bool keep_parens = true)
+              bool expand = false, bool keep_parens = true,
+              bool lookahead = false)
       : filter_(fst1, fst2, matcher1, matcher2),
         parens_(parens ? *parens : std::vector<std::pair<Label, Label>>()),
         expand_(expand),
         keep_parens_(keep_parens),
+        lookahead_(lookahead),
         f_(FilterState::NoState()),
         stack_(parens_),
         paren_id_(-1) {
@@ -282,6 +448,7 @@ class ParenFilter {
         }
       }
     }
+    if (lookahead_) InitLookAhead();
   }
 
   ParenFilter(const Filter &filter, bool safe = false)
@@ -289,9 +456,12 @@ class ParenFilter {
         parens_(filter.parens_),
         expand_(filter.expand_),
         keep_parens_(filter.keep_parens_),
+        lookahead_(filter.lookahead_),
         f_(FilterState::NoState()),
         stack_(filter.parens_),
-        paren_id_(-1) {}
+        paren_id_(-1) {
+    if (lookahead_) InitLookAhead();
+  }
 
   FilterState Start() const {
     return FilterState(filter_.Start(), FilterState2(0));
@@ -322,6 +492,10 @@ class ParenFilter {
     if (f1 == FilterState1::NoState()) return FilterState::NoState();
 
     if (arc1->olabel == kNoLabel && arc2->ilabel) {  // arc2 parentheses
+      if (lookahead_ && IsOpenParen(arc2->ilabel) &&
+          !lookahead2_->CanMatch(arc2->nextstate, arc1->nextstate)) {
+        return FilterState::NoState();
+      }
       if (keep_parens_) {
         arc1->ilabel = arc2->ilabel;
       } else if (arc2->ilabel) {
@@ -329,6 +503,10 @@ class ParenFilter {
       }
       return FilterParen(arc2->ilabel, f1, f2);
     } else if (arc2->ilabel == kNoLabel && arc1->olabel) {  // arc1 parentheses
+      if (lookahead_ && IsOpenParen(arc1->olabel) &&
+          !lookahead1_->CanMatch(arc1->nextstate, arc2->nextstate)) {
+        return FilterState::NoState();
+      }
       if (keep_parens_) {
         arc2->olabel = arc1->olabel;
       } else {
@@ -355,6 +533,21 @@ class ParenFilter {
   }
 
  private:
+  // Sets up the open paren lookahead for the PDT being either argument.
+  void InitLookAhead() {
+    const Fst<Arc> &fst1 = GetMatcher1()->GetFst();
+    const Fst<Arc> &fst2 = GetMatcher2()->GetFst();
+    lookahead1_.reset(
+        new ParenLookAhead<Arc>(fst1, fst2, MATCH_OUTPUT, parens_));
+    lookahead2_.reset(
+        new ParenLookAhead<Arc>(fst2, fst1, MATCH_INPUT, parens_));
+  }
+
+  bool IsOpenParen(Label label) const {
+    const ssize_t paren_id = stack_.ParenId(label);
+    return paren_id != -1 && parens_[paren_id].first == label;
+  }
+
   const FilterState FilterParen(Label label, const FilterState1 &f1,
                                 const FilterState2 &f2) const {
     if (!expand_) return FilterState(f1, f2);
@@ -371,6 +564,9 @@ class ParenFilter {
   std::vector<std::pair<Label, Label>> parens_;
   bool expand_;       // Expands to FST
   bool keep_parens_;  // Retains parentheses in output
+  bool lookahead_;    // Skips open parens whose sub-graph cannot match
+  std::unique_ptr<ParenLookAhead<Arc>> lookahead1_;  // PDT as 1st arg
+  std::unique_ptr<ParenLookAhead<Arc>> lookahead2_;  // PDT as 2nd arg
   FilterState f_;     // Current filter state
   mutable ParenStack stack_;
   ssize_t paren_id_;
@@ -395,12 +591,12 @@ class PdtComposeFstOptions
   PdtComposeFstOptions(const Fst<Arc> &ifst1,
                        const std::vector<std::pair<Label, Label>> &parens,
                        const Fst<Arc> &ifst2, bool expand = false,
-                       bool keep_parens = true) {
+                       bool keep_parens = true, bool lookahead = false) {
     matcher1 = new PdtMatcher(ifst1, MATCH_OUTPUT, kParenList);
     matcher2 = new PdtMatcher(ifst2, MATCH_INPUT, kParenLoop);
 
     filter = new PdtFilter(ifst1, ifst2, matcher1, matcher2, &parens, expand,
-                           keep_parens);
+                           keep_parens, lookahead);
   }
 };
 
@@ -422,12 +618,13 @@ class PdtComposeFstOptions<Arc, false>
 
   PdtComposeFstOptions(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
                        const std::vector<std::pair<Label, Label>> &parens,
-                       bool expand = false, bool keep_parens = true) {
+                       bool expand = false, bool keep_parens = true,
+                       bool lookahead = false) {
     matcher1 = new PdtMatcher(ifst1, MATCH_OUTPUT, kParenLoop);
     matcher2 = new PdtMatcher(ifst2, MATCH_INPUT, kParenList);
 
     filter = new PdtFilter(ifst1, ifst2, matcher1, matcher2, &parens, expand,
-                           keep_parens);
+                           keep_parens, lookahead);
   }
 };
 
@@ -440,10 +637,13 @@ enum PdtComposeFilter {
 struct PdtComposeOptions {
   bool connect;                  // Connect output
   PdtComposeFilter filter_type;  // Which pre-defined filter to use
+  bool lookahead;                // Skip open parens that cannot match
 
-  explicit PdtComposeOptions(bool c, PdtComposeFilter ft = PAREN_FILTER)
-      : connect(c), filter_type(ft) {}
-  PdtComposeOptions() : connect(true), filter_type(PAREN_FILTER) {}
+  explicit PdtComposeOptions(bool c, PdtComposeFilter ft = PAREN_FILTER,
+                             bool l = false)
+      : connect(c), filter_type(ft), lookahead(l) {}
+  PdtComposeOptions()
+      : connect(true), filter_type(PAREN_FILTER), lookahead(false) {}
 };
 
 // Composes pushdown transducer (PDT) encoded as an FST (1st arg) and
@@ -461,7 +661,7 @@ void Compose(const Fst<Arc> &ifst1,
   bool expand = opts.filter_type != PAREN_FILTER;
   bool keep_parens = opts.filter_type != EXPAND_FILTER;
   PdtComposeFstOptions<Arc, true> copts(ifst1, parens, ifst2, expand,
-                                        keep_parens);
+                                        keep_parens, opts.lookahead);
   copts.gc_limit = 0;
   *ofst = ComposeFst<Arc>(ifst1, ifst2, copts);
   if (opts.connect) Connect(ofst);
@@ -482,7 +682,7 @@ void Compose(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
   bool expand = opts.filter_type != PAREN_FILTER;
   bool keep_parens = opts.filter_type != EXPAND_FILTER;
   PdtComposeFstOptions<Arc, false> copts(ifst1, ifst2, parens, expand,
-                                         keep_parens);
+                                         keep_parens, opts.lookahead);
   copts.gc_limit = 0;
   *ofst = ComposeFst<Arc>(ifst1, ifst2, copts);
   if (opts.connect) Connect(ofst);
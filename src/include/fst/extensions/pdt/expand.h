@@ -15,6 +15,7 @@
 #include <fst/extensions/pdt/shortest-path.h>
 #include <fst/cache.h>
 #include <fst/mutable-fst.h>
+#include <fst/prune.h>
 #include <fst/queue.h>
 #include <fst/state-table.h>
 #include <fst/test-properties.h>
@@ -879,6 +880,202 @@ void PdtPrunedExpand<A>::Expand(MutableFst<A> *ofst,
   }
 }
 
+//
+// BeamExpand Class
+//
+
+// Prunes the expansion of a pushdown transducer (PDT) encoded as an FST
+// into an FST in a single pass. Unlike PdtPrunedExpand, this does not
+// require the reversed PDT or any precomputed shortest-distance
+// information. Instead, the (state, stack) pairs of the expansion are
+// created on demand and visited in best-first order w.r.t. their shortest
+// distance from the initial state. The visit stops as soon as the best
+// remaining pair is above the weight threshold relative to the best
+// complete path found, so that pairs outside of the beam are never
+// created. Optionally, pairs whose stack is deeper than 'max_stack_depth'
+// are not created either; this also allows expanding a PDT whose stack is
+// not bounded.
+//
+// As for Dijkstra's algorithm, the weights need to be non-negative w.r.t.
+// the natural order, i.e., Times(a, b) should never be less than a.
+template <class A>
+class PdtBeamExpand {
+ public:
+  typedef A Arc;
+  typedef typename A::Label Label;
+  typedef typename A::StateId StateId;
+  typedef typename A::Weight Weight;
+  typedef StateId StackId;
+  typedef PdtStack<StackId, Label> Stack;
+  typedef PdtStateTable<StateId, StackId> StateTable;
+
+  // Constructor taking as input a PDT specified by 'ifst' and 'parens'.
+  // 'keep_parentheses' specifies whether parentheses are replaced by
+  // epsilons or not during the expansion. When 'max_stack_depth' is
+  // non-negative, no state with a stack longer than it is expanded.
+  PdtBeamExpand(const Fst<A> &ifst,
+                const std::vector<std::pair<Label, Label>> &parens,
+                bool keep_parentheses = false, ssize_t max_stack_depth = -1)
+      : ifst_(ifst.Copy()),
+        keep_parentheses_(keep_parentheses),
+        max_stack_depth_(max_stack_depth),
+        stack_(parens),
+        queue_(distance_),
+        error_(false) {
+    if ((Weight::Properties() & (kPath | kCommutative)) !=
+        (kPath | kCommutative)) {
+      FSTERROR() << "PdtBeamExpand: Weight needs to have the path"
+                 << " property and be commutative: " << Weight::Type();
+      error_ = true;
+    }
+  }
+
+  bool Error() const { return error_; }
+
+  // Expands and prunes with weight threshold 'threshold' the input PDT.
+  // Writes the result in 'ofst'. A threshold of Weight::Zero() disables
+  // the weight-based pruning.
+  void Expand(MutableFst<A> *ofst, const Weight &threshold);
+
+ private:
+  static const uint8 kEnqueued;
+  static const uint8 kExpanded;
+
+  StateId FindState(StateId state, StackId stack_id);
+  void ProcFinal(StateId s, const Weight &threshold);
+  void ProcArcs(StateId s);
+
+  std::unique_ptr<Fst<A>> ifst_;       // Input PDT
+  bool keep_parentheses_;              // Keep parentheses in ofst?
+  ssize_t max_stack_depth_;            // Maximum stack depth, if non-negative
+  Stack stack_;                        // Stack trie
+  StateTable state_table_;             // Maps (state, stack) pairs to ofst_
+  std::vector<StackId> stack_length_;  // Length of stack for given stack id
+  std::vector<Weight> distance_;       // Distance from initial state in ofst_
+  std::vector<uint8> flags_;           // Status flags for states in ofst_
+  NaturalShortestFirstQueue<StateId, Weight> queue_;  // Best-first queue
+  MutableFst<Arc> *ofst_;                             // Output fst
+  Weight best_;   // Weight of the best complete path found so far
+  Weight limit_;  // Weight limit
+  bool error_;    // Indicates construction time failure.
+  NaturalLess<Weight> less_;
+};
+
+template <class A>
+const uint8 PdtBeamExpand<A>::kEnqueued = 0x01;
+template <class A>
+const uint8 PdtBeamExpand<A>::kExpanded = 0x02;
+
+// Returns the state in 'ofst_' for the pair ('state', 'stack_id'), adding it
+// to 'ofst_' if needed.
+template <class A>
+typename A::StateId PdtBeamExpand<A>::FindState(StateId state,
+                                                StackId stack_id) {
+  StateId s =
+      state_table_.FindState(PdtStateTuple<StateId, StackId>(state, stack_id));
+  while (ofst_->NumStates() <= s) {
+    ofst_->AddState();
+    distance_.push_back(Weight::Zero());
+    flags_.push_back(0);
+  }
+  return s;
+}
+
+// Makes 's' final in 'ofst_' if it has an empty stack and updates the best
+// complete path and the weight limit accordingly.
+template <class A>
+void PdtBeamExpand<A>::ProcFinal(StateId s, const Weight &threshold) {
+  const PdtStateTuple<StateId, StackId> &tuple = state_table_.Tuple(s);
+  if (tuple.stack_id != 0) return;
+  const Weight final_weight = ifst_->Final(tuple.state_id);
+  if (final_weight == Weight::Zero()) return;
+  ofst_->SetFinal(s, final_weight);
+  const Weight w = Times(distance_[s], final_weight);
+  if (less_(w, best_)) {
+    best_ = w;
+    if (threshold != Weight::Zero()) limit_ = Times(best_, threshold);
+  }
+}
+
+// Adds the arcs out of 's' in the expansion whose destination is within
+// the beam, relaxing and enqueueing their destination states.
+template <class A>
+void PdtBeamExpand<A>::ProcArcs(StateId s) {
+  const PdtStateTuple<StateId, StackId> tuple = state_table_.Tuple(s);
+  for (ArcIterator<Fst<A>> aiter(*ifst_, tuple.state_id); !aiter.Done();
+       aiter.Next()) {
+    Arc arc = aiter.Value();
+    const Weight nd = Times(distance_[s], arc.weight);
+    if (less_(limit_, nd)) continue;  // Out of beam; allocates no stack node.
+    const StackId stack_id = stack_.Find(tuple.stack_id, arc.ilabel);
+    if (stack_id == -1) continue;  // Non-matching close parenthesis
+    if (stack_id != tuple.stack_id) {
+      if (stack_.Pop(stack_id) == tuple.stack_id) {  // Push
+        while (stack_length_.size() <= static_cast<size_t>(stack_id)) {
+          stack_length_.push_back(-1);
+        }
+        if (stack_length_[stack_id] == -1)
+          stack_length_[stack_id] = stack_length_[tuple.stack_id] + 1;
+        if (max_stack_depth_ >= 0 && stack_length_[stack_id] > max_stack_depth_)
+          continue;
+      }
+      if (!keep_parentheses_) arc.ilabel = arc.olabel = 0;
+    }
+    arc.nextstate = FindState(arc.nextstate, stack_id);
+    ofst_->AddArc(s, arc);
+    if (flags_[arc.nextstate] & kExpanded) continue;
+    if (less_(nd, distance_[arc.nextstate])) {
+      distance_[arc.nextstate] = nd;
+      if (flags_[arc.nextstate] & kEnqueued) {
+        queue_.Update(arc.nextstate);
+      } else {
+        queue_.Enqueue(arc.nextstate);
+        flags_[arc.nextstate] |= kEnqueued;
+      }
+    }
+  }
+}
+
+// Expands and prunes with weight threshold 'threshold' the input PDT.
+// Writes the result in 'ofst'. States created but found to be out of the
+// beam once they are reached in the queue are left unexpanded, and the
+// result is pruned with 'threshold' before returning.
+template <class A>
+void PdtBeamExpand<A>::Expand(MutableFst<A> *ofst,
+                              const typename A::Weight &threshold) {
+  ofst_ = ofst;
+  if (error_) {
+    ofst_->SetProperties(kError, kError);
+    return;
+  }
+
+  ofst_->DeleteStates();
+  ofst_->SetInputSymbols(ifst_->InputSymbols());
+  ofst_->SetOutputSymbols(ifst_->OutputSymbols());
+  if (ifst_->Start() == kNoStateId) return;
+
+  best_ = Weight::Zero();
+  limit_ = Weight::Zero();
+  stack_length_.assign(1, 0);
+  StateId start = FindState(ifst_->Start(), 0);
+  ofst_->SetStart(start);
+  distance_[start] = Weight::One();
+  queue_.Enqueue(start);
+  flags_[start] |= kEnqueued;
+
+  while (!queue_.Empty()) {
+    StateId s = queue_.Head();
+    if (less_(limit_, distance_[s])) break;  // Remaining states out of beam
+    queue_.Dequeue();
+    flags_[s] = kExpanded;
+    ProcFinal(s, threshold);
+    ProcArcs(s);
+  }
+  queue_.Clear();
+
+  if (threshold != Weight::Zero()) Prune(ofst_, threshold);
+}
+
 //
 // Expand() Functions
 //
@@ -888,10 +1085,14 @@ struct PdtExpandOptions {
   bool connect;
   bool keep_parentheses;
   typename Arc::Weight weight_threshold;
+  bool best_first;         // Prune in a single best-first pass?
+  ssize_t max_stack_depth;  // Maximum stack depth when 'best_first'
 
   PdtExpandOptions(bool c = true, bool k = false,
-                typename Arc::Weight w = Arc::Weight::Zero())
-      : connect(c), keep_parentheses(k), weight_threshold(w) {}
+                typename Arc::Weight w = Arc::Weight::Zero(),
+                bool b = false, ssize_t d = -1)
+      : connect(c), keep_parentheses(k), weight_threshold(w), best_first(b),
+        max_stack_depth(d) {}
 };
 
 // Expands a pushdown transducer (PDT) encoded as an FST into an FST.
@@ -913,7 +1114,14 @@ void Expand(const Fst<Arc> &ifst,
   typedef typename PdtExpandFst<Arc>::StackId StackId;
   PdtExpandFstOptions<Arc> eopts;
   eopts.gc_limit = 0;
-  if (opts.weight_threshold == Weight::Zero()) {
+  if (!opts.best_first && opts.max_stack_depth >= 0) {
+    LOG(WARNING) << "Expand: max_stack_depth is only used with best_first";
+  }
+  if (opts.best_first) {
+    PdtBeamExpand<Arc> beam_expand(ifst, parens, opts.keep_parentheses,
+                                   opts.max_stack_depth);
+    beam_expand.Expand(ofst, opts.weight_threshold);
+  } else if (opts.weight_threshold == Weight::Zero()) {
     eopts.keep_parentheses = opts.keep_parentheses;
     *ofst = PdtExpandFst<Arc>(ifst, parens, eopts);
   } else {
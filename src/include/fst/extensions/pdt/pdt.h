@@ -6,9 +6,11 @@
 #ifndef FST_EXTENSIONS_PDT_PDT_H__
 #define FST_EXTENSIONS_PDT_PDT_H__
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include <fst/compat.h>
 #include <fst/fst.h>
@@ -28,18 +30,33 @@ class PdtStack {
   // The stacks are stored in a tree. The nodes are stored in vector
   // 'nodes_'. Each node represents the top of some stack and is
   // ID'ed by its position in the vector. Its parent node represents
-  // the stack with the top 'popped' and its children are stored in
-  // 'child_map_' accessed by stack_id and label. The paren_id is
-  // the position in 'parens' of the parenthesis for that node.
+  // the stack with the top 'popped'. The paren_id is the position in
+  // 'parens' of the parenthesis for that node.
+  //
+  // When there are at most kMaxBitmapParens parentheses, the children of
+  // a node are stored in a block of the flat vector 'children_' starting
+  // at 'child_pos', sorted by paren ID. Bit i of 'child_mask' is set iff
+  // there is a child for paren ID i, so the position of that child in the
+  // block is the number of bits set below i. The blocks have power-of-two
+  // capacities and are recycled when outgrown. Otherwise, the children
+  // are stored in 'child_map_' accessed by stack_id and label.
   struct StackNode {
     StackId parent_id;
-    size_t paren_id;
+    int32 paren_id;
+    uint32 child_pos;
+    uint64 child_mask;
 
-    StackNode(StackId p, size_t i) : parent_id(p), paren_id(i) {}
+    StackNode(StackId p, int32 i)
+        : parent_id(p), paren_id(i), child_pos(0), child_mask(0) {}
   };
 
+  static const size_t kMaxBitmapParens = 64;
+
   explicit PdtStack(const std::vector<std::pair<Label, Label>> &parens)
-      : parens_(parens), min_paren_(kNoLabel), max_paren_(kNoLabel) {
+      : parens_(parens),
+        min_paren_(kNoLabel),
+        max_paren_(kNoLabel),
+        use_bitmap_(parens.size() <= kMaxBitmapParens) {
     for (size_t i = 0; i < parens.size(); ++i) {
       const std::pair<Label, Label> &p = parens[i];
       paren_map_[p.first] = i;
@@ -72,10 +89,19 @@ class PdtStack {
     ssize_t paren_id = pit->second;
 
     if (label == parens_[paren_id].first) {  // Open paren.
-      StackId &child_id = child_map_[std::make_pair(stack_id, label)];
-      if (child_id == 0) {  // Child not found, push label.
+      if (!use_bitmap_) {
+        StackId &child_id = child_map_[std::make_pair(stack_id, label)];
+        if (child_id == 0) {  // Child not found, push label.
+          child_id = nodes_.size();
+          nodes_.push_back(StackNode(stack_id, paren_id));
+        }
+        return child_id;
+      }
+      StackId child_id = FindChild(stack_id, paren_id);
+      if (child_id == -1) {  // Child not found, push label.
         child_id = nodes_.size();
         nodes_.push_back(StackNode(stack_id, paren_id));
+        AddChild(stack_id, paren_id, child_id);
       }
       return child_id;
     }
@@ -102,7 +128,61 @@ class PdtStack {
     return pit->second;
   }
 
+  // Returns the number of stack IDs.
+  StackId NumStacks() const { return nodes_.size(); }
+
  private:
+  static int Popcount(uint64 mask) { return __builtin_popcountll(mask); }
+
+  // Returns the child of 'stack_id' for 'paren_id' or -1 if none.
+  StackId FindChild(StackId stack_id, size_t paren_id) const {
+    const StackNode &node = nodes_[stack_id];
+    const uint64 bit = static_cast<uint64>(1) << paren_id;
+    if (!(node.child_mask & bit)) return -1;
+    return children_[node.child_pos + Popcount(node.child_mask & (bit - 1))];
+  }
+
+  // Inserts 'child_id' as the child of 'stack_id' for 'paren_id', growing the
+  // block of children of 'stack_id' if full.
+  void AddChild(StackId stack_id, size_t paren_id, StackId child_id) {
+    StackNode &node = nodes_[stack_id];
+    const uint64 bit = static_cast<uint64>(1) << paren_id;
+    const size_t nchildren = Popcount(node.child_mask);
+    if (nchildren == 0) {
+      node.child_pos = AllocateBlock(1);
+    } else if ((nchildren & (nchildren - 1)) == 0) {  // Full block
+      const uint32 pos = AllocateBlock(2 * nchildren);
+      std::copy(children_.begin() + node.child_pos,
+                children_.begin() + node.child_pos + nchildren,
+                children_.begin() + pos);
+      FreeBlock(node.child_pos, nchildren);
+      node.child_pos = pos;
+    }
+    const size_t rank = Popcount(node.child_mask & (bit - 1));
+    const auto begin = children_.begin() + node.child_pos;
+    std::copy_backward(begin + rank, begin + nchildren, begin + nchildren + 1);
+    children_[node.child_pos + rank] = child_id;
+    node.child_mask |= bit;
+  }
+
+  // Returns the position in 'children_' of a block of size 'capacity', which
+  // must be a power of two.
+  uint32 AllocateBlock(size_t capacity) {
+    std::vector<uint32> &free_list = free_blocks_[Popcount(capacity - 1)];
+    if (!free_list.empty()) {
+      const uint32 pos = free_list.back();
+      free_list.pop_back();
+      return pos;
+    }
+    const uint32 pos = children_.size();
+    children_.resize(children_.size() + capacity, -1);
+    return pos;
+  }
+
+  void FreeBlock(uint32 pos, size_t capacity) {
+    free_blocks_[Popcount(capacity - 1)].push_back(pos);
+  }
+
   struct ChildHash {
     size_t operator()(const std::pair<StackId, Label> &p) const {
       return p.first + p.second * kPrime;
@@ -115,9 +195,12 @@ class PdtStack {
   std::vector<StackNode> nodes_;
   std::unordered_map<Label, size_t> paren_map_;
   std::unordered_map<std::pair<StackId, Label>, StackId, ChildHash>
-      child_map_;    // Child of stack node wrt label
+      child_map_;    // Child of stack node wrt label, if !use_bitmap_
+  std::vector<StackId> children_;  // Child blocks of stack nodes
+  std::vector<uint32> free_blocks_[7];  // Free child blocks by log2 capacity
   Label min_paren_;  // For faster paren. check
   Label max_paren_;  // For faster paren. check
+  bool use_bitmap_;  // Use 'children_' rather than 'child_map_'?
 };
 
 template <typename T, typename L>
@@ -63,9 +63,16 @@ struct PdtExpandOptions {
   bool connect;
   bool keep_parentheses;
   const WeightClass &weight_threshold;
-
-  PdtExpandOptions(bool c, bool k, const WeightClass &w)
-      : connect(c), keep_parentheses(k), weight_threshold(w) {}
+  bool best_first;
+  int64 max_stack_depth;
+
+  PdtExpandOptions(bool c, bool k, const WeightClass &w, bool b = false,
+                   int64 d = -1)
+      : connect(c),
+        keep_parentheses(k),
+        weight_threshold(w),
+        best_first(b),
+        max_stack_depth(d) {}
 };
 
 typedef args::Package<const FstClass &, const std::vector<LabelPair> &,
@@ -85,7 +92,8 @@ void PdtExpand(PdtExpandArgs *args) {
   Expand(fst, typed_parens, ofst,
          fst::PdtExpandOptions<Arc>(args->arg4.connect,
          args->arg4.keep_parentheses,
-         *(args->arg4.weight_threshold.GetWeight<typename Arc::Weight>())));
+         *(args->arg4.weight_threshold.GetWeight<typename Arc::Weight>()),
+         args->arg4.best_first, args->arg4.max_stack_depth));
 }
 
 void PdtExpand(const FstClass &ifst, const std::vector<LabelPair> &parens,
@@ -8,10 +8,12 @@
 
 #include <fst/extensions/pdt/paren.h>
 #include <fst/extensions/pdt/pdt.h>
+#include <fst/memory.h>
 #include <fst/shortest-path.h>
 
 #include <stack>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace fst {
@@ -25,6 +27,128 @@ struct PdtShortestPathOptions {
       : keep_parentheses(kp), path_gc(gc) {}
 };
 
+// Open-addressing hash table from keys to search data, used by
+// PdtShortestPathData. The data are allocated from a memory pool so that
+// pointers to them remain valid while the table grows, and the table itself
+// is a single flat array of (key, data pointer) slots using linear probing.
+// Erasure uses backward-shift deletion so no tombstones are left behind by
+// the garbage collector.
+template <class K, class D, class H>
+class PdtSearchTable {
+ public:
+  typedef K Key;
+  typedef D Data;
+
+  PdtSearchTable() : size_(0), bits_(kMinBits) { slots_.resize(1 << bits_); }
+
+  ~PdtSearchTable() { Clear(); }
+
+  // Returns data for 'key' or nullptr if not present.
+  Data *Find(const Key &key) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = Bucket(key);; i = (i + 1) & mask) {
+      const Slot &slot = slots_[i];
+      if (slot.data == nullptr) return nullptr;
+      if (slot.key == key) return slot.data;
+    }
+  }
+
+  // Returns data for 'key', inserting default data if not present.
+  Data *FindOrInsert(const Key &key) {
+    if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum) Rehash();
+    const size_t mask = slots_.size() - 1;
+    size_t i = Bucket(key);
+    for (; slots_[i].data != nullptr; i = (i + 1) & mask) {
+      if (slots_[i].key == key) return slots_[i].data;
+    }
+    slots_[i].key = key;
+    slots_[i].data = new (pool_.Allocate()) Data();
+    ++size_;
+    return slots_[i].data;
+  }
+
+  void Erase(const Key &key) {
+    const size_t mask = slots_.size() - 1;
+    size_t i = Bucket(key);
+    for (; slots_[i].data != nullptr; i = (i + 1) & mask) {
+      if (slots_[i].key == key) break;
+    }
+    if (slots_[i].data == nullptr) return;
+    slots_[i].data->~Data();
+    pool_.Free(slots_[i].data);
+    --size_;
+    // Shifts back any entries whose probe sequence passes through 'i'.
+    for (size_t j = (i + 1) & mask; slots_[j].data != nullptr;
+         j = (j + 1) & mask) {
+      const size_t k = Bucket(slots_[j].key);
+      if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i].data = nullptr;
+  }
+
+  void Clear() {
+    for (Slot &slot : slots_) {
+      if (slot.data == nullptr) continue;
+      slot.data->~Data();
+      pool_.Free(slot.data);
+      slot.data = nullptr;
+    }
+    size_ = 0;
+  }
+
+  size_t Size() const { return size_; }
+
+  // Approximate number of bytes used, not counting pool fragmentation.
+  size_t MemoryUsage() const {
+    return slots_.size() * sizeof(Slot) + size_ * sizeof(Data);
+  }
+
+ private:
+  static const int kMinBits = 4;
+  static const size_t kMaxLoadNum = 3;  // Maximum load factor numerator
+  static const size_t kMaxLoadDen = 4;  // Maximum load factor denominator
+
+  struct Slot {
+    Slot() : data(nullptr) {}
+
+    Key key;
+    Data *data;  // nullptr iff the slot is empty
+  };
+
+  // Fibonacci hashing spreads the (often consecutive) state IDs over the
+  // table.
+  size_t Bucket(const Key &key) const {
+    return static_cast<size_t>(
+        (static_cast<uint64>(hash_(key)) * 0x9E3779B97F4A7C15ULL) >>
+        (64 - bits_));
+  }
+
+  void Rehash() {
+    std::vector<Slot> slots(slots_.size() * 2);
+    slots_.swap(slots);
+    ++bits_;
+    const size_t mask = slots_.size() - 1;
+    for (const Slot &slot : slots) {
+      if (slot.data == nullptr) continue;
+      size_t i = Bucket(slot.key);
+      while (slots_[i].data != nullptr) i = (i + 1) & mask;
+      slots_[i] = slot;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_;
+  int bits_;
+  H hash_;
+  MemoryPool<Data> pool_;
+
+  PdtSearchTable(const PdtSearchTable &) = delete;
+  PdtSearchTable &operator=(const PdtSearchTable &) = delete;
+};
+
 // Class to store PDT shortest path results. Stores shortest path
 // tree info 'Distance()', Parent(), and ArcParent() information keyed
 // on two types:
@@ -96,29 +220,70 @@ class PdtShortestPathData {
     uint8 flags;         // First byte reserved for PdtShortestPathData use
   };
 
+  // Maximum number of distinct 'start' states for which search data is kept
+  // in dense per-start arrays rather than in the hash table.
+  static const size_t kMaxDenseStarts;
+
   PdtShortestPathData(bool gc)
       : state_(kNoStateId, kNoStateId),
+        state_data_(nullptr),
         paren_(kNoLabel, kNoStateId, kNoStateId),
+        paren_data_(nullptr),
         gc_(gc),
         nstates_(0),
         ngc_(0),
+        num_input_states_(0),
         finished_(false) {}
 
   ~PdtShortestPathData() {
-    VLOG(1) << "opm size: " << paren_map_.size();
+    VLOG(1) << "opm size: " << paren_map_.Size();
     VLOG(1) << "# of search states: " << nstates_;
+    VLOG(1) << "# of dense start states: " << dense_data_.size();
+    VLOG(1) << "search data memory: " << MemoryUsage() << " bytes";
     if (gc_) VLOG(1) << "# of GC'd search states: " << ngc_;
+    Clear();
   }
 
   void Clear() {
-    search_map_.clear();
+    for (size_t i = 0; i < dense_data_.size(); ++i) {
+      for (SearchData *data : dense_data_[i]) {
+        if (data == nullptr) continue;
+        data->~SearchData();
+        dense_pool_.Free(data);
+      }
+    }
+    dense_data_.clear();
+    dense_index_.clear();
+    num_input_states_ = 0;
+    search_map_.Clear();
     search_multimap_.clear();
-    paren_map_.clear();
+    paren_map_.Clear();
     state_ = SearchState(kNoStateId, kNoStateId);
+    paren_ = ParenSpec(kNoLabel, kNoStateId, kNoStateId);
     nstates_ = 0;
     ngc_ = 0;
   }
 
+  // Optionally called after Clear() with the number of input states and
+  // the number of possible 'start' states (the PDT start state and the
+  // destination states of open parentheses). When there are few start
+  // states, search data is stored in arrays indexed directly by state.
+  void Reserve(StateId num_states, size_t num_starts) {
+    if (num_starts == 0 || num_starts > kMaxDenseStarts) return;
+    num_input_states_ = num_states;
+    dense_index_.assign(num_states, -1);
+  }
+
+  // Approximate number of bytes used by the search data.
+  size_t MemoryUsage() const {
+    size_t size = search_map_.MemoryUsage() + paren_map_.MemoryUsage() +
+                  dense_index_.size() * sizeof(int32);
+    for (size_t i = 0; i < dense_data_.size(); ++i) {
+      size += dense_data_[i].size() * sizeof(SearchData *);
+    }
+    return size + (nstates_ - ngc_ - search_map_.Size()) * sizeof(SearchData);
+  }
+
   Weight Distance(SearchState s) const {
     SearchData *data = GetSearchData(s);
     return data->distance;
@@ -208,27 +373,50 @@ class PdtShortestPathData {
     }
   };
 
-  typedef std::unordered_map<SearchState, SearchData, SearchStateHash>
-      SearchMap;
+  typedef PdtSearchTable<SearchState, SearchData, SearchStateHash> SearchMap;
 
-  typedef std::unordered_multimap<StateId, StateId> SearchMultimap;
+  // Maps from 'start' state to the states of its sub-graph
+  typedef std::unordered_map<StateId, std::vector<StateId>> SearchMultimap;
 
   // Hash map from paren spec to open paren data
-  typedef std::unordered_map<ParenSpec, SearchData, ParenHash> ParenMap;
+  typedef PdtSearchTable<ParenSpec, SearchData, ParenHash> ParenMap;
+
+  // Returns the dense array slot for search state 's', or nullptr if 's' is
+  // kept in the hash table. A dense array is assigned to a 'start' state the
+  // first time it is seen (unless 'finished_'), so the choice is stable.
+  SearchData **GetDenseSlot(SearchState s) const {
+    if (s.start < 0 || s.start >= num_input_states_ || s.state < 0 ||
+        s.state >= num_input_states_) {
+      return nullptr;
+    }
+    int32 &index = dense_index_[s.start];
+    if (index < 0) {
+      if (finished_ || dense_data_.size() >= kMaxDenseStarts) return nullptr;
+      index = dense_data_.size();
+      dense_data_.emplace_back(num_input_states_, nullptr);
+    }
+    return &dense_data_[index][s.state];
+  }
 
   SearchData *GetSearchData(SearchState s) const {
     if (s == state_) return state_data_;
+    SearchData **slot = GetDenseSlot(s);
     if (finished_) {
-      auto it = search_map_.find(s);
-      if (it == search_map_.end()) return &null_search_data_;
+      SearchData *data = slot ? *slot : search_map_.Find(s);
+      if (data == nullptr) return &null_search_data_;
       state_ = s;
-      return state_data_ = &(it->second);
+      return state_data_ = data;
     } else {
       state_ = s;
-      state_data_ = &search_map_[s];
+      if (slot) {
+        if (*slot == nullptr) *slot = new (dense_pool_.Allocate()) SearchData();
+        state_data_ = *slot;
+      } else {
+        state_data_ = search_map_.FindOrInsert(s);
+      }
       if (!(state_data_->flags & kInited)) {
         ++nstates_;
-        if (gc_) search_multimap_.insert(std::make_pair(s.start, s.state));
+        if (gc_) search_multimap_[s.start].push_back(s.state);
         state_data_->flags = kInited;
       }
       return state_data_;
@@ -238,13 +426,26 @@ class PdtShortestPathData {
   SearchData *GetSearchData(ParenSpec paren) const {
     if (paren == paren_) return paren_data_;
     if (finished_) {
-      auto it = paren_map_.find(paren);
-      if (it == paren_map_.end()) return &null_search_data_;
+      SearchData *data = paren_map_.Find(paren);
+      if (data == nullptr) return &null_search_data_;
       paren_ = paren;
-      return state_data_ = &(it->second);
+      return paren_data_ = data;
     } else {
       paren_ = paren;
-      return paren_data_ = &paren_map_[paren];
+      return paren_data_ = paren_map_.FindOrInsert(paren);
+    }
+  }
+
+  // Deletes search data for search state 's'.
+  void EraseSearchData(SearchState s) {
+    if (s == state_) state_ = SearchState(kNoStateId, kNoStateId);
+    SearchData **slot = GetDenseSlot(s);
+    if (slot) {
+      (*slot)->~SearchData();
+      dense_pool_.Free(*slot);
+      *slot = nullptr;
+    } else {
+      search_map_.Erase(s);
     }
   }
 
@@ -259,6 +460,10 @@ class PdtShortestPathData {
   mutable size_t nstates_;                  // Total number of search states
   size_t ngc_;                              // Number of GC'd search states
   mutable SearchData null_search_data_;     // Null search data
+  StateId num_input_states_;                // Dense array size; 0 if unused
+  mutable std::vector<int32> dense_index_;  // Start state to dense array
+  mutable std::vector<std::vector<SearchData *>> dense_data_;  // Dense arrays
+  mutable MemoryPool<SearchData> dense_pool_;  // Dense array search data
   bool finished_;                           // Read-only access when true
 
   PdtShortestPathData(const PdtShortestPathData &) = delete;
@@ -271,25 +476,29 @@ class PdtShortestPathData {
 template <class Arc>
 void PdtShortestPathData<Arc>::GC(StateId start) {
   if (!gc_) return;
+  auto mmit = search_multimap_.find(start);
+  if (mmit == search_multimap_.end()) return;
+  std::vector<StateId> states;
+  states.swap(mmit->second);
+  search_multimap_.erase(mmit);
   std::vector<StateId> final;
-  for (auto mmit = search_multimap_.find(start);
-       mmit != search_multimap_.end() && mmit->first == start; ++mmit) {
-    SearchState s(mmit->second, start);
-    const SearchData &data = search_map_[s];
-    if (data.flags & kFinal) final.push_back(s.state);
+  for (StateId state : states) {
+    SearchState s(state, start);
+    const SearchData *data = GetSearchData(s);
+    if (data->flags & kFinal) final.push_back(s.state);
   }
 
   // Mark phase
   for (size_t i = 0; i < final.size(); ++i) {
     SearchState s(final[i], start);
     while (s.state != kNoLabel) {
-      SearchData *sdata = &search_map_[s];
+      SearchData *sdata = GetSearchData(s);
       if (sdata->flags & kMarked) break;
       sdata->flags |= kMarked;
       SearchState p = sdata->parent;
       if (p.start != start && p.start != kNoLabel) {  // entering sub-subgraph
         ParenSpec paren(sdata->paren_id, s.start, p.start);
-        SearchData *pdata = &paren_map_[paren];
+        SearchData *pdata = GetSearchData(paren);
         s = pdata->parent;
       } else {
         s = p;
@@ -298,16 +507,13 @@ void PdtShortestPathData<Arc>::GC(StateId start) {
   }
 
   // Sweep phase
-  auto mmit = search_multimap_.find(start);
-  while (mmit != search_multimap_.end() && mmit->first == start) {
-    SearchState s(mmit->second, start);
-    auto mit = search_map_.find(s);
-    const SearchData &data = mit->second;
-    if (!(data.flags & kMarked)) {
-      search_map_.erase(mit);
+  for (StateId state : states) {
+    SearchState s(state, start);
+    const SearchData *data = GetSearchData(s);
+    if (!(data->flags & kMarked)) {
+      EraseSearchData(s);
       ++ngc_;
     }
-    search_multimap_.erase(mmit++);
   }
 }
 
@@ -315,6 +521,9 @@ template <class Arc>
 const Arc PdtShortestPathData<Arc>::kNoArc = Arc(kNoLabel, kNoLabel,
                                                  Weight::Zero(), kNoStateId);
 
+template <class Arc>
+const size_t PdtShortestPathData<Arc>::kMaxDenseStarts = 16;
+
 template <class Arc>
 const size_t PdtShortestPathData<Arc>::kPrime0 = 7853;
 
@@ -468,8 +677,12 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
   nenqueued_ = 0;
 
   // Find open parens per destination state and close parens per source state.
+  StateId num_states = 0;
+  std::unordered_set<StateId> starts;
+  starts.insert(start_);
   for (StateIterator<Fst<Arc>> siter(*ifst_); !siter.Done(); siter.Next()) {
     StateId s = siter.Value();
+    if (s >= num_states) num_states = s + 1;
     for (ArcIterator<Fst<Arc>> aiter(*ifst_, s); !aiter.Done(); aiter.Next()) {
       const Arc &arc = aiter.Value();
       typename std::unordered_map<Label, Label>::const_iterator pit =
@@ -478,6 +691,7 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
         Label paren_id = pit->second;
         if (arc.ilabel == parens_[paren_id].first) {  // Open paren
           balance_data_.OpenInsert(paren_id, arc.nextstate);
+          starts.insert(arc.nextstate);
         } else {  // Close paren
           ParenState<Arc> paren_state(paren_id, s);
           close_paren_multimap_.insert(std::make_pair(paren_state, arc));
@@ -485,6 +699,7 @@ void PdtShortestPath<Arc, Queue>::Init(MutableFst<Arc> *ofst) {
       }
     }
   }
+  sp_data_.Reserve(num_states, starts.size());
 }
 
 // Computes the shortest distance stored in a recursive way. Each
@@ -8,10 +8,10 @@
 
 #include <algorithm>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <fst/bi-table.h>
 #include <fst/cache.h>
 #include <fst/test-properties.h>
 
@@ -256,7 +256,7 @@ class FactorWeightFstImpl : public CacheImpl<A> {
 
   Weight Final(StateId s) {
     if (!HasFinal(s)) {
-      const Element &e = elements_[s];
+      const Element &e = element_table_.FindEntry(s);
       // TODO(sorenj): fix so cast is unnecessary
       Weight w = e.state == kNoStateId
                      ? e.weight
@@ -308,24 +308,18 @@ class FactorWeightFstImpl : public CacheImpl<A> {
         e.state != kNoStateId) {
       while (unfactored_.size() <= e.state) unfactored_.push_back(kNoStateId);
       if (unfactored_[e.state] == kNoStateId) {
-        unfactored_[e.state] = elements_.size();
-        elements_.push_back(e);
+        unfactored_[e.state] = element_table_.FindId(e);
       }
       return unfactored_[e.state];
     } else {
-      auto insert_result =
-          element_map_.insert(std::make_pair(e, elements_.size()));
-      if (insert_result.second) {
-        elements_.push_back(e);
-      }
-      return insert_result.first->second;
+      return element_table_.FindId(e);
     }
   }
 
   // Computes the outgoing transitions from a state, creating new destination
   // states as needed.
   void Expand(StateId s) {
-    Element e = elements_[s];
+    const Element e = element_table_.FindEntry(s);
     if (e.state != kNoStateId) {
       for (ArcIterator<Fst<A>> ait(*fst_, e.state); !ait.Done(); ait.Next()) {
         const A &arc = ait.Value();
@@ -383,8 +377,9 @@ class FactorWeightFstImpl : public CacheImpl<A> {
    private:
   };
 
-  typedef std::unordered_map<Element, StateId, ElementKey, ElementEqual>
-      ElementMap;
+  // Each element is stored once; the hash set indexes the stored elements.
+  typedef CompactHashBiTable<StateId, Element, ElementKey, ElementEqual,
+                             HS_STL> ElementTable;
 
   std::unique_ptr<const Fst<A>> fst_;
   float delta_;
@@ -393,8 +388,7 @@ class FactorWeightFstImpl : public CacheImpl<A> {
   Label final_olabel_;  // olabel of arc created when factoring final w's
   bool increment_final_ilabel_;    // when factoring final w's results >1 arcs,
   bool increment_final_olabel_;    // increment labels to make them distinct.
-  std::vector<Element> elements_;  // mapping Fst state to Elements
-  ElementMap element_map_;         // mapping Elements to Fst state
+  ElementTable element_table_;     // mapping between Fst states and Elements
   // mapping between old/new 'StateId' for states that do not need to
   // be factored when 'mode_' is '0' or 'kFactorFinalWeights'
   std::vector<StateId> unfactored_;
@@ -12,6 +12,7 @@
 #include <limits>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 #include <fst/util.h>
 #include <fst/weight.h>
@@ -93,6 +94,21 @@ class FloatWeightTpl {
 // Single-precision float weight.
 typedef FloatWeightTpl<float> FloatWeight;
 
+namespace internal {
+
+// Whether W is a weight holding a single real value (e.g., TropicalWeight or
+// LogWeight), as required by RadixQueue.
+template <class W, class = void>
+struct IsFloatWeight : std::false_type {};
+
+template <class W>
+struct IsFloatWeight<
+    W, typename std::enable_if<std::is_base_of<
+           FloatWeightTpl<typename W::ValueType>, W>::value>::type>
+    : std::true_type {};
+
+}  // namespace internal
+
 template <class T>
 inline bool operator==(const FloatWeightTpl<T> &w1,
                        const FloatWeightTpl<T> &w2) {
@@ -20,6 +20,7 @@
 #include <fstream>
 
 #include <fst/arc.h>
+#include <fst/mapped-file.h>
 #include <fst/memory.h>
 #include <fst/properties.h>
 #include <fst/register.h>
@@ -57,6 +58,8 @@ struct FstReadOptions {
   FileReadMode mode;            // Read or map files (advisory, if possible)
   bool read_isymbols;           // Read isymbols, if any, default true
   bool read_osymbols;           // Read osymbols, if any, default true
+  MappedFile::Advice map_advice;  // Access advice for mapped regions
+  bool map_hugepages;             // Request huge pages for mapped regions
 
   explicit FstReadOptions(const string &src = "<unspecified>",
                           const FstHeader *hdr = nullptr,
@@ -69,6 +72,10 @@ struct FstReadOptions {
   // Helper function to convert strings FileReadModes into their enum value.
   static FileReadMode ReadMode(const string &mode);
 
+  // Helper function to convert strings ("normal", "random", "willneed" or
+  // "prefault") into mapped region access advice.
+  static MappedFile::Advice MapAdvice(const string &advice);
+
   // Outputs a debug string for the FstReadOptions object.
   string DebugString() const;
 };
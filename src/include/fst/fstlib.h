@@ -72,6 +72,7 @@
 #include <fst/shortest-distance.h>
 #include <fst/shortest-path.h>
 #include <fst/state-map.h>
+#include <fst/state-reorder.h>
 #include <fst/statesort.h>
 #include <fst/synchronize.h>
 #include <fst/topsort.h>
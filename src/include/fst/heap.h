@@ -8,6 +8,7 @@
 #ifndef FST_LIB_HEAP_H_
 #define FST_LIB_HEAP_H_
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -24,6 +25,10 @@ namespace fst {
 // to the calling functions on heap insert. This key can be used
 // to later update the specific value in the heap.
 //
+// The heap is kArity-ary rather than binary, and each value is stored next to
+// its key, so a sift touches fewer and more contiguous cache lines. Sifts move
+// a hole rather than swapping, writing each displaced element once.
+//
 // T: the element type of the hash, can be POD, Data or Ptr to Data
 // Compare: comparison class for determining min-heapness.
 template <class T, class Compare>
@@ -32,6 +37,9 @@ class Heap {
   using Value = T;
   enum { kNoKey = -1 };
 
+  // Number of children per node.
+  static constexpr int kArity = 4;
+
   // Initializes with a specific comparator.
   explicit Heap(Compare comp) : comp_(comp), size_(0) {}
 
@@ -40,16 +48,14 @@ class Heap {
 
   // Inserts a value into the heap.
   int Insert(const Value& val) {
-    if (size_ < values_.size()) {
-      values_[size_] = val;
-      pos_[key_[size_]] = size_;
+    if (size_ < entries_.size()) {
+      entries_[size_].value = val;
     } else {
-      values_.push_back(val);
+      entries_.push_back(Entry(val, size_));
       pos_.push_back(size_);
-      key_.push_back(size_);
     }
     ++size_;
-    return Insert(val, size_ - 1);
+    return SiftUp(size_ - 1);
   }
 
   // Updates a value at position given by the key. The pos array is first
@@ -58,34 +64,38 @@ class Heap {
   // to calculate the parent and child positions.
   void Update(int key, const Value& val) {
     const int i = pos_[key];
-    const bool is_better = comp_(val, values_[Parent(i)]);
-    values_[i] = val;
+    const bool is_better = i > 0 && comp_(val, entries_[Parent(i)].value);
+    entries_[i].value = val;
     if (is_better) {
-      Insert(val, i);
+      SiftUp(i);
     } else {
-      Heapify(i);
+      SiftDown(i);
     }
   }
 
   // Returns the greatest (max=true) / least (max=false) value w.r.t.
   // from the heap.
   Value Pop() {
-    Value top = values_.front();
-    Swap(0, size_-1);
-    size_--;
-    Heapify(0);
+    Value top = entries_.front().value;
+    --size_;
+    if (size_ > 0) {
+      using std::swap;
+      swap(entries_[0], entries_[size_]);
+      pos_[entries_[size_].key] = size_;
+      SiftDown(0);
+    }
     return top;
   }
 
   // Returns the greatest (max=true) / least (max=false) value w.r.t.
   // comp object from the heap.
   const Value& Top() const {
-    return values_.front();
+    return entries_.front().value;
   }
 
   // Returns the element for the given key.
   const Value& Get(int key) const {
-    return values_[pos_[key]];
+    return entries_[pos_[key]].value;
   }
 
   // Checks if the heap is empty.
@@ -102,78 +112,84 @@ class Heap {
   }
 
   void Reserve(int size) {
-    values_.reserve(size);
+    entries_.reserve(size);
     pos_.reserve(size);
-    key_.reserve(size);
   }
 
  private:
+  // A heap value together with its key.
+  struct Entry {
+    Entry(const Value& value, int key) : value(value), key(key) {}
+
+    Value value;
+    int key;
+  };
+
   // The following private routines are used in a supportive role
   // for managing the heap and keeping the heap properties.
 
-  // Computes left child of parent.
-  static int Left(int i) {
-    return 2 * (i + 1) - 1;  // 0 -> 1, 1 -> 3
-  }
-
-  // Computes right child of parent.
-  static int Right(int i) {
-    return 2 * (i + 1);  // 0 -> 2, 1 -> 4
+  // Computes the first child of parent.
+  static int FirstChild(int i) {
+    return kArity * i + 1;  // 0 -> 1, 1 -> 5
   }
 
   // Given a child computes parent.
   static int Parent(int i) {
-    return (i - 1) / 2;  // 0 -> 0, 1 -> 0, 2 -> 0,  3 -> 1,  4 -> 1, ...
+    return (i - 1) / kArity;  // 1..4 -> 0, 5..8 -> 1, ...
   }
 
-  // Swaps a child, parent. Use to move element up/down tree.
-  // Note a little tricky here. When we swap we need to swap:
-  //   the value
-  //   the associated keys
-  //   the position of the value in the heap
-  void Swap(int j, int k) {
-    const int tkey = key_[j];
-    pos_[key_[j] = key_[k]] = j;
-    pos_[key_[k] = tkey] = k;
-
-    using std::swap;
-    swap(values_[j], values_[k]);
+  // Places an entry at position i, recording its new position.
+  void Place(int i, Entry&& entry) {
+    pos_[entry.key] = i;
+    entries_[i] = std::move(entry);
   }
 
-  // Heapifies subtree rooted at index i.
-  void Heapify(int i) {
-    const int l = Left(i);
-    const int r = Right(i);
-    int largest = (l < size_ && comp_(values_[l], values_[i])) ? l : i;
-    if (r < size_ && comp_(values_[r], values_[largest])) {
-      largest = r;
-    }
-
-    if (largest != i) {
-      Swap(i, largest);
-      Heapify(largest);
+  // Moves the entry at position i down until no child is better, returning
+  // its final position.
+  int SiftDown(int i) {
+    Entry entry = std::move(entries_[i]);
+    for (;;) {
+      const int first = FirstChild(i);
+      if (first >= size_) break;
+      const int last = std::min(first + kArity, size_);
+      int best = first;
+      for (int c = first + 1; c < last; ++c) {
+        if (comp_(entries_[c].value, entries_[best].value)) best = c;
+      }
+      if (!comp_(entries_[best].value, entry.value)) break;
+      Place(i, std::move(entries_[best]));
+      i = best;
     }
+    Place(i, std::move(entry));
+    return i;
   }
 
-  // Inserts (updates) element at subtree rooted at index i.
-  int Insert(const Value& val, int i) {
-    int p;
-    while (i > 0 && !comp_(values_[p = Parent(i)], val)) {
-      Swap(i, p);
+  // Moves the entry at position i up while it is not worse than its parent,
+  // returning its key.
+  int SiftUp(int i) {
+    Entry entry = std::move(entries_[i]);
+    while (i > 0) {
+      const int p = Parent(i);
+      if (comp_(entries_[p].value, entry.value)) break;
+      Place(i, std::move(entries_[p]));
       i = p;
     }
-    return key_[i];
+    const int key = entry.key;
+    Place(i, std::move(entry));
+    return key;
   }
 
  private:
   Compare comp_;
 
   std::vector<int> pos_;
-  std::vector<int> key_;
-  std::vector<Value> values_;
+  std::vector<Entry> entries_;
   int size_;
 };
 
+template <class T, class Compare>
+constexpr int Heap<T, Compare>::kArity;
+
 }  // namespace fst
 
 #endif  // FST_LIB_HEAP_H_
@@ -34,13 +34,25 @@ class MappedFile {
 
   const void* data() const { return reinterpret_cast<void*>(region_.data); }
 
+  // Advice on how the pages of a memory-mapped region will be accessed; see
+  // madvise(2). ADVICE_PREFAULT reads in the whole region when it is mapped,
+  // so that later accesses do not page fault.
+  enum Advice {
+    ADVICE_NORMAL,
+    ADVICE_RANDOM,
+    ADVICE_WILLNEED,
+    ADVICE_PREFAULT
+  };
+
   // Returns a MappedFile object that contains the contents of the input
   // stream s starting from the current file position with size bytes.
   // the memorymap bool is advisory, and Map will default to allocating and
   // reading.  source needs to contain the filename that was used to open
-  // the istream.
+  // the istream. The advice is used only if the region is memory-mapped;
+  // hugepages requests transparent huge pages for the region (advisory).
   static MappedFile* Map(std::istream* s, bool memorymap, const string& source,
-                         size_t size);
+                         size_t size, Advice advice = ADVICE_NORMAL,
+                         bool hugepages = false);
 
   // Creates a MappedFile object with a new[]'ed block of memory of size.
   // Align can be used to specify a desired block alignment.
@@ -35,7 +35,7 @@ namespace fst {
 // - final weight
 // - out degree,
 // -  (input label, output label, weight, destination_block)
-template <class A>
+template <class A, class P = Partition<typename A::StateId>>
 class StateComparator {
  public:
   using Arc = A;
@@ -47,8 +47,7 @@ class StateComparator {
   static const uint32 kCompareArcs = 0x00000004;
   static const uint32 kCompareAll = 0x00000007;
 
-  StateComparator(const Fst<A>& fst,
-                  const Partition<typename A::StateId>& partition,
+  StateComparator(const Fst<A>& fst, const P& partition,
                   uint32 flags = kCompareAll)
       : fst_(fst), partition_(partition), flags_(flags) {}
 
@@ -92,18 +91,18 @@ class StateComparator {
 
  private:
   const Fst<A>& fst_;
-  const Partition<typename A::StateId>& partition_;
+  const P& partition_;
   const uint32 flags_;
 };
 
-template <class A>
-const uint32 StateComparator<A>::kCompareFinal;
-template <class A>
-const uint32 StateComparator<A>::kCompareOutDegree;
-template <class A>
-const uint32 StateComparator<A>::kCompareArcs;
-template <class A>
-const uint32 StateComparator<A>::kCompareAll;
+template <class A, class P>
+const uint32 StateComparator<A, P>::kCompareFinal;
+template <class A, class P>
+const uint32 StateComparator<A, P>::kCompareOutDegree;
+template <class A, class P>
+const uint32 StateComparator<A, P>::kCompareArcs;
+template <class A, class P>
+const uint32 StateComparator<A, P>::kCompareAll;
 
 // Computes equivalence classes for cyclic unweighted acceptors. For cyclic
 // minimization we use the classic Hopcroft minimization algorithm, which has
@@ -119,7 +118,9 @@ const uint32 StateComparator<A>::kCompareAll;
 // idempotent (if the semiring is not idempotent, there are some complexities
 // in keeping track of the weight when there are multiple arcs to states that
 // will be merged, and we don't deal with this).
-template <class A, class Queue>
+//
+// The partition type P is either Partition or FlatPartition.
+template <class A, class Queue, class P = Partition<typename A::StateId>>
 class CyclicMinimizer {
  public:
   using Arc = A;
@@ -134,7 +135,7 @@ class CyclicMinimizer {
     Compute(fst);
   }
 
-  const Partition<StateId>& partition() const { return P_; }
+  const P& partition() const { return P_; }
 
  private:
   using ArcIter = ArcIterator<Fst<RevA>>;
@@ -173,7 +174,7 @@ class CyclicMinimizer {
 
   class ArcIterCompare {
    public:
-    explicit ArcIterCompare(const Partition<StateId>& partition)
+    explicit ArcIterCompare(const P& partition)
         : partition_(partition) {}
 
     ArcIterCompare(const ArcIterCompare& comp) : partition_(comp.partition_) {}
@@ -185,7 +186,7 @@ class CyclicMinimizer {
       return xarc.ilabel > yarc.ilabel;
     }
    private:
-    const Partition<StateId> &partition_;
+    const P &partition_;
   };
 
   typedef std::priority_queue<ArcIter*, std::vector<ArcIter*>, ArcIterCompare>
@@ -255,7 +256,7 @@ class CyclicMinimizer {
   void Split(ClassId C) {
     // Prepares priority queue: opens arc iterator for each state in C, and
     // inserts into priority queue.
-    for (PartitionIterator<StateId> siter(P_, C); !siter.Done(); siter.Next()) {
+    for (typename P::Iterator siter(P_, C); !siter.Done(); siter.Next()) {
       StateId s = siter.Value();
       if (Tr_.NumArcs(s + 1)) {
         aiter_queue_->push(new ArcIterator<Fst<RevA>>(Tr_, s + 1));
@@ -299,7 +300,7 @@ class CyclicMinimizer {
 
  private:
   // Partioning of states into equivalence classes.
-  Partition<StateId> P_;
+  P P_;
   // Set of active classes to be processed in partition P.
   Queue L_;
   // Reverses transition function.
@@ -316,7 +317,9 @@ class CyclicMinimizer {
 // time. Theoretical Computer Science 92(1): 181-189.
 //
 // The complexity of this algorithm is O(e) where e is the number of edges.
-template <class A>
+//
+// The partition type P is either Partition or FlatPartition.
+template <class A, class P = Partition<typename A::StateId>>
 class AcyclicMinimizer {
  public:
   using Arc = A;
@@ -330,7 +333,7 @@ class AcyclicMinimizer {
     Refine(fst);
   }
 
-  const Partition<StateId>& partition() { return partition_; }
+  const P& partition() { return partition_; }
 
  private:
   // DFS visitor to compute the height (distance) to final state.
@@ -403,14 +406,14 @@ class AcyclicMinimizer {
 
   // Refines states based on arc sort (out degree, arc equivalence).
   void Refine(const Fst<A>& fst) {
-    typedef std::map<StateId, StateId, StateComparator<A>> EquivalenceMap;
-    StateComparator<A> comp(fst, partition_);
+    typedef std::map<StateId, StateId, StateComparator<A, P>> EquivalenceMap;
+    StateComparator<A, P> comp(fst, partition_);
     // Starts with tail (height = 0).
     size_t height = partition_.NumClasses();
     for (size_t h = 0; h < height; ++h) {
       EquivalenceMap equiv_classes(comp);
       // Sorts states within equivalence class.
-      PartitionIterator<StateId> siter(partition_, h);
+      typename P::Iterator siter(partition_, h);
       equiv_classes[siter.Value()] = h;
       for (siter.Next(); !siter.Done(); siter.Next()) {
         auto insert_result =
@@ -434,7 +437,7 @@ class AcyclicMinimizer {
   }
 
  private:
-  Partition<StateId> partition_;
+  P partition_;
 };
 
 // Given a partition and a Mutable FST, merges states of Fst in place (i.e.,
@@ -442,19 +445,18 @@ class AcyclicMinimizer {
 // partition to be the representative state for the class. Each arc is then
 // reconnected to this state. All states in the class are merged by adding
 // their arcs to the representative state.
-template <class A>
-void MergeStates(const Partition<typename A::StateId>& partition,
-                 MutableFst<A>* fst) {
+template <class A, class P>
+void MergeStates(const P& partition, MutableFst<A>* fst) {
   using Arc = A;
   using StateId = typename Arc::StateId;
   std::vector<StateId> state_map(partition.NumClasses());
   for (size_t i = 0; i < partition.NumClasses(); ++i) {
-    PartitionIterator<StateId> siter(partition, i);
+    typename P::Iterator siter(partition, i);
     state_map[i] = siter.Value();  // First state in partition.
   }
   // Relabels destination states.
   for (size_t c = 0; c < partition.NumClasses(); ++c) {
-    for (PartitionIterator<StateId> siter(partition, c); !siter.Done();
+    for (typename P::Iterator siter(partition, c); !siter.Done();
          siter.Next()) {
       StateId s = siter.Value();
       for (MutableArcIterator<MutableFst<A>> aiter(fst, s); !aiter.Done();
@@ -474,7 +476,7 @@ void MergeStates(const Partition<typename A::StateId>& partition,
   Connect(fst);
 }
 
-template <class A>
+template <class A, class P = Partition<typename A::StateId>>
 void AcceptorMinimize(MutableFst<A>* fst,
                       bool allow_acyclic_minimization = true) {
   using Arc = A;
@@ -492,14 +494,14 @@ void AcceptorMinimize(MutableFst<A>* fst,
     // Acyclic minimization (Revuz).
     VLOG(2) << "Acyclic Minimization";
     ArcSort(fst, ILabelCompare<A>());
-    AcyclicMinimizer<A> minimizer(*fst);
+    AcyclicMinimizer<A, P> minimizer(*fst);
     MergeStates(minimizer.partition(), fst);
   } else {
     // Either the FST has cycles, or it's generated from non-deterministic input
     // (which the Revuz algorithm can't handle), so use the cyclic minimization
     // algorithm of Hopcroft.
     VLOG(2) << "Cyclic Minimization";
-    CyclicMinimizer<A, LifoQueue<StateId>> minimizer(*fst);
+    CyclicMinimizer<A, LifoQueue<StateId>, P> minimizer(*fst);
     MergeStates(minimizer.partition(), fst);
   }
   // Merges in appropriate semiring
@@ -519,7 +521,11 @@ void AcceptorMinimize(MutableFst<A>* fst,
 // minimization (which was presented for the deterministic case but which
 // also works for non-deterministic FSTs); this has complexity O(e log v).
 //
-template <class A>
+// The partition type P used to represent the state equivalence classes is
+// either Partition or FlatPartition. The latter keeps the members of each
+// class contiguous in memory, which makes the refinement faster on large
+// inputs, but may number the states of the result differently.
+template <class A, class P = Partition<typename A::StateId>>
 void Minimize(MutableFst<A>* fst, MutableFst<A>* sfst = nullptr,
               float delta = kDelta, bool allow_nondet = false) {
   uint64 props = fst->Properties(
@@ -562,7 +568,8 @@ void Minimize(MutableFst<A>* fst, MutableFst<A>* sfst = nullptr,
     EncodeMapper<GallicArc<A, GALLIC_LEFT>> encoder(
         kEncodeLabels | kEncodeWeights, ENCODE);
     Encode(&gfst, &encoder);
-    AcceptorMinimize(&gfst, allow_acyclic_minimization);
+    AcceptorMinimize<GallicArc<A, GALLIC_LEFT>, P>(&gfst,
+                                                   allow_acyclic_minimization);
     Decode(&gfst, encoder);
     if (!sfst) {
       FactorWeightFst<
@@ -584,10 +591,10 @@ void Minimize(MutableFst<A>* fst, MutableFst<A>* sfst = nullptr,
     ArcMap(fst, QuantizeMapper<A>(delta));
     EncodeMapper<A> encoder(kEncodeLabels | kEncodeWeights, ENCODE);
     Encode(fst, &encoder);
-    AcceptorMinimize(fst, allow_acyclic_minimization);
+    AcceptorMinimize<A, P>(fst, allow_acyclic_minimization);
     Decode(fst, encoder);
   } else {  // Unweighted acceptor.
-    AcceptorMinimize(fst, allow_acyclic_minimization);
+    AcceptorMinimize<A, P>(fst, allow_acyclic_minimization);
   }
 }
 
@@ -18,6 +18,9 @@ namespace fst {
 template <typename T>
 class PartitionIterator;
 
+template <typename T>
+class FlatPartitionIterator;
+
 // Defines a partitioning of elements, used to represent equivalence classes
 // for FST operations like minimization. T must be a signed integer type.
 //
@@ -52,6 +55,8 @@ class PartitionIterator;
 template <typename T>
 class Partition {
  public:
+  typedef PartitionIterator<T> Iterator;
+
   Partition() {}
 
   explicit Partition(T num_elements) { Initialize(num_elements); }
@@ -307,6 +312,219 @@ class PartitionIterator {
   T element_id_;
   T class_id_;
 };
+
+// A partition with the same interface as Partition, but where the elements
+// of each class occupy a contiguous range of a single array (the refinable
+// partition of Valmari and Lehtinen). SplitOn() swaps an element into the
+// 'yes' prefix of its class range, and FinalizeSplit() splits a class by
+// cutting its range in two, so the Hopcroft refinement touches only a few
+// contiguous arrays instead of chasing list links.
+//
+// Add() and Move() only record the class of the element; the class ranges
+// are (re)built by a counting sort the next time a class whose membership
+// has changed is split or iterated over. After that, the members of a class
+// are visited in increasing element order. The iteration order otherwise
+// differs from that of Partition, so e.g. MergeStates() may pick different
+// (but equivalent) representative states.
+//
+// Reference:
+//
+// Antti Valmari and Petri Lehtinen, "Efficient minimization of DFAs with
+// partial transition functions," STACS 2008, pp. 645-656.
+template <typename T>
+class FlatPartition {
+ public:
+  typedef FlatPartitionIterator<T> Iterator;
+
+  FlatPartition() {}
+
+  explicit FlatPartition(T num_elements) { Initialize(num_elements); }
+
+  // Creates an empty partition for num_elements; see Partition::Initialize().
+  void Initialize(size_t num_elements) {
+    elements_.resize(num_elements);
+    locations_.resize(num_elements);
+    class_ids_.assign(num_elements, -1);
+    classes_.reserve(num_elements);
+    classes_.clear();
+    visited_classes_.clear();
+    laid_out_ = false;
+  }
+
+  // Adds a class; returns new number of classes.
+  T AddClass() {
+    size_t num_classes = classes_.size();
+    classes_.resize(num_classes + 1);
+    return num_classes;
+  }
+
+  // Adds 'num_classes' new (empty) classes.
+  void AllocateClasses(T num_classes) {
+    classes_.resize(classes_.size() + num_classes);
+  }
+
+  // Adds element_id, which must not be a member of any class, to class_id.
+  void Add(T element_id, T class_id) {
+    class_ids_[element_id] = class_id;
+    Class &this_class = classes_[class_id];
+    ++this_class.size;
+    this_class.laid_out = false;
+    laid_out_ = false;
+  }
+
+  // Moves element_id to class class_id. This may not work correctly if you
+  // have called SplitOn() and haven't subsequently called FinalizeSplit().
+  void Move(T element_id, T class_id) {
+    Class &old_class = classes_[class_ids_[element_id]];
+    --old_class.size;
+    CHECK(old_class.size >= 0 && old_class.yes_size == 0);
+    old_class.laid_out = false;
+    Add(element_id, class_id);
+  }
+
+  // Moves element_id to the 'yes' subset of its class, if not already there.
+  void SplitOn(T element_id) {
+    if (!laid_out_) Layout();
+    Class &this_class = classes_[class_ids_[element_id]];
+    T location = locations_[element_id];
+    T yes_end = this_class.first + this_class.yes_size;
+    if (location < yes_end) return;  // Already in the 'yes' set.
+    if (this_class.yes_size == 0) {
+      visited_classes_.push_back(class_ids_[element_id]);
+    }
+    // Swaps the element with the first 'no' element of its class.
+    T other_id = elements_[yes_end];
+    elements_[location] = other_id;
+    locations_[other_id] = location;
+    elements_[yes_end] = element_id;
+    locations_[element_id] = yes_end;
+    ++this_class.yes_size;
+    CHECK(this_class.yes_size <= this_class.size);
+  }
+
+  // Splits each class with a nontrivial 'yes' subset, moving the smaller of
+  // its 'yes' and 'no' subsets to a new class that is added to the queue;
+  // see Partition::FinalizeSplit().
+  template <class Queue>
+  void FinalizeSplit(Queue *L) {
+    for (size_t i = 0, size = visited_classes_.size(); i < size; ++i) {
+      T new_class = SplitRefine(visited_classes_[i]);
+      if (new_class != -1 && L) L->Enqueue(new_class);
+    }
+    visited_classes_.clear();
+  }
+
+  const T ClassId(T element_id) const { return class_ids_[element_id]; }
+
+  const size_t ClassSize(T class_id) const { return classes_[class_id].size; }
+
+  const T NumClasses() const { return classes_.size(); }
+
+ private:
+  friend class FlatPartitionIterator<T>;
+
+  // Information about a given class. Its elements are
+  // elements_[first, first + size), with the 'yes' subset first.
+  struct Class {
+    Class() : first(0), size(0), yes_size(0), laid_out(false) {}
+    T first;
+    T size;
+    T yes_size;
+    bool laid_out;  // Is [first, first + size) up to date?
+  };
+
+  // Lays out the classes in consecutive ranges of elements_, by increasing
+  // class ID and, within a class, by increasing element ID.
+  void Layout() const {
+    T first = 0;
+    for (size_t c = 0; c < classes_.size(); ++c) {
+      classes_[c].first = first;
+      classes_[c].laid_out = true;
+      first += classes_[c].size;
+    }
+    std::vector<T> next(classes_.size());
+    for (size_t c = 0; c < classes_.size(); ++c) next[c] = classes_[c].first;
+    for (size_t e = 0; e < class_ids_.size(); ++e) {
+      if (class_ids_[e] < 0) continue;
+      T location = next[class_ids_[e]]++;
+      elements_[location] = e;
+      locations_[e] = location;
+    }
+    laid_out_ = true;
+  }
+
+  // Called from FinalizeSplit(); returns the new class if one was created,
+  // or -1 if the whole class was in the 'yes' subset.
+  T SplitRefine(T class_id) {
+    T yes_size = classes_[class_id].yes_size, size = classes_[class_id].size,
+      no_size = size - yes_size;
+    classes_[class_id].yes_size = 0;
+    if (no_size == 0) return -1;
+    T new_class_id = AddClass();
+    Class &old_class = classes_[class_id], &new_class = classes_[new_class_id];
+    new_class.laid_out = true;
+    if (no_size < yes_size) {
+      // Moves the 'no' subset, the tail of the range, to the new class.
+      new_class.first = old_class.first + yes_size;
+      new_class.size = no_size;
+      old_class.size = yes_size;
+    } else {
+      // Moves the 'yes' subset, the head of the range, to the new class.
+      new_class.first = old_class.first;
+      new_class.size = yes_size;
+      old_class.first += yes_size;
+      old_class.size = no_size;
+    }
+    for (T i = new_class.first; i < new_class.first + new_class.size; ++i) {
+      class_ids_[elements_[i]] = new_class_id;
+    }
+    return new_class_id;
+  }
+
+  // The elements, grouped by class; the layout is rebuilt lazily on access,
+  // hence these are mutable.
+  mutable std::vector<T> elements_;
+  // locations_[e] is the position of element e in elements_.
+  mutable std::vector<T> locations_;
+  // class_ids_[e] is the class of element e, or -1 if not yet added.
+  std::vector<T> class_ids_;
+  mutable std::vector<Class> classes_;
+  // Set of visited classes to be used in split refine.
+  std::vector<T> visited_classes_;
+  // Are all class ranges up to date?
+  mutable bool laid_out_;
+};
+
+// Iterates over the members of a class in a FlatPartition. The iterator
+// sees the class as it was when the iterator was constructed or reset, so
+// elements can be moved out of the class while iterating over it.
+template <typename T>
+class FlatPartitionIterator {
+ public:
+  FlatPartitionIterator(const FlatPartition<T> &partition, T class_id)
+      : p_(partition), class_id_(class_id) {
+    if (!p_.classes_[class_id_].laid_out) p_.Layout();
+    begin_ = p_.classes_[class_id_].first;
+    end_ = begin_ + p_.classes_[class_id_].size;
+    position_ = begin_;
+  }
+
+  bool Done() { return position_ >= end_; }
+
+  const T Value() { return p_.elements_[position_]; }
+
+  void Next() { ++position_; }
+
+  void Reset() { position_ = begin_; }
+
+ private:
+  const FlatPartition<T> &p_;
+  T class_id_;
+  T begin_;
+  T end_;
+  T position_;
+};
+
 }  // namespace fst
 
 #endif  // FST_LIB_PARTITION_H_
@@ -6,11 +6,16 @@
 #ifndef FST_LIB_QUEUE_H_
 #define FST_LIB_QUEUE_H_
 
+#include <cmath>
+#include <cstring>
 #include <deque>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 #include <fst/arcfilter.h>
 #include <fst/connect.h>
+#include <fst/float-weight.h>
 #include <fst/heap.h>
 #include <fst/topsort.h>
 
@@ -48,7 +53,8 @@ enum QueueType {
   STATE_ORDER_QUEUE = 5,     // State-ID ordered queue
   SCC_QUEUE = 6,             // Component graph top-ordered meta-queue
   AUTO_QUEUE = 7,            // Auto-selected queue
-  OTHER_QUEUE = 8
+  OTHER_QUEUE = 8,
+  RADIX_QUEUE = 9            // Radix heap shortest-first queue
 };
 
 // QueueBase, templated on the StateId, is the base class shared by the
@@ -281,6 +287,202 @@ class NaturalShortestFirstQueue
   NaturalLess<W> less_;
 };
 
+namespace internal {
+
+// Maps floating-point values to unsigned integers with the same order.
+inline uint64 RadixKey(float value) {
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits & 0x80000000U) ? ~bits : bits | 0x80000000U;
+}
+
+inline uint64 RadixKey(double value) {
+  uint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits & 0x8000000000000000ULL) ? ~bits
+                                         : bits | 0x8000000000000000ULL;
+}
+
+// Current key of every enqueued state of an updating RadixQueue, indexed by
+// state. Queues holding disjoint sets of states, such as the per-SCC queues
+// of AutoQueue, may share one, so that together they use space linear in the
+// number of states.
+struct RadixQueueKeys {
+  std::vector<uint64> key;
+  std::vector<bool> enqueued;
+};
+
+}  // namespace internal
+
+// Radix heap queue discipline, templated on the StateId and a weight W holding
+// a single real value, e.g., TropicalWeight. States are dequeued in order of
+// increasing 'distance[s].Value()', optionally rounded down to a multiple of
+// 'quantum'; states with equal keys are dequeued last-in, first-out.
+//
+// Keys are bucketed by the highest bit in which they differ from the last
+// dequeued key, so that Enqueue, Update and Dequeue take amortized constant
+// time (at most one move per key bit), instead of O(log n) for
+// ShortestFirstQueue. The order is exact as long as keys are monotone, i.e.,
+// no state is enqueued with a smaller key than the last dequeued one, which is
+// the case for shortest-distance computations with non-negative tropical
+// weights. Otherwise, states with smaller keys are dequeued first, but not
+// necessarily in order.
+//
+// If 'update == false', Update() does not reorder the queue and no per-state
+// data is kept. Otherwise, the current keys are kept in 'keys' if given, and
+// in storage owned by the queue if not.
+template <typename S, typename W, bool update = true>
+class RadixQueue : public QueueBase<S> {
+ public:
+  typedef S StateId;
+  typedef W Weight;
+
+  explicit RadixQueue(const std::vector<W> &distance, float quantum = 0.0,
+                      internal::RadixQueueKeys *keys = nullptr)
+      : QueueBase<S>(RADIX_QUEUE),
+        distance_(distance),
+        quantum_(quantum),
+        last_(0),
+        size_(0),
+        buckets_(kNumBuckets),
+        own_keys_(update && !keys ? new internal::RadixQueueKeys() : nullptr),
+        keys_(keys ? keys : own_keys_.get()) {}
+
+  StateId Head() const { return buckets_[0].back().second; }
+
+  void Enqueue(StateId s) {
+    const uint64 key = Key(s);
+    if (update) {
+      if (static_cast<size_t>(s) >= keys_->key.size()) {
+        keys_->key.resize(s + 1, 0);
+        keys_->enqueued.resize(s + 1, false);
+      }
+      keys_->key[s] = key;
+      keys_->enqueued[s] = true;
+    }
+    Push(key, s);
+    ++size_;
+    Normalize();
+  }
+
+  void Dequeue() {
+    if (update) keys_->enqueued[buckets_[0].back().second] = false;
+    buckets_[0].pop_back();
+    --size_;
+    Normalize();
+  }
+
+  void Update(StateId s) {
+    if (!update) return;
+    if (static_cast<size_t>(s) >= keys_->enqueued.size() ||
+        !keys_->enqueued[s]) {
+      Enqueue(s);
+      return;
+    }
+    const uint64 key = Key(s);
+    if (key == keys_->key[s]) return;
+    // The old entry is left in place and skipped once it surfaces.
+    keys_->key[s] = key;
+    Push(key, s);
+    Normalize();
+  }
+
+  bool Empty() const { return size_ == 0; }
+
+  // Only the states of this queue are reset, as the keys may be shared.
+  void Clear() {
+    for (auto &bucket : buckets_) {
+      if (update) {
+        for (const auto &entry : bucket) keys_->enqueued[entry.second] = false;
+      }
+      bucket.clear();
+    }
+    last_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  typedef std::pair<uint64, StateId> Entry;
+
+  static const int kNumBuckets = 65;
+
+  uint64 Key(StateId s) const {
+    typename W::ValueType value = distance_[s].Value();
+    if (quantum_ > 0) value = std::floor(value / quantum_) * quantum_;
+    return internal::RadixKey(value);
+  }
+
+  // Bucket 0 holds keys equal to (or, if not monotone, less than) last_.
+  // Bucket i > 0 holds keys whose highest bit differing from last_ is bit
+  // i - 1.
+  int Bucket(uint64 key) const {
+    if (key <= last_) return 0;
+    return 64 - __builtin_clzll(key ^ last_);
+  }
+
+  void Push(uint64 key, StateId s) {
+    buckets_[Bucket(key)].push_back(Entry(key, s));
+  }
+
+  bool Valid(const Entry &entry) const {
+    return !update || (keys_->enqueued[entry.second] &&
+                       keys_->key[entry.second] == entry.first);
+  }
+
+  // Ensures that the back of bucket 0 is a valid entry for a minimal state,
+  // unless the queue is empty.
+  void Normalize() {
+    if (size_ == 0) {
+      if (update) {
+        for (auto &bucket : buckets_) bucket.clear();
+      }
+      return;
+    }
+    while (true) {
+      auto &front = buckets_[0];
+      while (!front.empty() && !Valid(front.back())) front.pop_back();
+      if (!front.empty()) return;
+      int i = 1;
+      while (buckets_[i].empty()) ++i;
+      auto &bucket = buckets_[i];
+      bool found = false;
+      uint64 min_key = 0;
+      for (const auto &entry : bucket) {
+        if (Valid(entry) && (!found || entry.first < min_key)) {
+          min_key = entry.first;
+          found = true;
+        }
+      }
+      if (found) last_ = min_key;
+      for (const auto &entry : bucket) {
+        if (Valid(entry)) buckets_[Bucket(entry.first)].push_back(entry);
+      }
+      bucket.clear();
+    }
+  }
+
+  const std::vector<W> &distance_;
+  float quantum_;
+  uint64 last_;                  // Last minimal key.
+  size_t size_;                  // Number of enqueued states.
+  std::vector<std::vector<Entry>> buckets_;
+  std::unique_ptr<internal::RadixQueueKeys> own_keys_;
+  internal::RadixQueueKeys *keys_;  // Current key per enqueued state.
+
+  // This allows base-class virtual access to non-virtual derived-
+  // class members of the same name. It makes the derived class more
+  // efficient to use but unsafe to further derive.
+  StateId Head_() const override { return Head(); }
+  void Enqueue_(StateId s) override { Enqueue(s); }
+  void Dequeue_() override { Dequeue(); }
+  void Update_(StateId s) override { Update(s); }
+  bool Empty_() const override { return Empty(); }
+  void Clear_() override { return Clear(); }
+};
+
+template <typename S, typename W, bool update>
+const int RadixQueue<S, W, update>::kNumBuckets;
+
 // Topological-order queue discipline, templated on the StateId.
 // States are ordered in the queue topologically. The FST must be acyclic.
 template <class S>
@@ -525,6 +727,42 @@ class SccQueue : public QueueBase<S> {
   void Clear_() override { return Clear(); }
 };
 
+namespace internal {
+
+// Constructs the shortest-first queue used by AutoQueue within an SCC of
+// 'scc_size' states: a heap-based ShortestFirstQueue, or, for weights
+// holding a single real value, a RadixQueue when the SCC is large enough to
+// amortize its buckets. All radix queues share 'keys', which is created on
+// first use.
+template <class S, class W, class C, bool = IsFloatWeight<W>::value>
+struct AutoShortestFirstQueue {
+  static QueueBase<S> *Construct(const std::vector<W> &distance,
+                                 const C &comp, size_t scc_size,
+                                 std::unique_ptr<RadixQueueKeys> *keys) {
+    return new ShortestFirstQueue<S, C, false>(comp);
+  }
+};
+
+template <class S, class W, class C>
+struct AutoShortestFirstQueue<S, W, C, true> {
+  static const size_t kMinRadixSccSize = 64;
+
+  static QueueBase<S> *Construct(const std::vector<W> &distance,
+                                 const C &comp, size_t scc_size,
+                                 std::unique_ptr<RadixQueueKeys> *keys) {
+    if (scc_size < kMinRadixSccSize) {
+      return new ShortestFirstQueue<S, C, false>(comp);
+    }
+    if (!*keys) keys->reset(new RadixQueueKeys());
+    return new RadixQueue<S, W, true>(distance, 0.0, keys->get());
+  }
+};
+
+template <class S, class W, class C>
+const size_t AutoShortestFirstQueue<S, W, C, true>::kMinRadixSccSize;
+
+}  // namespace internal
+
 // Automatic queue discipline, templated on the StateId. It selects a
 // queue discipline for a given FST based on its properties.
 template <class S>
@@ -543,15 +781,14 @@ class AutoQueue : public QueueBase<S> {
     typedef StateWeightCompare<StateId, NaturalLess<Weight>> Compare;
 
     //  First check if the FST is known to have these properties.
-    uint64 props =
-        fst.Properties(kAcyclic | kCyclic | kTopSorted | kUnweighted, false);
-    if ((props & kTopSorted) || fst.Start() == kNoStateId) {
+    QueueType type = PropertyQueueType(fst);
+    if (type == STATE_ORDER_QUEUE) {
       queue_.reset(new StateOrderQueue<StateId>());
       VLOG(2) << "AutoQueue: using state-order discipline";
-    } else if (props & kAcyclic) {
+    } else if (type == TOP_ORDER_QUEUE) {
       queue_.reset(new TopOrderQueue<StateId>(fst, filter));
       VLOG(2) << "AutoQueue: using top-order discipline";
-    } else if ((props & kUnweighted) && (Weight::Properties() & kIdempotent)) {
+    } else if (type == LIFO_QUEUE) {
       queue_.reset(new LifoQueue<StateId>());
       VLOG(2) << "AutoQueue: using LIFO discipline";
     } else {
@@ -586,6 +823,8 @@ class AutoQueue : public QueueBase<S> {
         return;
       }
       VLOG(2) << "AutoQueue: using SCC meta-discipline";
+      std::vector<size_t> scc_size(nscc, 0);
+      for (size_t s = 0; s < scc_.size(); ++s) ++scc_size[scc_[s]];
       queues_.resize(nscc);
       for (StateId i = 0; i < nscc; ++i) {
         switch (queue_types[i]) {
@@ -595,9 +834,12 @@ class AutoQueue : public QueueBase<S> {
             break;
           case SHORTEST_FIRST_QUEUE:
             queues_[i].reset(
-                new ShortestFirstQueue<StateId, Compare, false>(*comp));
-            VLOG(3) << "AutoQueue: SCC #" << i
-                    << ": using shortest-first discipline";
+                internal::AutoShortestFirstQueue<StateId, Weight, Compare>::
+                    Construct(*distance, *comp, scc_size[i], &radix_keys_));
+            VLOG(3) << "AutoQueue: SCC #" << i << ": using "
+                    << (queues_[i]->Type() == RADIX_QUEUE ? "radix"
+                                                          : "shortest-first")
+                    << " discipline";
             break;
           case LIFO_QUEUE:
             queues_[i].reset(new LifoQueue<StateId>());
@@ -614,6 +856,25 @@ class AutoQueue : public QueueBase<S> {
     }
   }
 
+  // Returns the discipline the constructor selects from the stored FST
+  // properties alone: STATE_ORDER_QUEUE, TOP_ORDER_QUEUE or LIFO_QUEUE, or
+  // AUTO_QUEUE when the choice requires an SCC decomposition. Callers may
+  // use it to run an algorithm on the concrete queue type.
+  template <class Arc>
+  static QueueType PropertyQueueType(const Fst<Arc> &fst) {
+    typedef typename Arc::Weight Weight;
+    uint64 props =
+        fst.Properties(kAcyclic | kCyclic | kTopSorted | kUnweighted, false);
+    if ((props & kTopSorted) || fst.Start() == kNoStateId) {
+      return STATE_ORDER_QUEUE;
+    } else if (props & kAcyclic) {
+      return TOP_ORDER_QUEUE;
+    } else if ((props & kUnweighted) && (Weight::Properties() & kIdempotent)) {
+      return LIFO_QUEUE;
+    }
+    return AUTO_QUEUE;
+  }
+
   StateId Head() const { return queue_->Head(); }
 
   void Enqueue(StateId s) { queue_->Enqueue(s); }
@@ -628,6 +889,7 @@ class AutoQueue : public QueueBase<S> {
 
  private:
   std::unique_ptr<QueueBase<StateId>> queue_;
+  std::unique_ptr<internal::RadixQueueKeys> radix_keys_;
   std::vector<std::unique_ptr<QueueBase<StateId>>> queues_;
   std::vector<StateId> scc_;
 
@@ -6,6 +6,8 @@
 #ifndef FST_LIB_REPLACE_H_
 #define FST_LIB_REPLACE_H_
 
+#include <algorithm>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -55,8 +57,26 @@ namespace fst {
 //   // Lookup prefix ID by stack prefix. If it doesn't exist, then add it.
 //   PrefixId FindPrefixId(const StackPrefix &stack_prefix);
 //
-//  // Look stack prefix by ID.
-//  const StackPrefix &GetStackPrefix(PrefixId id) const;
+//   // Look stack prefix by ID. May also return the prefix by value.
+//   const StackPrefix &GetStackPrefix(PrefixId id) const;
+//
+//   // The following are optional; when a table does not define them,
+//   // ReplaceFst falls back to GetStackPrefix() and FindPrefixId().
+//
+//   // Prefix ID after pushing (fst_id, nextstate) onto the prefix with ID.
+//   PrefixId PushPrefixId(PrefixId id, Label fst_id, StateId nextstate);
+//
+//   // Prefix ID after popping the prefix with ID.
+//   PrefixId PopPrefixId(PrefixId id) const;
+//
+//   // Top entry of the (non-empty) prefix with ID.
+//   const typename StackPrefix::PrefixTuple &TopPrefix(PrefixId id) const;
+//
+//   // Number of state tuples and stack prefixes stored, and the
+//   // approximate number of bytes they use.
+//   StateId NumTuples() const;
+//   PrefixId NumPrefixes() const;
+//   size_t MemoryUsage() const;
 // };
 
 //
@@ -223,6 +243,172 @@ class ReplaceStackPrefixHash {
 template <class L, class S>
 const size_t ReplaceStackPrefixHash<L, S>::kPrime0 = 7853;
 
+// \class ReplaceStackPrefixTable
+// \brief Stack prefix to prefix id table stored as a tree.
+//
+// Each prefix is kept as its parent prefix id plus its top entry, so
+// prefixes sharing a common bottom share storage, and pushing or
+// popping an entry is a single hash lookup or array access instead of
+// a copy and rehash of the whole stack. The empty prefix has id 0.
+template <class L, class S, class P>
+class ReplaceStackPrefixTable {
+ public:
+  typedef L Label;
+  typedef S StateId;
+  typedef P PrefixId;
+  typedef ReplaceStackPrefix<Label, StateId> StackPrefix;
+  typedef typename StackPrefix::PrefixTuple PrefixTuple;
+
+  ReplaceStackPrefixTable() { table_.FindId(Node()); }
+
+  ReplaceStackPrefixTable(const ReplaceStackPrefixTable& table)
+      : table_(table.table_) {}
+
+  PrefixId FindId(const StackPrefix& prefix) {
+    PrefixId id = 0;
+    for (const auto& top : prefix.prefix_) {
+      id = Push(id, top.fst_id, top.nextstate);
+    }
+    return id;
+  }
+
+  // Builds the prefix by walking up to the root; O(depth) per call.
+  StackPrefix FindEntry(PrefixId id) const {
+    StackPrefix prefix;
+    for (PrefixId i = id; i != 0; i = Pop(i)) {
+      prefix.prefix_.push_back(Top(i));
+    }
+    std::reverse(prefix.prefix_.begin(), prefix.prefix_.end());
+    return prefix;
+  }
+
+  PrefixId Push(PrefixId id, Label fst_id, StateId nextstate) {
+    return table_.FindId(Node(id, fst_id, nextstate));
+  }
+
+  PrefixId Pop(PrefixId id) const { return table_.FindEntry(id).parent; }
+
+  const PrefixTuple& Top(PrefixId id) const { return table_.FindEntry(id).top; }
+
+  PrefixId Size() const { return table_.Size(); }
+
+  // Approximate number of bytes used, not counting hash set overhead.
+  size_t MemoryUsage() const {
+    return table_.Size() * (sizeof(Node) + sizeof(PrefixId));
+  }
+
+ private:
+  struct Node {
+    Node() : parent(kNoLabel) {}
+    Node(PrefixId p, Label f, StateId s) : parent(p), top(f, s) {}
+
+    bool operator==(const Node& node) const {
+      return parent == node.parent && top.fst_id == node.top.fst_id &&
+             top.nextstate == node.top.nextstate;
+    }
+
+    PrefixId parent;
+    PrefixTuple top;
+  };
+
+  struct NodeHash {
+    size_t operator()(const Node& node) const {
+      return node.parent * kPrime0 + node.top.fst_id +
+             node.top.nextstate * kPrime1;
+    }
+  };
+
+  static const size_t kPrime0;
+  static const size_t kPrime1;
+
+  CompactHashBiTable<PrefixId, Node, NodeHash> table_;
+};
+
+template <class L, class S, class P>
+const size_t ReplaceStackPrefixTable<L, S, P>::kPrime0 = 7853;
+
+template <class L, class S, class P>
+const size_t ReplaceStackPrefixTable<L, S, P>::kPrime1 = 7867;
+
+namespace internal {
+
+// Stack prefix operations on a replace state table, using its
+// PushPrefixId(), PopPrefixId() and TopPrefix() when it defines them and
+// otherwise rebuilding the prefix with GetStackPrefix() and FindPrefixId().
+// Passing 0 for the last argument prefers the first overload.
+template <class T>
+auto PushReplacePrefix(T *table, typename T::PrefixId id,
+                       typename T::Label fst_id, typename T::StateId nextstate,
+                       int) -> decltype(table->PushPrefixId(id, fst_id,
+                                                            nextstate)) {
+  return table->PushPrefixId(id, fst_id, nextstate);
+}
+
+template <class T>
+typename T::PrefixId PushReplacePrefix(T *table, typename T::PrefixId id,
+                                       typename T::Label fst_id,
+                                       typename T::StateId nextstate, ...) {
+  typename T::StackPrefix prefix = table->GetStackPrefix(id);
+  prefix.Push(fst_id, nextstate);
+  return table->FindPrefixId(prefix);
+}
+
+template <class T>
+auto PopReplacePrefix(T *table, typename T::PrefixId id, int)
+    -> decltype(table->PopPrefixId(id)) {
+  return table->PopPrefixId(id);
+}
+
+template <class T>
+typename T::PrefixId PopReplacePrefix(T *table, typename T::PrefixId id,
+                                      ...) {
+  typename T::StackPrefix prefix = table->GetStackPrefix(id);
+  prefix.Pop();
+  return table->FindPrefixId(prefix);
+}
+
+template <class T>
+auto TopReplacePrefix(const T &table, typename T::PrefixId id, int)
+    -> decltype(table.TopPrefix(id)) {
+  return table.TopPrefix(id);
+}
+
+template <class T>
+typename T::StackPrefix::PrefixTuple TopReplacePrefix(const T &table,
+                                                      typename T::PrefixId id,
+                                                      ...) {
+  return table.GetStackPrefix(id).Top();
+}
+
+// Bytes cached by a cache store that defines CacheSize(), or 0.
+template <class C>
+auto ReplaceCacheSize(const C &store, int)
+    -> decltype(size_t(store.CacheSize())) {
+  return store.CacheSize();
+}
+
+template <class C>
+size_t ReplaceCacheSize(const C &store, ...) {
+  return 0;
+}
+
+// Logs the sizes of a replace state table that defines NumTuples(),
+// NumPrefixes() and MemoryUsage(), next to the bytes held by the cache.
+template <class T>
+auto LogReplaceStateTable(const T &table, size_t cache_size, int)
+    -> decltype(table.NumTuples(), table.NumPrefixes(), table.MemoryUsage(),
+                void()) {
+  VLOG(2) << "ReplaceFstImpl: state table has " << table.NumTuples()
+          << " state tuples and " << table.NumPrefixes()
+          << " stack prefixes using about " << table.MemoryUsage()
+          << " bytes; cache holds " << cache_size << " bytes";
+}
+
+template <class T>
+void LogReplaceStateTable(const T &table, size_t cache_size, ...) {}
+
+}  // namespace internal
+
 //
 // Replace State Tables
 //
@@ -244,9 +430,7 @@ class VectorHashReplaceStateTable {
                                ReplaceFstStateFingerprint<StateId, P>,
                                ReplaceFingerprint<StateId, P>> StateTable;
   typedef ReplaceStackPrefix<Label, StateId> StackPrefix;
-  typedef CompactHashBiTable<PrefixId, StackPrefix,
-                             ReplaceStackPrefixHash<Label, StateId>>
-      StackPrefixTable;
+  typedef ReplaceStackPrefixTable<Label, StateId, PrefixId> StackPrefixTable;
 
   VectorHashReplaceStateTable(
       const std::vector<std::pair<Label, const Fst<A>*>>& fst_tuples,
@@ -290,10 +474,31 @@ class VectorHashReplaceStateTable {
     return prefix_table_.FindId(prefix);
   }
 
-  const StackPrefix& GetStackPrefix(PrefixId id) const {
+  StackPrefix GetStackPrefix(PrefixId id) const {
     return prefix_table_.FindEntry(id);
   }
 
+  PrefixId PushPrefixId(PrefixId id, Label fst_id, StateId nextstate) {
+    return prefix_table_.Push(id, fst_id, nextstate);
+  }
+
+  PrefixId PopPrefixId(PrefixId id) const { return prefix_table_.Pop(id); }
+
+  const typename StackPrefix::PrefixTuple& TopPrefix(PrefixId id) const {
+    return prefix_table_.Top(id);
+  }
+
+  StateId NumTuples() const { return state_table_->Size(); }
+
+  PrefixId NumPrefixes() const { return prefix_table_.Size(); }
+
+  // Approximate number of bytes used, not counting hash set overhead.
+  size_t MemoryUsage() const {
+    return NumTuples() * (sizeof(StateTuple) + sizeof(StateId)) +
+           cumulative_size_array_.size() * sizeof(uint64) +
+           prefix_table_.MemoryUsage();
+  }
+
  private:
   StateId root_size_;
   std::vector<uint64> cumulative_size_array_;
@@ -316,9 +521,7 @@ class DefaultReplaceStateTable
   typedef CompactHashStateTable<StateTuple, ReplaceHash<StateId, PrefixId>>
       StateTable;
   typedef ReplaceStackPrefix<Label, StateId> StackPrefix;
-  typedef CompactHashBiTable<PrefixId, StackPrefix,
-                             ReplaceStackPrefixHash<Label, StateId>>
-      StackPrefixTable;
+  typedef ReplaceStackPrefixTable<Label, StateId, PrefixId> StackPrefixTable;
 
   using StateTable::FindState;
   using StateTable::Tuple;
@@ -334,10 +537,30 @@ class DefaultReplaceStateTable
     return prefix_table_.FindId(prefix);
   }
 
-  const StackPrefix& GetStackPrefix(PrefixId id) const {
+  StackPrefix GetStackPrefix(PrefixId id) const {
     return prefix_table_.FindEntry(id);
   }
 
+  PrefixId PushPrefixId(PrefixId id, Label fst_id, StateId nextstate) {
+    return prefix_table_.Push(id, fst_id, nextstate);
+  }
+
+  PrefixId PopPrefixId(PrefixId id) const { return prefix_table_.Pop(id); }
+
+  const typename StackPrefix::PrefixTuple& TopPrefix(PrefixId id) const {
+    return prefix_table_.Top(id);
+  }
+
+  StateId NumTuples() const { return StateTable::Size(); }
+
+  PrefixId NumPrefixes() const { return prefix_table_.Size(); }
+
+  // Approximate number of bytes used, not counting hash set overhead.
+  size_t MemoryUsage() const {
+    return NumTuples() * (sizeof(StateTuple) + sizeof(StateId)) +
+           prefix_table_.MemoryUsage();
+  }
+
  private:
   StackPrefixTable prefix_table_;
 };
@@ -607,7 +830,8 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
         }
       }
     }
-    Label nonterminal = nonterminal_hash_[opts.root];
+    InitNonTerminalIndex();
+    Label nonterminal = NonTerminalFstId(opts.root);
     if ((nonterminal == 0) && (fst_array_.size() > 1)) {
       FSTERROR() << "ReplaceFstImpl: No Fst corresponding to root label '"
                  << opts.root << "' in the input tuple vector";
@@ -637,6 +861,10 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
         state_table_(new StateTable(*(impl.state_table_))),
         nonterminal_set_(impl.nonterminal_set_),
         nonterminal_hash_(impl.nonterminal_hash_),
+        nonterminal_min_(impl.nonterminal_min_),
+        nonterminal_max_(impl.nonterminal_max_),
+        nonterminal_array_(impl.nonterminal_array_),
+        nonterminal_arc_flags_(impl.fst_array_.size()),
         root_(impl.root_) {
     SetType("replace");
     SetProperties(impl.Properties(), kCopyProperties);
@@ -649,6 +877,11 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
     }
   }
 
+  ~ReplaceFstImpl() override {
+    internal::LogReplaceStateTable(
+        *state_table_, internal::ReplaceCacheSize(*CImpl::GetCacheStore(), 0), 0);
+  }
+
   // Computes the dependency graph of the replace class and returns
   // true if the dependencies are cyclic. Cyclic dependencies will result
   // in an un-expandable replace fst.
@@ -717,17 +950,42 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
   }
 
   // Returns whether a given label is a non terminal
-  bool IsNonTerminal(Label l) const {
-    if (l < *nonterminal_set_.begin() || l > *nonterminal_set_.rbegin()) {
-      return false;
+  bool IsNonTerminal(Label l) const { return NonTerminalFstId(l) != 0; }
+
+  // Returns whether the given state of the component fst has an arc whose
+  // input (if match_input) or output label is a non terminal. Computed
+  // on first use for each state.
+  bool HasNonTerminalArcs(Label fst_id, StateId fst_state, bool match_input) {
+    std::vector<uint8>& flags = nonterminal_arc_flags_[fst_id];
+    if (static_cast<size_t>(fst_state) >= flags.size()) {
+      flags.resize(fst_state + 1, 0);
+    }
+    uint8& flag = flags[fst_state];
+    if (!(flag & kNonTerminalArcsKnown)) {
+      flag = kNonTerminalArcsKnown;
+      for (ArcIterator<Fst<A>> aiter(*fst_array_[fst_id], fst_state);
+           !aiter.Done(); aiter.Next()) {
+        const A& arc = aiter.Value();
+        if (arc.ilabel != 0 && IsNonTerminal(arc.ilabel)) {
+          flag |= kNonTerminalInputArcs;
+        }
+        if (arc.olabel != 0 && IsNonTerminal(arc.olabel)) {
+          flag |= kNonTerminalOutputArcs;
+        }
+      }
     }
-    // TODO(allauzen): be smarter and take advantage of
-    // all_dense or all_negative.
-    // Use also in ComputeArc, this would require changes to replace
-    // so that recursing into an empty fst lead to a non co-accessible
-    // state instead of deleting the arc as done currently.
-    // Current use correct, since i/olabel sorted iff all_non_empty.
-    return nonterminal_hash_.count(l);
+    return flag & (match_input ? kNonTerminalInputArcs
+                               : kNonTerminalOutputArcs);
+  }
+
+  // Returns the fst id of a non terminal, or 0 if the label is not one.
+  Label NonTerminalFstId(Label l) const {
+    if (l < nonterminal_min_ || l > nonterminal_max_) return 0;
+    if (!nonterminal_array_.empty()) {
+      return nonterminal_array_[l - nonterminal_min_];
+    }
+    typename NonTerminalHash::const_iterator it = nonterminal_hash_.find(l);
+    return it == nonterminal_hash_.end() ? 0 : it->second;
   }
 
   size_t NumInputEpsilons(StateId s) {
@@ -889,10 +1147,10 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
         arcp->olabel =
             (EpsilonOnOutput(return_label_type_)) ? 0 : return_label_;
         if (flags & kArcNextStateValue) {
-          const StackPrefix& stack =
-              state_table_->GetStackPrefix(tuple.prefix_id);
-          PrefixId prefix_id = PopPrefix(stack);
-          const typename StackPrefix::PrefixTuple& top = stack.Top();
+          const typename StackPrefix::PrefixTuple top =
+              internal::TopReplacePrefix(*state_table_, tuple.prefix_id, 0);
+          PrefixId prefix_id = internal::PopReplacePrefix(
+              state_table_.get(), tuple.prefix_id, 0);
           arcp->nextstate = state_table_->FindState(
               StateTuple(prefix_id, top.fst_id, top.nextstate));
         }
@@ -917,50 +1175,35 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
       return true;
     }
 
-    if (arc.olabel == 0 || arc.olabel < *nonterminal_set_.begin() ||
-        arc.olabel > *nonterminal_set_.rbegin()) {  // expand local fst
+    // Terminal labels, including those outside the non-terminal label
+    // range, are rejected before any table lookup.
+    const Label nonterminal =
+        arc.olabel == 0 ? 0 : NonTerminalFstId(arc.olabel);
+    if (nonterminal == 0) {  // expand local fst
       StateId nextstate =
           flags & kArcNextStateValue
               ? state_table_->FindState(
                     StateTuple(tuple.prefix_id, tuple.fst_id, arc.nextstate))
               : kNoStateId;
       *arcp = A(arc.ilabel, arc.olabel, arc.weight, nextstate);
-    } else {
-      // check for non terminal
-      typename NonTerminalHash::const_iterator it =
-          nonterminal_hash_.find(arc.olabel);
-      if (it != nonterminal_hash_.end()) {  // recurse into non terminal
-        Label nonterminal = it->second;
-        PrefixId nt_prefix =
-            PushPrefix(state_table_->GetStackPrefix(tuple.prefix_id),
-                       tuple.fst_id, arc.nextstate);
-
-        // if start state is valid replace, else arc is implicitly
-        // deleted
-        StateId nt_start = fst_array_[nonterminal]->Start();
-        if (nt_start != kNoStateId) {
-          StateId nt_nextstate = flags & kArcNextStateValue
-                                     ? state_table_->FindState(StateTuple(
-                                           nt_prefix, nonterminal, nt_start))
-                                     : kNoStateId;
-          Label ilabel = (EpsilonOnInput(call_label_type_)) ? 0 : arc.ilabel;
-          Label olabel =
-              (EpsilonOnOutput(call_label_type_))
-                  ? 0
-                  : ((call_output_label_ == kNoLabel) ? arc.olabel
-                                                      : call_output_label_);
-          *arcp = A(ilabel, olabel, arc.weight, nt_nextstate);
-        } else {
-          return false;
-        }
-      } else {
-        StateId nextstate =
-            flags & kArcNextStateValue
-                ? state_table_->FindState(
-                      StateTuple(tuple.prefix_id, tuple.fst_id, arc.nextstate))
-                : kNoStateId;
-        *arcp = A(arc.ilabel, arc.olabel, arc.weight, nextstate);
-      }
+    } else {  // recurse into non terminal
+      // if start state is valid replace, else arc is implicitly
+      // deleted
+      StateId nt_start = fst_array_[nonterminal]->Start();
+      if (nt_start == kNoStateId) return false;
+      PrefixId nt_prefix = internal::PushReplacePrefix(
+          state_table_.get(), tuple.prefix_id, tuple.fst_id, arc.nextstate, 0);
+      StateId nt_nextstate = flags & kArcNextStateValue
+                                 ? state_table_->FindState(StateTuple(
+                                       nt_prefix, nonterminal, nt_start))
+                                 : kNoStateId;
+      Label ilabel = (EpsilonOnInput(call_label_type_)) ? 0 : arc.ilabel;
+      Label olabel =
+          (EpsilonOnOutput(call_label_type_))
+              ? 0
+              : ((call_output_label_ == kNoLabel) ? arc.olabel
+                                                  : call_output_label_);
+      *arcp = A(ilabel, olabel, arc.weight, nt_nextstate);
     }
     return true;
   }
@@ -977,13 +1220,12 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
   const Fst<A>* GetFst(Label fst_id) const { return fst_array_[fst_id].get(); }
 
   Label GetFstId(Label nonterminal) const {
-    typename NonTerminalHash::const_iterator it =
-        nonterminal_hash_.find(nonterminal);
-    if (it == nonterminal_hash_.end()) {
+    Label fst_id = NonTerminalFstId(nonterminal);
+    if (fst_id == 0) {
       FSTERROR() << "ReplaceFstImpl::GetFstId: Nonterminal not found: "
                  << nonterminal;
     }
-    return it->second;
+    return fst_id;
   }
 
   // returns true if label type on call arc results in epsilon input label
@@ -991,23 +1233,45 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
 
   // private methods
  private:
+  // Non-terminal label ranges up to this many times the number of
+  // non-terminals (plus a constant) are indexed by a dense array.
+  static const size_t kDenseNonTerminalFactor = 4;
+  static const size_t kDenseNonTerminalSlack = 1024;
+
+  // Bits of nonterminal_arc_flags_.
+  static const uint8 kNonTerminalArcsKnown = 0x01;
+  static const uint8 kNonTerminalInputArcs = 0x02;
+  static const uint8 kNonTerminalOutputArcs = 0x04;
+
+  // Sets the non-terminal label range and, when the labels are dense
+  // enough, a label to fst id array that replaces hash lookups.
+  void InitNonTerminalIndex() {
+    nonterminal_arc_flags_.assign(fst_array_.size(), std::vector<uint8>());
+    nonterminal_array_.clear();
+    if (nonterminal_set_.empty()) {
+      nonterminal_min_ = 1;
+      nonterminal_max_ = 0;
+      return;
+    }
+    nonterminal_min_ = *nonterminal_set_.begin();
+    nonterminal_max_ = *nonterminal_set_.rbegin();
+    const uint64 range = static_cast<uint64>(nonterminal_max_) -
+                         static_cast<uint64>(nonterminal_min_) + 1;
+    if (range > kDenseNonTerminalFactor * nonterminal_set_.size() +
+                    kDenseNonTerminalSlack) {
+      return;
+    }
+    nonterminal_array_.resize(range, 0);
+    for (const auto& kv : nonterminal_hash_) {
+      nonterminal_array_[kv.first - nonterminal_min_] = kv.second;
+    }
+  }
+
   // hash stack prefix (return unique index into stackprefix table)
   PrefixId GetPrefixId(const StackPrefix& prefix) {
     return state_table_->FindPrefixId(prefix);
   }
 
-  // prefix id after a stack pop
-  PrefixId PopPrefix(StackPrefix prefix) {
-    prefix.Pop();
-    return GetPrefixId(prefix);
-  }
-
-  // prefix id after a stack push
-  PrefixId PushPrefix(StackPrefix prefix, Label fst_id, StateId nextstate) {
-    prefix.Push(fst_id, nextstate);
-    return GetPrefixId(prefix);
-  }
-
   // private data
  private:
   // runtime options
@@ -1023,6 +1287,11 @@ class ReplaceFstImpl : public CacheBaseImpl<typename C::State, C> {
   // replace components
   std::set<Label> nonterminal_set_;
   NonTerminalHash nonterminal_hash_;
+  Label nonterminal_min_;  // Non-terminal label range.
+  Label nonterminal_max_;
+  std::vector<Label> nonterminal_array_;  // Dense index, if non-empty.
+  // Per component fst state, see HasNonTerminalArcs().
+  std::vector<std::vector<uint8>> nonterminal_arc_flags_;
   std::vector<std::unique_ptr<const Fst<A>>> fst_array_;
   Label root_;
 };
@@ -1360,7 +1629,8 @@ class ReplaceFstMatcher : public MatcherBase<A> {
   typedef A Arc;
   typedef typename A::StateId StateId;
   typedef typename A::Label Label;
-  typedef MultiEpsMatcher<Matcher<Fst<A>> > LocalMatcher;
+  typedef Matcher<Fst<A>> BaseMatcher;
+  typedef MultiEpsMatcher<BaseMatcher> LocalMatcher;
 
   ReplaceFstMatcher(const ReplaceFst<A, T, C>& fst,
                     fst::MatchType match_type)
@@ -1370,6 +1640,7 @@ class ReplaceFstMatcher : public MatcherBase<A> {
         match_type_(match_type),
         current_loop_(false),
         final_arc_(false),
+        eps_only_(false),
         loop_(fst::kNoLabel, 0, A::Weight::One(), fst::kNoStateId) {
     if (match_type_ == fst::MATCH_OUTPUT) {
       std::swap(loop_.ilabel, loop_.olabel);
@@ -1385,6 +1656,7 @@ class ReplaceFstMatcher : public MatcherBase<A> {
         match_type_(matcher.match_type_),
         current_loop_(false),
         final_arc_(false),
+        eps_only_(false),
         loop_(fst::kNoLabel, 0, A::Weight::One(), fst::kNoStateId) {
     if (match_type_ == fst::MATCH_OUTPUT) {
       std::swap(loop_.ilabel, loop_.olabel);
@@ -1395,15 +1667,20 @@ class ReplaceFstMatcher : public MatcherBase<A> {
   // Create a local matcher for each component Fst of replace.
   // LocalMatcher is a multi epsilon wrapper matcher. MultiEpsilonMatcher
   // is used to match each non-terminal arc, since these non-terminal
-  // turn into epsilons on recursion.
+  // turn into epsilons on recursion. The wrapped matcher is kept to
+  // match epsilons directly at states without non-terminal arcs, which
+  // avoids probing every non-terminal label there.
   void InitMatchers() {
     const std::vector<std::unique_ptr<const Fst<A>>>& fst_array =
         impl_->fst_array_;
+    base_matcher_.resize(fst_array.size());
     matcher_.resize(fst_array.size());
     for (size_t i = 0; i < fst_array.size(); ++i) {
       if (fst_array[i]) {
-        matcher_[i].reset(
-            new LocalMatcher(*fst_array[i], match_type_, kMultiEpsList));
+        base_matcher_[i].reset(new BaseMatcher(*fst_array[i], match_type_));
+        matcher_[i].reset(new LocalMatcher(*fst_array[i], match_type_,
+                                           kMultiEpsList,
+                                           base_matcher_[i].get(), false));
 
         auto it = impl_->nonterminal_set_.begin();
         for (; it != impl_->nonterminal_set_.end(); ++it) {
@@ -1452,6 +1729,7 @@ class ReplaceFstMatcher : public MatcherBase<A> {
     }
     // Get current matcher. Used for non epsilon matching
     current_matcher_ = matcher_[tuple_.fst_id].get();
+    current_base_matcher_ = base_matcher_[tuple_.fst_id].get();
     current_matcher_->SetState(tuple_.fst_state);
     loop_.nextstate = s_;
 
@@ -1477,16 +1755,23 @@ class ReplaceFstMatcher : public MatcherBase<A> {
       }
       // Search for matching multi epsilons
       final_arc_ = impl_->ComputeFinalArc(tuple_, nullptr);
-      found = current_matcher_->Find(kNoLabel) || final_arc_ || found;
+      eps_only_ = !impl_->HasNonTerminalArcs(
+          tuple_.fst_id, tuple_.fst_state, match_type_ == MATCH_INPUT);
+      found = (eps_only_ ? current_base_matcher_->Find(kNoLabel)
+                         : current_matcher_->Find(kNoLabel)) ||
+              final_arc_ || found;
     } else {
       // Search on sub machine directly using sub machine matcher.
+      eps_only_ = false;
       found = current_matcher_->Find(label_);
     }
     return found;
   }
 
   bool Done_() const override {
-    return !current_loop_ && !final_arc_ && current_matcher_->Done();
+    return !current_loop_ && !final_arc_ &&
+           (eps_only_ ? current_base_matcher_->Done()
+                      : current_matcher_->Done());
   }
 
   const Arc& Value_() const override {
@@ -1497,7 +1782,8 @@ class ReplaceFstMatcher : public MatcherBase<A> {
       impl_->ComputeFinalArc(tuple_, &arc_);
       return arc_;
     }
-    const Arc& component_arc = current_matcher_->Value();
+    const Arc& component_arc = eps_only_ ? current_base_matcher_->Value()
+                                         : current_matcher_->Value();
     impl_->ComputeArc(tuple_, component_arc, &arc_);
     return arc_;
   }
@@ -1511,7 +1797,11 @@ class ReplaceFstMatcher : public MatcherBase<A> {
       final_arc_ = false;
       return;
     }
-    current_matcher_->Next();
+    if (eps_only_) {
+      current_base_matcher_->Next();
+    } else {
+      current_matcher_->Next();
+    }
   }
 
   ssize_t Priority_(StateId s) override { return fst_.NumArcs(s); }
@@ -1519,6 +1809,10 @@ class ReplaceFstMatcher : public MatcherBase<A> {
   const ReplaceFst<A, T, C>& fst_;
   ReplaceFstImpl<A, T, C>* impl_;
   LocalMatcher* current_matcher_;
+  BaseMatcher* current_base_matcher_;
+  // Declared first so the local matchers wrapping them are destroyed
+  // first.
+  std::vector<std::unique_ptr<BaseMatcher>> base_matcher_;
   std::vector<std::unique_ptr<LocalMatcher>> matcher_;
 
   StateId s_;    // Current state
@@ -1528,6 +1822,7 @@ class ReplaceFstMatcher : public MatcherBase<A> {
   mutable bool done_;
   mutable bool current_loop_;             // Current arc is the implicit loop
   mutable bool final_arc_;                // Current arc for exiting recursion
+  bool eps_only_;  // Matching epsilons at a state without non-terminal arcs
   mutable typename T::StateTuple tuple_;  // Tuple corresponding to state_
   mutable Arc arc_;
   Arc loop_;
@@ -333,11 +333,38 @@ void RmEpsilon(MutableFst<Arc> *fst, bool connect = true,
   typedef typename Arc::Label Label;
 
   std::vector<Weight> distance;
-  AutoQueue<StateId> state_queue(*fst, &distance, EpsilonArcFilter<Arc>());
-  RmEpsilonOptions<Arc, AutoQueue<StateId>> opts(
-      &state_queue, delta, connect, weight_threshold, state_threshold);
-
-  RmEpsilon(fst, &distance, opts);
+  // The disciplines AutoQueue selects from the FST properties alone are used
+  // as their concrete types, so the closure loop makes no virtual queue calls.
+  switch (AutoQueue<StateId>::PropertyQueueType(*fst)) {
+    case STATE_ORDER_QUEUE: {
+      StateOrderQueue<StateId> state_queue;
+      RmEpsilonOptions<Arc, StateOrderQueue<StateId>> opts(
+          &state_queue, delta, connect, weight_threshold, state_threshold);
+      RmEpsilon(fst, &distance, opts);
+      break;
+    }
+    case TOP_ORDER_QUEUE: {
+      TopOrderQueue<StateId> state_queue(*fst, EpsilonArcFilter<Arc>());
+      RmEpsilonOptions<Arc, TopOrderQueue<StateId>> opts(
+          &state_queue, delta, connect, weight_threshold, state_threshold);
+      RmEpsilon(fst, &distance, opts);
+      break;
+    }
+    case LIFO_QUEUE: {
+      LifoQueue<StateId> state_queue;
+      RmEpsilonOptions<Arc, LifoQueue<StateId>> opts(
+          &state_queue, delta, connect, weight_threshold, state_threshold);
+      RmEpsilon(fst, &distance, opts);
+      break;
+    }
+    default: {
+      AutoQueue<StateId> state_queue(*fst, &distance, EpsilonArcFilter<Arc>());
+      RmEpsilonOptions<Arc, AutoQueue<StateId>> opts(
+          &state_queue, delta, connect, weight_threshold, state_threshold);
+      RmEpsilon(fst, &distance, opts);
+      break;
+    }
+  }
 }
 
 struct RmEpsilonFstOptions : CacheOptions {
@@ -8,8 +8,10 @@
 #include <limits>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include <fst/expanded-fst.h>
+#include <fst/float-weight.h>
 #include <fst/fst.h>
 #include <fst/mutable-fst.h>
 #include <fst/vector-fst.h>
@@ -36,6 +38,9 @@ class FstClassBase {
   virtual const string &ArcType() const = 0;
   virtual WeightClass Final(int64) const = 0;
   virtual const string &FstType() const = 0;
+  virtual bool GetArcs(std::vector<int64> *, std::vector<int64> *,
+                       std::vector<int64> *, std::vector<double> *,
+                       std::vector<int64> *) const = 0;
   virtual const SymbolTable *InputSymbols() const = 0;
   virtual size_t NumArcs(int64) const = 0;
   virtual size_t NumInputEpsilons(int64) const = 0;
@@ -56,7 +61,11 @@ class FstClassBase {
 class FstClassImplBase : public FstClassBase {
  public:
   virtual bool AddArc(int64, const ArcClass &) = 0;
+  virtual bool AddArcs(const std::vector<int64> &, const std::vector<int64> &,
+                       const std::vector<int64> &, const std::vector<double> &,
+                       const std::vector<int64> &) = 0;
   virtual int64 AddState() = 0;
+  virtual int64 AddStates(size_t) = 0;
   virtual FstClassImplBase *Copy() = 0;
   virtual bool DeleteArcs(int64, size_t) = 0;
   virtual bool DeleteArcs(int64) = 0;
@@ -75,6 +84,33 @@ class FstClassImplBase : public FstClassBase {
   ~FstClassImplBase() override {}
 };
 
+namespace internal {
+
+// Converts between the weights of an arc type and doubles, as used by the
+// bulk arc methods below. Only weights holding a single real value (see
+// IsFloatWeight) can be converted; they are converted at their own precision.
+template <class W>
+W WeightFromDouble(double d, std::true_type) {
+  return W(static_cast<typename W::ValueType>(d));
+}
+
+template <class W>
+W WeightFromDouble(double, std::false_type) {
+  return W::NoWeight();
+}
+
+template <class W>
+double WeightToDouble(const W &w, std::true_type) {
+  return w.Value();
+}
+
+template <class W>
+double WeightToDouble(const W &, std::false_type) {
+  return 0.0;
+}
+
+}  // namespace internal
+
 // Containiner class wrapping an Fst<Arc>, hiding its arc type. Whether this
 // Fst<Arc> pointer refers to a special kind of FST (e.g. a MutableFst) is
 // known by the type of interface class that owns the pointer to this
@@ -100,11 +136,78 @@ class FstClassImpl : public FstClassImplBase {
     return true;
   }
 
+  // Adds the arcs given as parallel arrays of source states, labels, weights
+  // and destination states, as with repeated calls to AddArc. An empty weight
+  // array means all weights are One. Arcs are reserved per state before any
+  // are added, and no arc is added unless all source and destination states
+  // are valid. Unlike AddArc, destination states must already exist.
+  //
+  // Warning: calling this method casts the FST to a mutable FST.
+  bool AddArcs(const std::vector<int64> &states,
+               const std::vector<int64> &ilabels,
+               const std::vector<int64> &olabels,
+               const std::vector<double> &weights,
+               const std::vector<int64> &nextstates) override {
+    typedef typename Arc::Weight Weight;
+    typedef fst::internal::IsFloatWeight<Weight> IsFloat;
+    const size_t narcs = states.size();
+    if (ilabels.size() != narcs || olabels.size() != narcs ||
+        nextstates.size() != narcs ||
+        (!weights.empty() && weights.size() != narcs)) {
+      FSTERROR() << "AddArcs: Arrays of unequal length";
+      return false;
+    }
+    if (!weights.empty() && !IsFloat::value) {
+      FSTERROR() << "AddArcs: Can't convert reals to weight type "
+                 << Weight::Type();
+      return false;
+    }
+    auto *fst = static_cast<MutableFst<Arc> *>(impl_.get());
+    const int64 nstates = fst->NumStates();
+    std::vector<size_t> counts(nstates, 0);
+    for (const auto s : states) {
+      if (s < 0 || s >= nstates) {
+        FSTERROR() << "State ID " << s << " not valid.";
+        return false;
+      }
+      ++counts[s];
+    }
+    for (const auto nextstate : nextstates) {
+      if (nextstate < 0 || nextstate >= nstates) {
+        FSTERROR() << "State ID " << nextstate << " not valid.";
+        return false;
+      }
+    }
+    for (int64 s = 0; s < nstates; ++s) {
+      if (counts[s]) fst->ReserveArcs(s, fst->NumArcs(s) + counts[s]);
+    }
+    for (size_t i = 0; i < narcs; ++i) {
+      fst->AddArc(states[i],
+                  Arc(ilabels[i], olabels[i],
+                      weights.empty() ? Weight::One()
+                                      : internal::WeightFromDouble<Weight>(
+                                            weights[i], IsFloat()),
+                      nextstates[i]));
+    }
+    return true;
+  }
+
   // Warning: calling this method casts the FST to a mutable FST.
   int64 AddState() override {
     return static_cast<MutableFst<Arc> *>(impl_.get())->AddState();
   }
 
+  // Adds n states and returns the ID of the first one.
+  //
+  // Warning: calling this method casts the FST to a mutable FST.
+  int64 AddStates(size_t n) override {
+    auto *fst = static_cast<MutableFst<Arc> *>(impl_.get());
+    const int64 first = fst->NumStates();
+    fst->ReserveStates(first + n);
+    for (size_t i = 0; i < n; ++i) fst->AddState();
+    return first;
+  }
+
   const string &ArcType() const override { return Arc::Type(); }
 
   FstClassImpl *Copy() override { return new FstClassImpl<Arc>(impl_.get()); }
@@ -148,6 +251,51 @@ class FstClassImpl : public FstClassImplBase {
 
   const string &FstType() const override { return impl_->Type(); }
 
+  // Exports all arcs, in state order, as parallel arrays in the format taken
+  // by AddArcs. Requires an expanded FST whose weights are convertible to
+  // floats.
+  bool GetArcs(std::vector<int64> *states, std::vector<int64> *ilabels,
+               std::vector<int64> *olabels, std::vector<double> *weights,
+               std::vector<int64> *nextstates) const override {
+    typedef typename Arc::Weight Weight;
+    typedef fst::internal::IsFloatWeight<Weight> IsFloat;
+    if (!IsFloat::value) {
+      FSTERROR() << "GetArcs: Can't convert weight type " << Weight::Type()
+                 << " to reals";
+      return false;
+    }
+    if (!Properties(kExpanded, true)) {
+      FSTERROR() << "GetArcs: Cannot get arcs of unexpanded FST";
+      return false;
+    }
+    const auto &fst = static_cast<const ExpandedFst<Arc> &>(*impl_);
+    const int64 nstates = fst.NumStates();
+    size_t narcs = 0;
+    for (int64 s = 0; s < nstates; ++s) narcs += fst.NumArcs(s);
+    states->clear();
+    ilabels->clear();
+    olabels->clear();
+    weights->clear();
+    nextstates->clear();
+    states->reserve(narcs);
+    ilabels->reserve(narcs);
+    olabels->reserve(narcs);
+    weights->reserve(narcs);
+    nextstates->reserve(narcs);
+    for (int64 s = 0; s < nstates; ++s) {
+      for (ArcIterator<ExpandedFst<Arc>> aiter(fst, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        states->push_back(s);
+        ilabels->push_back(arc.ilabel);
+        olabels->push_back(arc.olabel);
+        weights->push_back(internal::WeightToDouble(arc.weight, IsFloat()));
+        nextstates->push_back(arc.nextstate);
+      }
+    }
+    return true;
+  }
+
   const SymbolTable *InputSymbols() const override {
     return impl_->InputSymbols();
   }
@@ -292,6 +440,12 @@ class FstClass : public FstClassBase {
 
   const string &FstType() const override { return impl_->FstType(); }
 
+  bool GetArcs(std::vector<int64> *states, std::vector<int64> *ilabels,
+               std::vector<int64> *olabels, std::vector<double> *weights,
+               std::vector<int64> *nextstates) const override {
+    return impl_->GetArcs(states, ilabels, olabels, weights, nextstates);
+  }
+
   const SymbolTable *InputSymbols() const override {
     return impl_->InputSymbols();
   }
@@ -409,8 +563,18 @@ class MutableFstClass : public FstClass {
     return GetImpl()->AddArc(s, a);
   }
 
+  bool AddArcs(const std::vector<int64> &states,
+               const std::vector<int64> &ilabels,
+               const std::vector<int64> &olabels,
+               const std::vector<double> &weights,
+               const std::vector<int64> &nextstates) {
+    return GetImpl()->AddArcs(states, ilabels, olabels, weights, nextstates);
+  }
+
   int64 AddState() { return GetImpl()->AddState(); }
 
+  int64 AddStates(size_t n) { return GetImpl()->AddStates(n); }
+
   bool DeleteArcs(int64 s, size_t n) { return GetImpl()->DeleteArcs(s, n); }
 
   bool DeleteArcs(int64 s) { return GetImpl()->DeleteArcs(s); }
@@ -64,6 +64,7 @@
 #include <fst/script/rmepsilon.h>
 #include <fst/script/shortest-distance.h>
 #include <fst/script/shortest-path.h>
+#include <fst/script/state-reorder.h>
 #include <fst/script/synchronize.h>
 #include <fst/script/topsort.h>
 #include <fst/script/union.h>
@@ -86,6 +87,7 @@ class AllFstOperationsRegisterer {
 
  private:
   void RegisterBatch1() {
+    REGISTER_FST_OPERATION(ArcPageLocality, Arc, ArcPageLocalityArgs);
     REGISTER_FST_OPERATION(ArcSort, Arc, ArcSortArgs);
     REGISTER_FST_OPERATION(Closure, Arc, ClosureArgs);
     REGISTER_FST_OPERATION(CompileFstInternal, Arc, CompileFstArgs);
@@ -151,6 +153,7 @@ class AllFstOperationsRegisterer {
     REGISTER_FST_OPERATION(ShortestDistance, Arc, ShortestDistanceArgs3);
     REGISTER_FST_OPERATION(ShortestPath, Arc, ShortestPathArgs1);
     REGISTER_FST_OPERATION(ShortestPath, Arc, ShortestPathArgs2);
+    REGISTER_FST_OPERATION(StateReorder, Arc, StateReorderArgs);
     REGISTER_FST_OPERATION(Synchronize, Arc, SynchronizeArgs);
     REGISTER_FST_OPERATION(TopSort, Arc, TopSortArgs);
     REGISTER_FST_OPERATION(Union, Arc, UnionArgs);
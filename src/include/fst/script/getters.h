@@ -17,6 +17,7 @@
 #include <fst/push.h>             // For kPushWeights (etc.).
 #include <fst/queue.h>            // For QueueType.
 #include <fst/rational.h>         // For ClosureType.
+#include <fst/state-reorder.h>    // For StateReorderType.
 #include <fst/script/arcsort.h>       // For ArcSortType.
 #include <fst/script/map.h>           // For MapType.
 #include <fst/script/script-impl.h>   // For RandArcSelection.
@@ -70,6 +71,8 @@ inline ReweightType GetReweightType(bool to_final) {
   return to_final ? REWEIGHT_TO_FINAL : REWEIGHT_TO_INITIAL;
 }
 
+bool GetStateReorderType(const string &str, StateReorderType *reorder_type);
+
 }  // namespace script
 }  // namespace fst
 
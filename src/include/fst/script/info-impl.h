@@ -7,7 +7,7 @@
 #ifndef FST_SCRIPT_INFO_IMPL_H_
 #define FST_SCRIPT_INFO_IMPL_H_
 
-#include <map>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -36,7 +36,10 @@ class FstInfo {
   typedef typename A::Weight Weight;
 
   // When info_type is "short" (or "auto" and not an ExpandedFst)
-  // then only minimal info is computed and can be requested.
+  // then only minimal info is computed and can be requested. When
+  // info_type is "fast", the per-state and per-arc counts are gathered in
+  // a single pass over the states; verification, property testing and the
+  // (strongly) connected component analysis are skipped.
   FstInfo(const Fst<A>& fst, bool test_properties,
           const string& arc_filter_type = "any", string info_type = "auto",
           bool verify = true)
@@ -65,11 +68,14 @@ class FstInfo {
         output_lookahead_(false),
         properties_(0),
         arc_filter_type_(arc_filter_type),
-        long_info_(true) {
+        long_info_(true),
+        fast_info_(false) {
     if (info_type == "long") {
       long_info_ = true;
     } else if (info_type == "short") {
       long_info_ = false;
+    } else if (info_type == "fast") {
+      fast_info_ = true;
     } else if (info_type == "auto") {
       long_info_ = fst.Properties(kExpanded, false);
     } else {
@@ -79,6 +85,11 @@ class FstInfo {
 
     if (!long_info_) return;
 
+    if (fast_info_) {
+      verify = false;
+      test_properties = false;
+    }
+
     // If the FST is not sane, we return.
     if (verify && !Verify(fst)) {
       FSTERROR() << "FstInfo: Verify: FST not well-formed.";
@@ -88,35 +99,9 @@ class FstInfo {
     start_ = fst.Start();
     properties_ = fst.Properties(kFstProperties, test_properties);
 
-    for (StateIterator<Fst<A>> siter(fst); !siter.Done(); siter.Next()) {
-      ++nstates_;
-      StateId s = siter.Value();
-      if (fst.Final(s) != Weight::Zero()) ++nfinal_;
-      std::map<Label, size_t> ilabel_count;
-      std::map<Label, size_t> olabel_count;
-      for (ArcIterator<Fst<A>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
-        const A& arc = aiter.Value();
-        ++narcs_;
-        if (arc.ilabel == 0 && arc.olabel == 0) ++nepsilons_;
-        if (arc.ilabel == 0) ++niepsilons_;
-        if (arc.olabel == 0) ++noepsilons_;
-        ++ilabel_count[arc.ilabel];
-        ++olabel_count[arc.olabel];
-      }
-      for (auto it = ilabel_count.begin(); it != ilabel_count.end(); ++it) {
-        ilabel_mult_ += it->second * it->second;
-      }
-      for (auto it = olabel_count.begin(); it != olabel_count.end(); ++it) {
-        olabel_mult_ += it->second * it->second;
-      }
-    }
-
-    if (narcs_ > 0) {
-      ilabel_mult_ /= narcs_;
-      olabel_mult_ /= narcs_;
-    }
+    CountStatesAndArcs(fst);
 
-    {
+    if (!fast_info_) {
       std::vector<StateId> cc;
       CcVisitor<Arc> cc_visitor(&cc);
       FifoQueue<StateId> fifo_queue;
@@ -138,7 +123,7 @@ class FstInfo {
       }
     }
 
-    {
+    if (!fast_info_) {
       std::vector<StateId> scc;
       std::vector<bool> access, coaccess;
       uint64 props = 0;
@@ -179,6 +164,7 @@ class FstInfo {
   const string& InputSymbols() const { return input_symbols_; }
   const string& OutputSymbols() const { return output_symbols_; }
   bool LongInfo() const { return long_info_; }
+  bool FastInfo() const { return fast_info_; }
   const string& ArcFilterType() const { return arc_filter_type_; }
 
   // Long info
@@ -237,22 +223,27 @@ class FstInfo {
 
   size_t NumAccessible() const {
     CheckLong();
+    CheckNotFast();
     return naccess_;
   }
   size_t NumCoAccessible() const {
     CheckLong();
+    CheckNotFast();
     return ncoaccess_;
   }
   size_t NumConnected() const {
     CheckLong();
+    CheckNotFast();
     return nconnect_;
   }
   size_t NumCc() const {
     CheckLong();
+    CheckNotFast();
     return ncc_;
   }
   size_t NumScc() const {
     CheckLong();
+    CheckNotFast();
     return nscc_;
   }
   uint64 Properties() const {
@@ -261,11 +252,62 @@ class FstInfo {
   }
 
  private:
+  // Gathers the state, arc, epsilon and label multiplicity counts in one
+  // pass. The labels leaving each state are collected into reused buffers
+  // and sorted, so the multiplicities come from run lengths rather than a
+  // per-state map.
+  void CountStatesAndArcs(const Fst<A>& fst) {
+    std::vector<Label> ilabels;
+    std::vector<Label> olabels;
+    for (StateIterator<Fst<A>> siter(fst); !siter.Done(); siter.Next()) {
+      ++nstates_;
+      StateId s = siter.Value();
+      if (fst.Final(s) != Weight::Zero()) ++nfinal_;
+      ilabels.clear();
+      olabels.clear();
+      for (ArcIterator<Fst<A>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const A& arc = aiter.Value();
+        ++narcs_;
+        if (arc.ilabel == 0 && arc.olabel == 0) ++nepsilons_;
+        if (arc.ilabel == 0) ++niepsilons_;
+        if (arc.olabel == 0) ++noepsilons_;
+        ilabels.push_back(arc.ilabel);
+        olabels.push_back(arc.olabel);
+      }
+      ilabel_mult_ += SumSquaredMultiplicity(&ilabels);
+      olabel_mult_ += SumSquaredMultiplicity(&olabels);
+    }
+    if (narcs_ > 0) {
+      ilabel_mult_ /= narcs_;
+      olabel_mult_ /= narcs_;
+    }
+  }
+
+  // Returns the sum over distinct labels of the squared label counts.
+  static size_t SumSquaredMultiplicity(std::vector<Label>* labels) {
+    if (!std::is_sorted(labels->begin(), labels->end()))
+      std::sort(labels->begin(), labels->end());
+    size_t sum = 0;
+    for (size_t i = 0; i < labels->size();) {
+      size_t j = i + 1;
+      while (j < labels->size() && (*labels)[j] == (*labels)[i]) ++j;
+      sum += (j - i) * (j - i);
+      i = j;
+    }
+    return sum;
+  }
+
   void CheckLong() const {
     if (!long_info_)
       FSTERROR() << "FstInfo: Method only available with long info signature";
   }
 
+  // The connectivity counts are not computed by the "fast" info type.
+  void CheckNotFast() const {
+    if (fast_info_)
+      FSTERROR() << "FstInfo: Method not available with fast info type";
+  }
+
   string fst_type_;
   string input_symbols_;
   string output_symbols_;
@@ -290,8 +332,38 @@ class FstInfo {
   uint64 properties_;
   string arc_filter_type_;
   bool long_info_;
+  bool fast_info_;
 };
 
+// Prints the (co)accessibility and (strongly) connected component counts,
+// which are not computed by the "fast" info type.
+template <class A>
+void PrintConnectivityInfo(const FstInfo<A>& fstinfo, ostream& os) {
+  string arc_type = "";
+  if (fstinfo.ArcFilterType() == "epsilon")
+    arc_type = "epsilon ";
+  else if (fstinfo.ArcFilterType() == "iepsilon")
+    arc_type = "input-epsilon ";
+  else if (fstinfo.ArcFilterType() == "oepsilon")
+    arc_type = "output-epsilon ";
+
+  string accessible_label = "# of " + arc_type + "accessible states";
+  os.width(50);
+  os << accessible_label << fstinfo.NumAccessible() << std::endl;
+  string coaccessible_label = "# of " + arc_type + "coaccessible states";
+  os.width(50);
+  os << coaccessible_label << fstinfo.NumCoAccessible() << std::endl;
+  string connected_label = "# of " + arc_type + "connected states";
+  os.width(50);
+  os << connected_label << fstinfo.NumConnected() << std::endl;
+  string numcc_label = "# of " + arc_type + "connected components";
+  os.width(50);
+  os << numcc_label << fstinfo.NumCc() << std::endl;
+  string numscc_label = "# of " + arc_type + "strongly conn components";
+  os.width(50);
+  os << numscc_label << fstinfo.NumScc() << std::endl;
+}
+
 template <class A>
 void PrintFstInfo(const FstInfo<A>& fstinfo, bool pipe = false) {
   ostream& os = pipe ? std::cerr : std::cout;
@@ -331,31 +403,8 @@ void PrintFstInfo(const FstInfo<A>& fstinfo, bool pipe = false) {
   os.width(50);
   os << "output label multiplicity" << fstinfo.OutputLabelMultiplicity()
      << std::endl;
-  os.width(50);
 
-  string arc_type = "";
-  if (fstinfo.ArcFilterType() == "epsilon")
-    arc_type = "epsilon ";
-  else if (fstinfo.ArcFilterType() == "iepsilon")
-    arc_type = "input-epsilon ";
-  else if (fstinfo.ArcFilterType() == "oepsilon")
-    arc_type = "output-epsilon ";
-
-  string accessible_label = "# of " + arc_type + "accessible states";
-  os.width(50);
-  os << accessible_label << fstinfo.NumAccessible() << std::endl;
-  string coaccessible_label = "# of " + arc_type + "coaccessible states";
-  os.width(50);
-  os << coaccessible_label << fstinfo.NumCoAccessible() << std::endl;
-  string connected_label = "# of " + arc_type + "connected states";
-  os.width(50);
-  os << connected_label << fstinfo.NumConnected() << std::endl;
-  string numcc_label = "# of " + arc_type + "connected components";
-  os.width(50);
-  os << numcc_label << fstinfo.NumCc() << std::endl;
-  string numscc_label = "# of " + arc_type + "strongly conn components";
-  os.width(50);
-  os << numscc_label << fstinfo.NumScc() << std::endl;
+  if (!fstinfo.FastInfo()) PrintConnectivityInfo(fstinfo, os);
 
   os.width(50);
   os << "input matcher"
@@ -27,6 +27,35 @@ struct RmEpsilonOptions : public fst::script::ShortestDistanceOptions {
         connect(c), weight_threshold(w), state_threshold(n) {}
 };
 
+// The radix queue is only available for weights holding a single real value.
+template <class Arc,
+          bool = fst::internal::IsFloatWeight<typename Arc::Weight>::value>
+struct RadixRmEpsilon {
+  static void Run(MutableFst<Arc> *fst,
+                  std::vector<typename Arc::Weight> *distance,
+                  const RmEpsilonOptions &opts,
+                  const typename Arc::Weight &weight_threshold) {
+    FSTERROR() << "RmEpsilon: Radix queue not supported for weight type "
+               << Arc::Weight::Type();
+    fst->SetProperties(kError, kError);
+  }
+};
+
+template <class Arc>
+struct RadixRmEpsilon<Arc, true> {
+  static void Run(MutableFst<Arc> *fst,
+                  std::vector<typename Arc::Weight> *distance,
+                  const RmEpsilonOptions &opts,
+                  const typename Arc::Weight &weight_threshold) {
+    typedef RadixQueue<typename Arc::StateId, typename Arc::Weight> Queue;
+    Queue queue(*distance);
+    fst::RmEpsilonOptions<Arc, Queue> ropts(&queue, opts.delta, opts.connect,
+                                            weight_threshold,
+                                            opts.state_threshold);
+    RmEpsilon(fst, distance, ropts);
+  }
+};
+
 // This function transforms a script-land RmEpsilonOptions into a lib-land
 // RmEpsilonOptions, and then calls the operation.
 template <class Arc>
@@ -64,6 +93,10 @@ void RmEpsilonHelper(MutableFst<Arc> *fst,
       RmEpsilon(fst, distance, ropts);
       break;
     }
+    case RADIX_QUEUE: {
+      RadixRmEpsilon<Arc>::Run(fst, distance, opts, weight_threshold);
+      break;
+    }
     case SHORTEST_FIRST_QUEUE: {
       NaturalShortestFirstQueue<StateId, Weight> queue(*distance);
       fst::RmEpsilonOptions<Arc, NaturalShortestFirstQueue<StateId, Weight>>
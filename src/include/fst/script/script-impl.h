@@ -73,6 +73,12 @@
 //  it dispatches (in #3) via the Apply<> function to the correct
 //  instantiation of the template function in #2.
 //
+//  Callers which apply the same operation many times can instead resolve it
+//  once and keep the resulting handle:
+//
+//     auto foo = Resolve<Operation<FooArgs>>("Foo", ifst.ArcType());
+//     if (foo) foo(&args);
+//
 
 #ifndef FST_SCRIPT_SCRIPT_IMPL_H_
 #define FST_SCRIPT_SCRIPT_IMPL_H_
@@ -84,6 +90,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <fst/generic-register.h>
 #include <fst/script/arg-packs.h>
@@ -157,13 +164,64 @@ struct Operation {
       arc_dispatched_operation_##ArgPack##Op##Arc##_registerer \
       (std::make_pair(#Op, Arc::Type()), Op<Arc>)
 
+// A resolved operation: the function registered for a given operation name
+// and arc type, or a null handle if there is none.
+
+template <class OpReg>
+class OperationHandle {
+ public:
+  typedef typename OpReg::Args Args;
+  typedef typename OpReg::OpType OpType;
+
+  OperationHandle() : op_(nullptr) {}
+
+  explicit OperationHandle(OpType op) : op_(op) {}
+
+  explicit operator bool() const { return op_ != nullptr; }
+
+  void operator()(Args *args) const { op_(args); }
+
+ private:
+  OpType op_;
+};
+
+namespace internal {
+
+template <class OpReg>
+struct ResolvedOperation {
+  string op_name;
+  string arc_type;
+  typename OpReg::OpType op;
+};
+
+}  // namespace internal
+
+// Looks up an operation by name and arc type. Successful lookups are cached
+// per thread, so resolving an already-loaded operation again neither
+// constructs register keys nor takes the register lock. Failed lookups are
+// not cached, so a later call may still load the arc type from a shared
+// object.
+
+template <class OpReg>
+OperationHandle<OpReg> Resolve(const string &op_name, const string &arc_type) {
+  static thread_local std::vector<internal::ResolvedOperation<OpReg>> cache;
+  for (const auto &resolved : cache) {
+    if (resolved.arc_type == arc_type && resolved.op_name == op_name) {
+      return OperationHandle<OpReg>(resolved.op);
+    }
+  }
+  typename OpReg::OpType op =
+      OpReg::Register::GetRegister()->GetOperation(op_name, arc_type);
+  if (op) cache.push_back({op_name, arc_type, op});
+  return OperationHandle<OpReg>(op);
+}
+
 // Template function to apply an operation by name.
 
 template <class OpReg>
 void Apply(const string &op_name, const string &arc_type,
            typename OpReg::Args *args) {
-  typename OpReg::Register *reg = OpReg::Register::GetRegister();
-  typename OpReg::OpType op = reg->GetOperation(op_name, arc_type);
+  const auto op = Resolve<OpReg>(op_name, arc_type);
   if (!op) {
     FSTERROR() << "No operation found for " << op_name << " on "
                << "arc type " << arc_type;
@@ -73,6 +73,16 @@ struct QueueConstructor<
   }
 };
 
+template <class Arc, class ArcFilter>
+struct QueueConstructor<
+    RadixQueue<typename Arc::StateId, typename Arc::Weight>, Arc, ArcFilter> {
+  static RadixQueue<typename Arc::StateId, typename Arc::Weight> *Construct(
+      const Fst<Arc> &fst, const std::vector<typename Arc::Weight> *distance) {
+    return new RadixQueue<typename Arc::StateId, typename Arc::Weight>(
+        *distance);
+  }
+};
+
 template <class Arc, class ArcFilter>
 struct QueueConstructor<TopOrderQueue<typename Arc::StateId>, Arc, ArcFilter> {
   //  template<class Arc, class ArcFilter>
@@ -130,6 +140,24 @@ void ShortestDistanceHelper(ShortestDistanceArgs1 *args) {
   }
 }
 
+// The radix queue is only available for weights holding a single real value.
+template <class Arc,
+          bool = fst::internal::IsFloatWeight<typename Arc::Weight>::value>
+struct RadixShortestDistance {
+  static void Run(ShortestDistanceArgs1 *args) {
+    FSTERROR() << "ShortestDistance: Radix queue not supported for weight type "
+               << Arc::Weight::Type();
+  }
+};
+
+template <class Arc>
+struct RadixShortestDistance<Arc, true> {
+  static void Run(ShortestDistanceArgs1 *args) {
+    ShortestDistanceHelper<
+        Arc, RadixQueue<typename Arc::StateId, typename Arc::Weight>>(args);
+  }
+};
+
 template <class Arc>
 void ShortestDistance(ShortestDistanceArgs1 *args) {
   const ShortestDistanceOptions &opts = args->arg3;
@@ -149,6 +177,9 @@ void ShortestDistance(ShortestDistanceArgs1 *args) {
     case LIFO_QUEUE:
       ShortestDistanceHelper<Arc, LifoQueue<StateId>>(args);
       return;
+    case RADIX_QUEUE:
+      RadixShortestDistance<Arc>::Run(args);
+      return;
     case SHORTEST_FIRST_QUEUE:
       ShortestDistanceHelper<Arc, NaturalShortestFirstQueue<StateId, Weight>>(
           args);
@@ -37,6 +37,38 @@ typedef args::Package<const FstClass &, MutableFstClass *,
                       std::vector<WeightClass> *,
                       const ShortestPathOptions &> ShortestPathArgs1;
 
+// The radix queue is only available for weights holding a single real value.
+template <class Arc,
+          bool = fst::internal::IsFloatWeight<typename Arc::Weight>::value>
+struct RadixShortestPath {
+  static void Run(ShortestPathArgs1 *args) {
+    FSTERROR() << "ShortestPath: Radix queue not supported for weight type "
+               << Arc::Weight::Type();
+    args->arg2->GetMutableFst<Arc>()->SetProperties(kError, kError);
+  }
+};
+
+template <class Arc>
+struct RadixShortestPath<Arc, true> {
+  static void Run(ShortestPathArgs1 *args) {
+    typedef typename Arc::Weight Weight;
+    typedef AnyArcFilter<Arc> ArcFilter;
+    typedef RadixQueue<typename Arc::StateId, Weight> Queue;
+    const Fst<Arc> &ifst = *(args->arg1.GetFst<Arc>());
+    MutableFst<Arc> *ofst = args->arg2->GetMutableFst<Arc>();
+    const ShortestPathOptions &opts = args->arg4;
+    std::vector<Weight> weights;
+    const Weight &weight_threshold = *opts.weight_threshold.GetWeight<Weight>();
+    std::unique_ptr<Queue> queue(
+        QueueConstructor<Queue, Arc, ArcFilter>::Construct(ifst, &weights));
+    fst::ShortestPathOptions<Arc, Queue, ArcFilter> spopts(
+        queue.get(), ArcFilter(), opts.nshortest, opts.unique,
+        opts.has_distance, opts.delta, opts.first_path, weight_threshold,
+        opts.state_threshold);
+    ShortestPath(ifst, ofst, &weights, spopts);
+  }
+};
+
 template <class Arc>
 void ShortestPath(ShortestPathArgs1 *args) {
   typedef typename Arc::Weight Weight;
@@ -81,6 +113,10 @@ void ShortestPath(ShortestPathArgs1 *args) {
       ShortestPath(ifst, ofst, &weights, spopts);
       return;
     }
+    case RADIX_QUEUE: {
+      RadixShortestPath<Arc>::Run(args);
+      return;
+    }
     case SHORTEST_FIRST_QUEUE: {
       typedef NaturalShortestFirstQueue<StateId, Weight> Queue;
       std::unique_ptr<Queue> queue(
@@ -0,0 +1,51 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#ifndef FST_SCRIPT_STATE_REORDER_H_
+#define FST_SCRIPT_STATE_REORDER_H_
+
+#include <vector>
+
+#include <fst/state-reorder.h>
+#include <fst/script/arg-packs.h>
+#include <fst/script/fst-class.h>
+
+namespace fst {
+namespace script {
+
+typedef args::Package<MutableFstClass *, StateReorderType,
+                      const std::vector<size_t> *, std::vector<int64> *>
+    StateReorderInnerArgs;
+typedef args::WithReturnValue<bool, StateReorderInnerArgs> StateReorderArgs;
+
+template <class Arc>
+void StateReorder(StateReorderArgs *args) {
+  MutableFst<Arc> *fst = args->args.arg1->GetMutableFst<Arc>();
+  std::vector<typename Arc::StateId> order;
+  args->retval = StateReorder(fst, args->args.arg2, args->args.arg3, &order);
+  if (args->retval && args->args.arg4) {
+    args->args.arg4->assign(order.begin(), order.end());
+  }
+}
+
+// If ORDER is non-null, it is set to the renumbering applied to FST.
+bool StateReorder(MutableFstClass *fst, StateReorderType type,
+                  const std::vector<size_t> *counts = nullptr,
+                  std::vector<int64> *order = nullptr);
+
+typedef args::Package<const FstClass &, size_t> ArcPageLocalityInnerArgs;
+typedef args::WithReturnValue<double, ArcPageLocalityInnerArgs>
+    ArcPageLocalityArgs;
+
+template <class Arc>
+void ArcPageLocality(ArcPageLocalityArgs *args) {
+  const Fst<Arc> &fst = *(args->args.arg1.GetFst<Arc>());
+  args->retval = ArcPageLocality(fst, args->args.arg2);
+}
+
+double ArcPageLocality(const FstClass &fst, size_t states_per_page);
+
+}  // namespace script
+}  // namespace fst
+
+#endif  // FST_SCRIPT_STATE_REORDER_H_
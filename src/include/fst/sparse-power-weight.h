@@ -123,6 +123,7 @@ template <class W, class K>
 inline SparsePowerWeight<W, K> Plus(const SparsePowerWeight<W, K> &w1,
                                     const SparsePowerWeight<W, K> &w2) {
   SparsePowerWeight<W, K> ret;
+  ret.Reserve(w1.Size() + w2.Size());  // Upper bound on the union of keys.
   SparseTupleWeightPlusMapper<W, K> operator_mapper;
   SparseTupleWeightMap(&ret, w1, w2, operator_mapper);
   return ret;
@@ -2,7 +2,7 @@
 // finite-state transducer library.
 //
 // Sparse version of tuple-weight, based on tuple-weight.h.
-// Internally stores sparse key, value pairs in linked list. The default value
+// Internally stores sparse key, value pairs in a vector. The default value
 // element is the assumed value of unset keys. Internal singleton
 // implementation that stores first key, value pair as a initialized member
 // variable to avoid unnecessary allocation on heap. Use
@@ -14,10 +14,10 @@
 #ifndef FST_LIB_SPARSE_TUPLE_WEIGHT_H_
 #define FST_LIB_SPARSE_TUPLE_WEIGHT_H_
 
-#include <list>
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 
 #include <fst/weight.h>
@@ -28,7 +28,7 @@ namespace fst {
 template <class W, class K>
 class SparseTupleWeightIterator;
 
-// Arbitrary dimension tuple weight, stored as a sorted linked-list.
+// Arbitrary dimension tuple weight, stored as a sorted vector.
 // W is any weight class, and K is the key value type. kNoKey(-1) is reserved
 // for internal use.
 template <class W, class K = int>
@@ -56,7 +56,7 @@ class SparseTupleWeight {
 
   SparseTupleWeight(const SparseTupleWeight &w) {
     Init(w.DefaultValue());
-    SetDefaultValue(w.DefaultValue());
+    Reserve(w.Size());
     for (SparseTupleWeightIterator<W, K> it(w); !it.Done(); it.Next()) {
       Push(it.Value());
     }
@@ -92,6 +92,7 @@ class SparseTupleWeight {
   SparseTupleWeight &operator=(const SparseTupleWeight &w) {
     if (this == &w) return *this;  // check for w = w
     Init(w.DefaultValue());
+    Reserve(w.Size());
     for (SparseTupleWeightIterator<W, K> it(w); !it.Done(); it.Next()) {
       Push(it.Value());
     }
@@ -151,6 +152,11 @@ class SparseTupleWeight {
     }
   }
 
+  // Preallocates room for N key, value pairs.
+  void Reserve(size_t n) {
+    if (n > 1) rest_.reserve(n - 1);
+  }
+
   inline void Push(const K &k, const W &w, bool default_value_check = true) {
     Push(std::make_pair(k, w), default_value_check);
   }
@@ -174,9 +180,10 @@ class SparseTupleWeight {
 
   // Key values pairs are first stored in first_, then fill rest_
   // this way we can avoid dynamic allocation in the common case
-  // where the weight is a single key,val pair.
+  // where the weight is a single key,val pair. Keeping rest_ contiguous
+  // makes the remaining pairs a single allocation, reused on assignment.
   Pair first_;
-  std::list<Pair> rest_;
+  std::vector<Pair> rest_;
 
   friend class SparseTupleWeightIterator<W, K>;
 };
@@ -185,8 +192,8 @@ template <class W, class K>
 class SparseTupleWeightIterator {
  public:
   typedef typename SparseTupleWeight<W, K>::Pair Pair;
-  typedef typename std::list<Pair>::const_iterator const_iterator;
-  typedef typename std::list<Pair>::iterator iterator;
+  typedef typename std::vector<Pair>::const_iterator const_iterator;
+  typedef typename std::vector<Pair>::iterator iterator;
 
   explicit SparseTupleWeightIterator(const SparseTupleWeight<W, K> &w)
       : first_(w.first_), rest_(w.rest_), init_(true), iter_(rest_.begin()) {}
@@ -216,9 +223,9 @@ class SparseTupleWeightIterator {
 
  private:
   const Pair &first_;
-  const std::list<Pair> &rest_;
+  const std::vector<Pair> &rest_;
   bool init_;  // in the initialized state?
-  typename std::list<Pair>::const_iterator iter_;
+  typename std::vector<Pair>::const_iterator iter_;
 };
 
 template <class W, class K, class M>
@@ -0,0 +1,202 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Functions to renumber the states of an FST for memory locality, so that
+// states likely to be visited together lie close to one another in memory.
+
+#ifndef FST_LIB_STATE_REORDER_H_
+#define FST_LIB_STATE_REORDER_H_
+
+#include <algorithm>
+#include <vector>
+
+#include <fst/dfs-visit.h>
+#include <fst/expanded-fst.h>
+#include <fst/mutable-fst.h>
+#include <fst/queue.h>
+#include <fst/statesort.h>
+#include <fst/visit.h>
+
+namespace fst {
+
+enum StateReorderType {
+  BFS_STATE_REORDER,      // Breadth-first discovery order from the start.
+  DFS_STATE_REORDER,      // Depth-first discovery order from the start.
+  PROFILE_STATE_REORDER   // Visited (hot) states first, in DFS order.
+};
+
+// Visitor class that numbers states in the order they are discovered. It
+// implements both the Visit() interface in visit.h and the DfsVisit()
+// interface in dfs-visit.h. States not accessible from the initial state are
+// numbered after the accessible ones, as the visit reaches them.
+template <class A>
+class StateOrderVisitor {
+ public:
+  typedef A Arc;
+  typedef typename A::StateId StateId;
+
+  // ORDER[i] gives the discovery position of state Id i, in the form expected
+  // by StateSort().
+  explicit StateOrderVisitor(std::vector<StateId> *order)
+      : order_(order), nstates_(0) {}
+
+  void InitVisit(const Fst<A> &fst) {
+    order_->clear();
+    nstates_ = 0;
+  }
+
+  bool InitState(StateId s, StateId root) {
+    if (static_cast<size_t>(s) >= order_->size()) {
+      order_->resize(s + 1, kNoStateId);
+    }
+    (*order_)[s] = nstates_++;
+    return true;
+  }
+
+  // Visit() interface.
+  bool WhiteArc(StateId s, const A &arc) { return true; }
+  bool GreyArc(StateId s, const A &arc) { return true; }
+  bool BlackArc(StateId s, const A &arc) { return true; }
+  void FinishState(StateId s) {}
+
+  // DfsVisit() interface.
+  bool TreeArc(StateId s, const A &arc) { return true; }
+  bool BackArc(StateId s, const A &arc) { return true; }
+  bool ForwardOrCrossArc(StateId s, const A &arc) { return true; }
+  void FinishState(StateId s, StateId parent, const A *arc) {}
+
+  void FinishVisit() {}
+
+ private:
+  std::vector<StateId> *order_;
+  StateId nstates_;
+};
+
+namespace internal {
+
+// Moves the states with a non-zero count in COUNTS (hot states) ahead of the
+// rest (cold states), otherwise keeping the existing positions in ORDER,
+// which is overwritten with the result.
+template <class StateId>
+void ProfileStateOrder(const std::vector<size_t> &counts,
+                       std::vector<StateId> *order) {
+  std::vector<StateId> states(order->size());
+  for (size_t s = 0; s < order->size(); ++s) states[(*order)[s]] = s;
+  std::stable_partition(states.begin(), states.end(), [&counts](StateId s) {
+    return static_cast<size_t>(s) < counts.size() && counts[s] > 0;
+  });
+  for (size_t i = 0; i < states.size(); ++i) (*order)[states[i]] = i;
+}
+
+}  // namespace internal
+
+// Computes a locality-improving renumbering of the states of FST, returning
+// it in ORDER in the form expected by StateSort(): ORDER[i] gives the state
+// Id after sorting that corresponds to state Id i before sorting.
+//
+// BFS_STATE_REORDER places states in breadth-first order from the initial
+// state, so that the destinations of a state's arcs tend to be numbered close
+// together. DFS_STATE_REORDER places states in depth-first preorder, so that
+// long paths tend to be contiguous. PROFILE_STATE_REORDER places the states
+// with non-zero COUNTS, which gives per-state visit counts (e.g., gathered
+// from decoding traces), ahead of the unvisited ones, both in depth-first
+// preorder; the hot states then share a small number of pages, and paths
+// through them stay contiguous. (Sorting by descending count instead scatters
+// the paths and touches more pages.)
+//
+// Complexity:
+// - Time: O(V + E)
+// - Space: O(V)
+// where V = # of states and E = # of arcs.
+template <class Arc>
+void StateReorderOrder(const ExpandedFst<Arc> &fst, StateReorderType type,
+                       std::vector<typename Arc::StateId> *order,
+                       const std::vector<size_t> *counts = nullptr) {
+  typedef typename Arc::StateId StateId;
+
+  StateOrderVisitor<Arc> visitor(order);
+  if (type != BFS_STATE_REORDER) {
+    DfsVisit(fst, &visitor);
+  } else {
+    FifoQueue<StateId> queue;
+    Visit(fst, &visitor, &queue);
+  }
+  if (fst.Start() == kNoStateId) {  // Nothing visited; keeps the numbering.
+    order->resize(fst.NumStates());
+    for (size_t s = 0; s < order->size(); ++s) (*order)[s] = s;
+  }
+  if (type == PROFILE_STATE_REORDER) {
+    if (!counts) {
+      FSTERROR() << "StateReorderOrder: Profile order requires visit counts";
+      order->clear();
+      return;
+    }
+    internal::ProfileStateOrder(*counts, order);
+  }
+}
+
+// Renumbers the states of FST for memory locality as described above,
+// modifying it. If ORDER is non-null, it is set to the renumbering applied,
+// in the form expected by StateSort(). Returns false on error.
+template <class Arc>
+bool StateReorder(MutableFst<Arc> *fst, StateReorderType type,
+                  const std::vector<size_t> *counts = nullptr,
+                  std::vector<typename Arc::StateId> *order = nullptr) {
+  std::vector<typename Arc::StateId> local_order;
+  if (!order) order = &local_order;
+  StateReorderOrder(*fst, type, order, counts);
+  if (order->size() != static_cast<size_t>(fst->NumStates())) {
+    fst->SetProperties(kError, kError);
+    return false;
+  }
+  StateSort(fst, *order);
+  return true;
+}
+
+// Returns the fraction of the arcs of FST whose source and destination
+// states lie on the same page, where a page holds STATES_PER_PAGE
+// consecutively numbered states. This is the locality expected when
+// following arcs with no knowledge of which arcs are taken.
+template <class Arc>
+double ArcPageLocality(const Fst<Arc> &fst, size_t states_per_page) {
+  typedef typename Arc::StateId StateId;
+
+  if (states_per_page == 0) states_per_page = 1;
+  size_t narcs = 0;
+  size_t nlocal = 0;
+  for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      ++narcs;
+      if (s / states_per_page == aiter.Value().nextstate / states_per_page) {
+        ++nlocal;
+      }
+    }
+  }
+  return narcs ? static_cast<double>(nlocal) / narcs : 1.0;
+}
+
+// Returns the number of page changes when visiting the states in TRACE in
+// sequence, where a page holds STATES_PER_PAGE consecutively numbered states;
+// the first visit counts as a change. If ORDER is non-null, the trace is
+// renumbered by it first, giving the measured locality of the trace after
+// StateSort(fst, *ORDER).
+template <class StateId>
+size_t TracePageTouches(const std::vector<StateId> &trace,
+                        size_t states_per_page,
+                        const std::vector<StateId> *order = nullptr) {
+  if (states_per_page == 0) states_per_page = 1;
+  size_t ntouches = 0;
+  StateId last_page = kNoStateId;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    StateId s = order ? (*order)[trace[i]] : trace[i];
+    StateId page = s / states_per_page;
+    if (page != last_page) ++ntouches;
+    last_page = page;
+  }
+  return ntouches;
+}
+
+}  // namespace fst
+
+#endif  // FST_LIB_STATE_REORDER_H_
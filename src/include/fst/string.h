@@ -48,48 +48,63 @@ class StringCompiler {
                        allow_negative) {}
 
   // Compile string 's' into FST 'fst'.
+  // The label and token buffers are kept per thread, so compiling many
+  // strings into a reused FST (e.g., a CompactStringFst whose elements are
+  // replaced on each call) does not allocate per string.
   template <class F>
   bool operator()(const string &s, F *fst) const {
-    std::vector<Label> labels;
-    if (!ConvertStringToLabels(s, &labels)) return false;
-    Compile(labels, fst);
+    std::vector<Label> *labels = LabelBuffer();
+    if (!ConvertStringToLabels(s, labels)) return false;
+    Compile(*labels, fst);
     return true;
   }
 
   template <class F>
   bool operator()(const string &s, F *fst, Weight w) const {
-    std::vector<Label> labels;
-    if (!ConvertStringToLabels(s, &labels)) return false;
-    Compile(labels, fst, w);
+    std::vector<Label> *labels = LabelBuffer();
+    if (!ConvertStringToLabels(s, labels)) return false;
+    Compile(*labels, fst, w);
     return true;
   }
 
  private:
+  static std::vector<Label> *LabelBuffer() {
+    static thread_local std::vector<Label> labels;
+    return &labels;
+  }
+
+  static std::vector<std::pair<Label, Weight>> *CompactBuffer() {
+    static thread_local std::vector<std::pair<Label, Weight>> compacts;
+    return &compacts;
+  }
+
+  // Splits the string on the field separators in place, skipping empty
+  // fields as SplitToVector does.
   bool ConvertStringToLabels(const string &str,
                              std::vector<Label> *labels) const {
     labels->clear();
     if (token_type_ == BYTE) {
+      labels->reserve(str.size());
       for (size_t i = 0; i < str.size(); ++i) {
         labels->push_back(static_cast<unsigned char>(str[i]));
       }
     } else if (token_type_ == UTF8) {
       return UTF8StringToLabels(str, labels);
     } else {
-      char *c_str = new char[str.size() + 1];
-      str.copy(c_str, str.size());
-      c_str[str.size()] = 0;
-      std::vector<char *> vec;
-      string separator = "\n" + FLAGS_fst_field_separator;
-      SplitToVector(c_str, separator.c_str(), &vec, true);
-      for (size_t i = 0; i < vec.size(); ++i) {
+      static thread_local string separators;
+      static thread_local string token;
+      separators.assign(1, '\n');
+      separators += FLAGS_fst_field_separator;
+      size_t begin = str.find_first_not_of(separators);
+      while (begin != string::npos) {
+        size_t end = str.find_first_of(separators, begin);
+        if (end == string::npos) end = str.size();
+        token.assign(str, begin, end - begin);
         Label label;
-        if (!ConvertSymbolToLabel(vec[i], &label)) {
-          delete[] c_str;
-          return false;
-        }
+        if (!ConvertSymbolToLabel(token, &label)) return false;
         labels->push_back(label);
+        begin = str.find_first_not_of(separators, end);
       }
-      delete[] c_str;
     }
     return true;
   }
@@ -115,17 +130,17 @@ class StringCompiler {
   void Compile(const std::vector<Label> &labels,
                CompactWeightedStringFst<A, Unsigned> *fst,
                const Weight &weight = Weight::One()) const {
-    std::vector<std::pair<Label, Weight>> compacts;
-    compacts.reserve(labels.size() + 1);
+    std::vector<std::pair<Label, Weight>> *compacts = CompactBuffer();
+    compacts->clear();
     for (int i = 0; i < static_cast<int>(labels.size()) - 1; ++i) {
-      compacts.push_back(std::make_pair(labels[i], Weight::One()));
+      compacts->push_back(std::make_pair(labels[i], Weight::One()));
     }
-    compacts.push_back(
+    compacts->push_back(
         std::make_pair(!labels.empty() ? labels.back() : kNoLabel, weight));
-    fst->SetCompactElements(compacts.begin(), compacts.end());
+    fst->SetCompactElements(compacts->begin(), compacts->end());
   }
 
-  bool ConvertSymbolToLabel(const char *s, Label *output) const {
+  bool ConvertSymbolToLabel(const string &s, Label *output) const {
     int64 n;
     if (syms_) {
       n = syms_->Find(s);
@@ -138,8 +153,8 @@ class StringCompiler {
       }
     } else {
       char *p;
-      n = strtoll(s, &p, 10);
-      if (p < s + strlen(s) || (!allow_negative_ && n < 0)) {
+      n = strtoll(s.c_str(), &p, 10);
+      if (p < s.c_str() + s.size() || (!allow_negative_ && n < 0)) {
         VLOG(1) << "StringCompiler::ConvertSymbolToLabel: Bad label integer "
                 << "= \"" << s << "\"";
         return false;
@@ -8,11 +8,10 @@
 
 #include <algorithm>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include <fst/bi-table.h>
 #include <fst/cache.h>
 #include <fst/test-properties.h>
 
@@ -45,18 +44,18 @@ class SynchronizeFstImpl : public CacheImpl<A> {
 
   typedef basic_string<Label> String;
 
+  // Residual strings are interned in a table and represented by their ID.
+  typedef int StringId;
+
   struct Element {
     Element() {}
 
-    Element(StateId s, const String *i, const String *o)
+    Element(StateId s, StringId i, StringId o)
         : state(s), istring(i), ostring(o) {}
 
-    StateId state;          // Input state Id
-    const String *istring;  // Residual input labels
-    const String *ostring;  // Residual output labels
-    // Residual strings are represented by const pointers to
-    // basic_string<Label> and are stored in a hash_set. The pointed
-    // memory is owned by the hash_set string_set_.
+    StateId state;     // Input state Id
+    StringId istring;  // Residual input labels
+    StringId ostring;  // Residual output labels
   };
 
   SynchronizeFstImpl(const Fst<A> &fst, const SynchronizeFstOptions &opts)
@@ -77,15 +76,12 @@ class SynchronizeFstImpl : public CacheImpl<A> {
     SetOutputSymbols(impl.OutputSymbols());
   }
 
-  ~SynchronizeFstImpl() override {
-    for (const String *ptr : string_set_) delete ptr;
-  }
-
   StateId Start() {
     if (!HasStart()) {
       StateId s = fst_->Start();
       if (s == kNoStateId) return kNoStateId;
-      const String *empty = FindString(new String());
+      buffer_.clear();
+      const StringId empty = string_table_.FindId(buffer_);
       StateId start = FindState(Element(fst_->Start(), empty, empty));
       SetStart(start);
     }
@@ -94,10 +90,10 @@ class SynchronizeFstImpl : public CacheImpl<A> {
 
   Weight Final(StateId s) {
     if (!HasFinal(s)) {
-      const Element &e = elements_[s];
+      const Element &e = element_table_.FindEntry(s);
       Weight w = e.state == kNoStateId ? Weight::One() : fst_->Final(e.state);
-      if ((w != Weight::Zero()) && (e.istring)->empty() &&
-          (e.ostring)->empty()) {
+      if ((w != Weight::Zero()) && GetString(e.istring).empty() &&
+          GetString(e.ostring).empty()) {
         SetFinal(s, w);
       } else {
         SetFinal(s, Weight::Zero());
@@ -136,11 +132,17 @@ class SynchronizeFstImpl : public CacheImpl<A> {
     CacheImpl<A>::InitArcIterator(s, data);
   }
 
+  // Returns the residual string with the given ID.
+  const String &GetString(StringId id) const {
+    return string_table_.FindEntry(id);
+  }
+
   // Returns the first character of the string obtained by
   // concatenating s and l.
-  Label Car(const String *s, Label l = 0) const {
-    if (!s->empty()) {
-      return (*s)[0];
+  Label Car(StringId s, Label l = 0) const {
+    const String &str = GetString(s);
+    if (!str.empty()) {
+      return str[0];
     } else {
       return l;
     }
@@ -148,68 +150,51 @@ class SynchronizeFstImpl : public CacheImpl<A> {
 
   // Computes the residual string obtained by removing the first
   // character in the concatenation of s and l.
-  const String *Cdr(const String *s, Label l = 0) {
-    String *r = new String();
-    for (int i = 1; i < s->size(); ++i) r->push_back((*s)[i]);
-    if (l && !(s->empty())) r->push_back(l);
-    return FindString(r);
+  StringId Cdr(StringId s, Label l = 0) {
+    const String &str = GetString(s);
+    buffer_.clear();
+    if (!str.empty()) buffer_.append(str, 1, String::npos);
+    if (l && !str.empty()) buffer_.push_back(l);
+    return string_table_.FindId(buffer_);
   }
 
   // Computes the concatenation of s and l.
-  const String *Concat(const String *s, Label l = 0) {
-    String *r = new String();
-    for (int i = 0; i < s->size(); ++i) r->push_back((*s)[i]);
-    if (l) r->push_back(l);
-    return FindString(r);
+  StringId Concat(StringId s, Label l = 0) {
+    buffer_ = GetString(s);
+    if (l) buffer_.push_back(l);
+    return string_table_.FindId(buffer_);
   }
 
   // Tests if the concatenation of s and l is empty
-  bool Empty(const String *s, Label l = 0) const {
-    if (s->empty()) {
+  bool Empty(StringId s, Label l = 0) const {
+    if (GetString(s).empty()) {
       return l == 0;
     } else {
       return false;
     }
   }
 
-  // Finds the string pointed by s in the hash set. Transfers the
-  // pointer ownership to the hash set.
-  const String *FindString(const String *s) {
-    auto insert_result = string_set_.insert(s);
-    if (!insert_result.second) {
-      delete s;
-    }
-    return *insert_result.first;
-  }
-
   // Finds state corresponding to an element. Creates new state
   // if element not found.
-  StateId FindState(const Element &e) {
-    auto insert_result =
-        element_map_.insert(std::make_pair(e, elements_.size()));
-    if (insert_result.second) {
-      elements_.push_back(e);
-    }
-    return insert_result.first->second;
-  }
+  StateId FindState(const Element &e) { return element_table_.FindId(e); }
 
   // Computes the outgoing transitions from a state, creating new destination
   // states as needed.
   void Expand(StateId s) {
-    Element e = elements_[s];
+    const Element e = element_table_.FindEntry(s);
 
     if (e.state != kNoStateId) {
       for (ArcIterator<Fst<A>> ait(*fst_, e.state); !ait.Done(); ait.Next()) {
         const A &arc = ait.Value();
         if (!Empty(e.istring, arc.ilabel) && !Empty(e.ostring, arc.olabel)) {
-          const String *istring = Cdr(e.istring, arc.ilabel);
-          const String *ostring = Cdr(e.ostring, arc.olabel);
+          const StringId istring = Cdr(e.istring, arc.ilabel);
+          const StringId ostring = Cdr(e.ostring, arc.olabel);
           StateId d = FindState(Element(arc.nextstate, istring, ostring));
           PushArc(s, Arc(Car(e.istring, arc.ilabel), Car(e.ostring, arc.olabel),
                          arc.weight, d));
         } else {
-          const String *istring = Concat(e.istring, arc.ilabel);
-          const String *ostring = Concat(e.ostring, arc.olabel);
+          const StringId istring = Concat(e.istring, arc.ilabel);
+          const StringId ostring = Concat(e.ostring, arc.olabel);
           StateId d = FindState(Element(arc.nextstate, istring, ostring));
           PushArc(s, Arc(0, 0, arc.weight, d));
         }
@@ -218,9 +203,9 @@ class SynchronizeFstImpl : public CacheImpl<A> {
 
     Weight w = e.state == kNoStateId ? Weight::One() : fst_->Final(e.state);
     if ((w != Weight::Zero()) &&
-        ((e.istring)->size() + (e.ostring)->size() > 0)) {
-      const String *istring = Cdr(e.istring);
-      const String *ostring = Cdr(e.ostring);
+        (GetString(e.istring).size() + GetString(e.ostring).size() > 0)) {
+      const StringId istring = Cdr(e.istring);
+      const StringId ostring = Cdr(e.ostring);
       StateId d = FindState(Element(kNoStateId, istring, ostring));
       PushArc(s, Arc(Car(e.istring), Car(e.ostring), w, d));
     }
@@ -228,7 +213,7 @@ class SynchronizeFstImpl : public CacheImpl<A> {
   }
 
  private:
-  // Equality function for Elements, assume strings have been hashed.
+  // Equality function for Elements, assume strings have been interned.
   class ElementEqual {
    public:
     bool operator()(const Element &x, const Element &y) const {
@@ -241,49 +226,31 @@ class SynchronizeFstImpl : public CacheImpl<A> {
   class ElementKey {
    public:
     size_t operator()(const Element &x) const {
-      size_t key = x.state;
-      key = (key << 1) ^ (x.istring)->size();
-      for (size_t i = 0; i < (x.istring)->size(); ++i) {
-        key = (key << 1) ^ (*x.istring)[i];
-      }
-      key = (key << 1) ^ (x.ostring)->size();
-      for (size_t i = 0; i < (x.ostring)->size(); ++i) {
-        key = (key << 1) ^ (*x.ostring)[i];
-      }
-      return key;
-    }
-  };
-
-  // Equality function for strings
-  class StringEqual {
-   public:
-    bool operator()(const String *const &x, const String *const &y) const {
-      if (x->size() != y->size()) return false;
-      for (size_t i = 0; i < x->size(); ++i) {
-        if ((*x)[i] != (*y)[i]) return false;
-      }
-      return true;
+      static const size_t kPrime0 = 7853;
+      static const size_t kPrime1 = 7867;
+      return x.state + x.istring * kPrime0 + x.ostring * kPrime1;
     }
   };
 
-  // Hash function for set of strings
+  // Hash function for residual strings.
   class StringKey {
    public:
-    size_t operator()(const String *const &x) const {
-      size_t key = x->size();
-      for (size_t i = 0; i < x->size(); ++i) key = (key << 1) ^ (*x)[i];
+    size_t operator()(const String &x) const {
+      size_t key = x.size();
+      for (size_t i = 0; i < x.size(); ++i) key = (key << 1) ^ x[i];
       return key;
     }
   };
 
-  typedef std::unordered_map<Element, StateId, ElementKey, ElementEqual>
-      ElementMap;
-  typedef std::unordered_set<const String *, StringKey, StringEqual> StringSet;
+  typedef CompactHashBiTable<StateId, Element, ElementKey, ElementEqual,
+                             HS_STL> ElementTable;
+  typedef CompactHashBiTable<StringId, String, StringKey, std::equal_to<String>,
+                             HS_STL> StringTable;
 
   std::unique_ptr<const Fst<A>> fst_;
-  std::vector<Element> elements_;  // mapping Fst state to Elements
-  ElementMap element_map_;    // mapping Elements to Fst state
-  StringSet string_set_;
+  ElementTable element_table_;  // mapping between Fst states and Elements
+  StringTable string_table_;    // mapping between string IDs and strings
+  String buffer_;               // scratch string for residual lookups
 };
 
 // Synchronizes a transducer. This version is a delayed Fst.  The
@@ -10,11 +10,13 @@
 
 #include <cstdlib>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stack>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <fst/weight.h>
 
@@ -160,7 +162,7 @@ class UnionWeight {
   // is the least element.
   void Sort() {
     Compare cmp;
-    rest_.sort(cmp);
+    std::stable_sort(rest_.begin(), rest_.end(), cmp);
   }
 
  private:
@@ -174,8 +176,8 @@ class UnionWeight {
 
   UnionWeight(W w1, W w2) : first_(std::move(w1)), rest_(1, w2) {}
 
-  W first_;            // first weight in set
-  std::list<W> rest_;  // remaining weights in set
+  W first_;              // first weight in set
+  std::vector<W> rest_;  // remaining weights in set
 };
 
 template <class W, class O>
@@ -236,9 +238,9 @@ class UnionWeightIterator {
 
  private:
   const W &first_;
-  const std::list<W> &rest_;
+  const std::vector<W> &rest_;
   bool init_;  // in the initialized state?
-  typename std::list<W>::const_iterator iter_;
+  typename std::vector<W>::const_iterator iter_;
 };
 
 // Traverses union weight in backward direction.
@@ -270,9 +272,9 @@ class UnionWeightReverseIterator {
 
  private:
   const L &first_;
-  const std::list<L> &rest_;
+  const std::vector<L> &rest_;
   bool fin_;  // in the final state?
-  typename std::list<L>::const_reverse_iterator iter_;
+  typename std::vector<L>::const_reverse_iterator iter_;
 };
 
 // UnionWeight member functions follow that require
@@ -435,8 +437,8 @@ inline UnionWeight<W, O> Plus(const UnionWeight<W, O> &w1,
 
   typename O::Compare cmp;
   while (!iter1.Done() && !iter2.Done()) {
-    W v1 = iter1.Value();
-    W v2 = iter2.Value();
+    const W &v1 = iter1.Value();
+    const W &v2 = iter2.Value();
     if (cmp(v1, v2)) {
       sum.PushBack(v1, true);
       iter1.Next();
@@ -462,8 +464,9 @@ inline UnionWeight<W, O> Times(const UnionWeight<W, O> &w1,
   UnionWeightIterator<W, O> iter2(w2);
 
   UnionWeight<W, O> prod1;
+  UnionWeight<W, O> prod2;
   for (; !iter1.Done(); iter1.Next()) {
-    UnionWeight<W, O> prod2;
+    prod2.Clear();
     for (; !iter2.Done(); iter2.Next()) {
       prod2.PushBack(Times(iter1.Value(), iter2.Value()), true);
     }
@@ -6,6 +6,7 @@
 #ifndef FST_LIB_UTIL_H_
 #define FST_LIB_UTIL_H_
 
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <map>
@@ -59,10 +60,20 @@ inline std::istream &ReadType(std::istream &strm, string *s) {  // NOLINT
   s->clear();
   int32 ns = 0;
   strm.read(reinterpret_cast<char *>(&ns), sizeof(ns));
-  for (auto i = 0; i < ns; ++i) {
-    char c;
-    strm.read(&c, 1);
-    *s += c;
+  if (!strm || ns <= 0) return strm;
+  // Reads in bounded chunks, so that a corrupt length fails at the end of
+  // the stream instead of allocating up to 2GB up front.
+  const int32 kChunkSize = 1 << 16;
+  while (ns > 0) {
+    const int32 n = std::min(ns, kChunkSize);
+    const size_t size = s->size();
+    s->resize(size + n);
+    strm.read(&(*s)[size], n);
+    if (strm.gcount() < n) {
+      s->resize(size + strm.gcount());
+      break;
+    }
+    ns -= n;
   }
   return strm;
 }
@@ -7,9 +7,11 @@
 #define FST_LIB_VECTOR_FST_H_
 
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <fst/fst-decl.h>  // For optional argument declarations
+#include <fst/float-weight.h>
 #include <fst/mutable-fst.h>
 #include <fst/test-properties.h>
 
@@ -21,6 +23,25 @@ class VectorFst;
 template <class F, class G>
 void Cast(const F &, G *);
 
+namespace internal {
+
+// Whether an arc of type A in memory is byte-for-byte its serialization in
+// a VectorFst file (the labels, the value of a float weight and the next
+// state, without padding), so that the arcs of a state can be read and
+// written as a single block. Only arcs over float weights can qualify.
+template <class A, bool = IsFloatWeight<typename A::Weight>::value>
+struct IsBulkSerializableArc : std::false_type {};
+
+template <class W>
+struct IsBulkSerializableArc<ArcTpl<W>, true>
+    : std::integral_constant<
+          bool, sizeof(ArcTpl<W>) == 2 * sizeof(typename ArcTpl<W>::Label) +
+                                         sizeof(typename W::ValueType) +
+                                         sizeof(typename ArcTpl<W>::StateId)> {
+};
+
+}  // namespace internal
+
 // Arcs (of type A) implemented by an STL vector per state. M specifies Arc
 // allocator (default declared in fst-decl.h).
 template <class A, class M /* = std::allocator<A> */>
@@ -71,6 +92,21 @@ class VectorState {
     arcs_.push_back(arc);
   }
 
+  // Resizes the arcs to n, to be filled in through MutableArcs() with
+  // delayed book-keeping; finalize with SetArcs().
+  void ResizeArcs(size_t n) { arcs_.resize(n); }
+
+  // Recomputes the epsilon counts from the arcs.
+  void SetArcs() {
+    niepsilons_ = 0;
+    noepsilons_ = 0;
+    for (size_t a = 0; a < arcs_.size(); ++a) {
+      const A &arc = arcs_[a];
+      if (arc.ilabel == 0) ++niepsilons_;
+      if (arc.olabel == 0) ++noepsilons_;
+    }
+  }
+
   void SetArc(const A &arc, size_t n) {
     if (arcs_[n].ilabel == 0) --niepsilons_;
     if (arcs_[n].olabel == 0) --noepsilons_;
@@ -129,6 +165,7 @@ class VectorFstBaseImpl : public FstImpl<typename S::Arc> {
     for (StateId s = 0; s < states_.size(); ++s) {
       State::Destroy(states_[s], &state_alloc_);
     }
+    for (State *state : spare_states_) State::Destroy(state, &state_alloc_);
   }
 
   StateId Start() const { return start_; }
@@ -208,6 +245,33 @@ class VectorFstBaseImpl : public FstImpl<typename S::Arc> {
     SetStart(kNoStateId);
   }
 
+  // Removes all states but keeps them, with their arc storage, for reuse by
+  // AddSpareState().
+  void ClearStates() {
+    for (State *state : states_) {
+      state->Reset();
+      spare_states_.push_back(state);
+    }
+    states_.clear();
+    SetStart(kNoStateId);
+  }
+
+  // Adds a state, reusing one removed by ClearStates() if available.
+  StateId AddSpareState() {
+    if (spare_states_.empty()) return AddState();
+    states_.push_back(spare_states_.back());
+    spare_states_.pop_back();
+    return states_.size() - 1;
+  }
+
+  // Destroys the states kept for reuse beyond the first N.
+  void TrimSpareStates(size_t n) {
+    while (spare_states_.size() > n) {
+      State::Destroy(spare_states_.back(), &state_alloc_);
+      spare_states_.pop_back();
+    }
+  }
+
   void DeleteArcs(StateId s, size_t n) { states_[s]->DeleteArcs(n); }
 
   void DeleteArcs(StateId s) { states_[s]->DeleteArcs(); }
@@ -238,6 +302,7 @@ class VectorFstBaseImpl : public FstImpl<typename S::Arc> {
 
  private:
   std::vector<State *> states_;                 // States represenation.
+  std::vector<State *> spare_states_;           // Cleared states for reuse.
   StateId start_;                               // initial state
   typename State::StateAllocator state_alloc_;  // for state allocation
   typename State::ArcAllocator arc_alloc_;      // for arc allocation
@@ -258,11 +323,13 @@ class VectorFstImpl : public VectorFstBaseImpl<S> {
   using FstImpl<A>::SetType;
   using FstImpl<A>::SetProperties;
   using FstImpl<A>::Properties;
+  using FstImpl<A>::ReadHeader;
 
   using VectorFstBaseImpl<S>::Start;
   using VectorFstBaseImpl<S>::NumStates;
   using VectorFstBaseImpl<S>::GetState;
   using VectorFstBaseImpl<S>::ReserveArcs;
+  using VectorFstBaseImpl<S>::ReserveStates;
 
   friend class MutableArcIterator<VectorFst<A, S>>;
 
@@ -279,6 +346,10 @@ class VectorFstImpl : public VectorFstBaseImpl<S> {
 
   static VectorFstImpl<S> *Read(std::istream &strm, const FstReadOptions &opts);
 
+  // Reads into this implementation, replacing its contents but reusing the
+  // storage of its current states and their arcs. Returns false on error.
+  bool ReadInPlace(std::istream &strm, const FstReadOptions &opts);
+
   void SetStart(StateId s) {
     BaseImpl::SetStart(s);
     SetProperties(SetStartProperties(Properties()));
@@ -329,6 +400,13 @@ class VectorFstImpl : public VectorFstBaseImpl<S> {
   static const uint64 kStaticProperties = kExpanded | kMutable;
 
  private:
+  // Reads the narcs arcs of state s, which has none yet, as a single block
+  // straight into its arcs when the arc type permits it (see
+  // internal::IsBulkSerializableArc).
+  bool ReadArcs(std::istream &strm, StateId s, size_t narcs, std::true_type);
+
+  bool ReadArcs(std::istream &strm, StateId s, size_t narcs, std::false_type);
+
   // Current file format version
   static const int kFileVersion = 2;
   // Minimum file format version supported
@@ -369,47 +447,74 @@ template <class S>
 VectorFstImpl<S> *VectorFstImpl<S>::Read(std::istream &strm,
                                          const FstReadOptions &opts) {
   std::unique_ptr<VectorFstImpl<S>> impl(new VectorFstImpl());
+  return impl->ReadInPlace(strm, opts) ? impl.release() : nullptr;
+}
+
+template <class S>
+bool VectorFstImpl<S>::ReadInPlace(std::istream &strm,
+                                   const FstReadOptions &opts) {
+  BaseImpl::ClearStates();
+  SetInputSymbols(nullptr);
+  SetOutputSymbols(nullptr);
   FstHeader hdr;
-  if (!impl->ReadHeader(strm, opts, kMinFileVersion, &hdr)) {
-    return nullptr;
-  }
-  impl->BaseImpl::SetStart(hdr.Start());
+  if (!ReadHeader(strm, opts, kMinFileVersion, &hdr)) return false;
+  BaseImpl::SetStart(hdr.Start());
   if (hdr.NumStates() != kNoStateId) {
-    impl->ReserveStates(hdr.NumStates());
+    BaseImpl::TrimSpareStates(hdr.NumStates());
+    ReserveStates(hdr.NumStates());
   }
 
   StateId s = 0;
   for (; hdr.NumStates() == kNoStateId || s < hdr.NumStates(); ++s) {
     typename A::Weight final;
     if (!final.Read(strm)) break;
-    impl->BaseImpl::AddState();
-    State *state = impl->GetState(s);
+    BaseImpl::AddSpareState();
+    State *state = GetState(s);
     state->SetFinal(final);
     int64 narcs;
     ReadType(strm, &narcs);
     if (!strm) {
       LOG(ERROR) << "VectorFst::Read: Read failed: " << opts.source;
-      return nullptr;
+      return false;
     }
-    impl->ReserveArcs(s, narcs);
-    for (size_t j = 0; j < narcs; ++j) {
-      A arc;
-      ReadType(strm, &arc.ilabel);
-      ReadType(strm, &arc.olabel);
-      arc.weight.Read(strm);
-      ReadType(strm, &arc.nextstate);
-      if (!strm) {
-        LOG(ERROR) << "VectorFst::Read: Read failed: " << opts.source;
-        return nullptr;
-      }
-      impl->BaseImpl::AddArc(s, arc);
+    if (!ReadArcs(strm, s, narcs, internal::IsBulkSerializableArc<A>())) {
+      LOG(ERROR) << "VectorFst::Read: Read failed: " << opts.source;
+      return false;
     }
   }
   if (hdr.NumStates() != kNoStateId && s != hdr.NumStates()) {
     LOG(ERROR) << "VectorFst::Read: Unexpected end of file: " << opts.source;
-    return nullptr;
+    return false;
+  }
+  return true;
+}
+
+template <class S>
+bool VectorFstImpl<S>::ReadArcs(std::istream &strm, StateId s, size_t narcs,
+                                std::true_type) {
+  if (narcs == 0) return true;
+  State *state = GetState(s);
+  state->ResizeArcs(narcs);
+  strm.read(reinterpret_cast<char *>(state->MutableArcs()), narcs * sizeof(A));
+  if (!strm) return false;
+  state->SetArcs();
+  return true;
+}
+
+template <class S>
+bool VectorFstImpl<S>::ReadArcs(std::istream &strm, StateId s, size_t narcs,
+                                std::false_type) {
+  ReserveArcs(s, narcs);
+  for (size_t j = 0; j < narcs; ++j) {
+    A arc;
+    ReadType(strm, &arc.ilabel);
+    ReadType(strm, &arc.olabel);
+    arc.weight.Read(strm);
+    ReadType(strm, &arc.nextstate);
+    if (!strm) return false;
+    BaseImpl::AddArc(s, arc);
   }
-  return impl.release();
+  return true;
 }
 
 // Converts a string into a weight.
@@ -499,6 +604,15 @@ class VectorFst : public ImplToMutableFst<VectorFstImpl<S>> {
     return impl ? new VectorFst<A, S>(std::shared_ptr<Impl>(impl)) : nullptr;
   }
 
+  // Reads a VectorFst from an input stream into this FST, replacing its
+  // contents. Unless the implementation is shared with a copy, the storage of
+  // the current states and arcs is reused, so rereading FSTs of similar size
+  // does not allocate. Returns false on error.
+  bool ReadInPlace(std::istream &strm, const FstReadOptions &opts) {
+    if (!Unique()) SetImpl(std::make_shared<Impl>());
+    return GetMutableImpl()->ReadInPlace(strm, opts);
+  }
+
   bool Write(std::ostream &strm, const FstWriteOptions &opts) const override {
     return WriteFst(*this, strm, opts);
   }
@@ -526,9 +640,22 @@ class VectorFst : public ImplToMutableFst<VectorFstImpl<S>> {
   using ImplToMutableFst<Impl, MutableFst<A>>::ReserveStates;
 
  private:
+  // Writes the arcs of state s, as a single block when the arc type permits
+  // it (see internal::IsBulkSerializableArc); buffer is scratch space reused
+  // across states.
+  template <class F>
+  static void WriteArcs(const F &fst, StateId s, std::ostream &strm,
+                        std::vector<A> *buffer, std::true_type);
+
+  template <class F>
+  static void WriteArcs(const F &fst, StateId s, std::ostream &strm,
+                        std::vector<A> *buffer, std::false_type);
+
   using ImplToMutableFst<Impl, MutableFst<A>>::GetImpl;
+  using ImplToMutableFst<Impl, MutableFst<A>>::GetMutableImpl;
   using ImplToMutableFst<Impl, MutableFst<A>>::MutateCheck;
   using ImplToMutableFst<Impl, MutableFst<A>>::SetImpl;
+  using ImplToMutableFst<Impl, MutableFst<A>>::Unique;
 
   explicit VectorFst(std::shared_ptr<Impl> impl)
       : ImplToMutableFst<Impl>(impl) {}
@@ -579,19 +706,14 @@ bool VectorFst<A, S>::WriteFst(const F &fst, std::ostream &strm,
       fst.Properties(kCopyProperties, false) | Impl::kStaticProperties;
   FstImpl<A>::WriteFstHeader(fst, strm, opts, kFileVersion, "vector",
                              properties, &hdr);
+  std::vector<A> buffer;
   StateId num_states = 0;
   for (StateIterator<F> siter(fst); !siter.Done(); siter.Next()) {
     typename A::StateId s = siter.Value();
     fst.Final(s).Write(strm);
     int64 narcs = fst.NumArcs(s);
     WriteType(strm, narcs);
-    for (ArcIterator<F> aiter(fst, s); !aiter.Done(); aiter.Next()) {
-      const A &arc = aiter.Value();
-      WriteType(strm, arc.ilabel);
-      WriteType(strm, arc.olabel);
-      arc.weight.Write(strm);
-      WriteType(strm, arc.nextstate);
-    }
+    WriteArcs(fst, s, strm, &buffer, internal::IsBulkSerializableArc<A>());
     num_states++;
   }
   strm.flush();
@@ -612,6 +734,32 @@ bool VectorFst<A, S>::WriteFst(const F &fst, std::ostream &strm,
   return true;
 }
 
+template <class A, class S>
+template <class F>
+void VectorFst<A, S>::WriteArcs(const F &fst, StateId s, std::ostream &strm,
+                                std::vector<A> *buffer, std::true_type) {
+  buffer->clear();
+  for (ArcIterator<F> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+    buffer->push_back(aiter.Value());
+  }
+  if (buffer->empty()) return;
+  strm.write(reinterpret_cast<const char *>(buffer->data()),
+             buffer->size() * sizeof(A));
+}
+
+template <class A, class S>
+template <class F>
+void VectorFst<A, S>::WriteArcs(const F &fst, StateId s, std::ostream &strm,
+                                std::vector<A> *buffer, std::false_type) {
+  for (ArcIterator<F> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+    const A &arc = aiter.Value();
+    WriteType(strm, arc.ilabel);
+    WriteType(strm, arc.olabel);
+    arc.weight.Write(strm);
+    WriteType(strm, arc.nextstate);
+  }
+}
+
 // Specialization for VectorFst; see generic version in fst.h
 // for sample usage (but use the VectorFst type!). This version
 // should inline.
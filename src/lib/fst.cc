@@ -7,6 +7,8 @@
 
 #include <sstream>
 
+#include <fst/lock.h>
+
 // Include these so they are registered
 #include <fst/compact-fst.h>
 #include <fst/const-fst.h>
@@ -42,6 +44,13 @@ DEFINE_string(save_relabel_opairs, "", "Save output relabel pairs to file");
 DEFINE_string(fst_read_mode, "read",
               "Default file reading mode for mappable files");
 
+DEFINE_string(fst_map_advice, "normal",
+              "Access advice for memory-mapped files: one of: \"normal\", "
+              "\"random\", \"willneed\", \"prefault\"");
+
+DEFINE_bool(fst_map_hugepages, false,
+            "Request transparent huge pages for memory-mapped files");
+
 namespace fst {
 
 // Register VectorFst, ConstFst and EditFst for common arcs types
@@ -142,6 +151,27 @@ string FstHeader::DebugString() const {
   return ostrm.str();
 }
 
+namespace {
+
+// Returns the map advice named by --fst_map_advice. The flag is parsed again
+// only when its value changes, so an unknown value is reported once and is
+// then quietly taken as "normal".
+MappedFile::Advice FlagMapAdvice() {
+  static Mutex mutex;
+  static bool parsed = false;
+  static string flag;
+  static MappedFile::Advice advice = MappedFile::ADVICE_NORMAL;
+  MutexLock lock(&mutex);
+  if (!parsed || flag != FLAGS_fst_map_advice) {
+    flag = FLAGS_fst_map_advice;
+    advice = FstReadOptions::MapAdvice(flag);
+    parsed = true;
+  }
+  return advice;
+}
+
+}  // namespace
+
 FstReadOptions::FstReadOptions(const string &src, const FstHeader *hdr,
                                const SymbolTable *isym, const SymbolTable *osym)
     : source(src),
@@ -149,8 +179,10 @@ FstReadOptions::FstReadOptions(const string &src, const FstHeader *hdr,
       isymbols(isym),
       osymbols(osym),
       read_isymbols(true),
-      read_osymbols(true) {
+      read_osymbols(true),
+      map_hugepages(FLAGS_fst_map_hugepages) {
   mode = ReadMode(FLAGS_fst_read_mode);
+  map_advice = FlagMapAdvice();
 }
 
 FstReadOptions::FstReadOptions(const string &src, const SymbolTable *isym,
@@ -160,8 +192,10 @@ FstReadOptions::FstReadOptions(const string &src, const SymbolTable *isym,
       isymbols(isym),
       osymbols(osym),
       read_isymbols(true),
-      read_osymbols(true) {
+      read_osymbols(true),
+      map_hugepages(FLAGS_fst_map_hugepages) {
   mode = ReadMode(FLAGS_fst_read_mode);
+  map_advice = FlagMapAdvice();
 }
 
 FstReadOptions::FileReadMode FstReadOptions::ReadMode(const string &mode) {
@@ -175,12 +209,23 @@ FstReadOptions::FileReadMode FstReadOptions::ReadMode(const string &mode) {
   return READ;
 }
 
+MappedFile::Advice FstReadOptions::MapAdvice(const string &advice) {
+  if (advice == "normal") return MappedFile::ADVICE_NORMAL;
+  if (advice == "random") return MappedFile::ADVICE_RANDOM;
+  if (advice == "willneed") return MappedFile::ADVICE_WILLNEED;
+  if (advice == "prefault") return MappedFile::ADVICE_PREFAULT;
+  LOG(ERROR) << "Unknown map advice " << advice;
+  return MappedFile::ADVICE_NORMAL;
+}
+
 string FstReadOptions::DebugString() const {
   std::ostringstream ostrm;
   ostrm << "source: \"" << source << "\" mode: \""
         << (mode == READ ? "READ" : "MAP") << "\" read_isymbols: \""
         << (read_isymbols ? "true" : "false") << "\" read_osymbols: \""
-        << (read_osymbols ? "true" : "false") << "\" header: \""
+        << (read_osymbols ? "true" : "false") << "\" map_advice: \""
+        << map_advice << "\" map_hugepages: \""
+        << (map_hugepages ? "true" : "false") << "\" header: \""
         << (header ? "set" : "null") << "\" isymbols: \""
         << (isymbols ? "set" : "null") << "\" osymbols: \""
         << (osymbols ? "set" : "null") << "\"";
@@ -16,6 +16,24 @@
 static const size_t kMaxReadChunk = 256 * 1024 * 1024;  // 256 MB
 
 namespace fst {
+namespace {
+
+// Passes advice on the pages of [addr, addr + size) to the kernel, leaving
+// out the partial pages at both ends; failures are only logged, since the
+// advice does not affect correctness.
+void Advise(void* addr, size_t size, int advice, const char* name) {
+  const size_t pagesize = sysconf(_SC_PAGESIZE);
+  size_t begin = reinterpret_cast<size_t>(addr);
+  size_t end = begin + size;
+  begin = (begin + pagesize - 1) / pagesize * pagesize;
+  end = end / pagesize * pagesize;
+  if (begin >= end) return;
+  if (madvise(reinterpret_cast<void*>(begin), end - begin, advice) != 0) {
+    VLOG(1) << "madvise(" << name << ") failed: " << strerror(errno);
+  }
+}
+
+}  // namespace
 
 // Alignment required for mapping structures (in bytes.)  Regions of memory
 // that are not aligned upon a 128 bit boundary will be read from the file
@@ -65,7 +83,8 @@ MappedFile* MappedFile::Borrow(void* data) {
 }
 
 MappedFile* MappedFile::Map(std::istream* s, bool memorymap,
-                            const string& source, size_t size) {
+                            const string& source, size_t size, Advice advice,
+                            bool hugepages) {
   std::streampos spos = s->tellg();
   VLOG(1) << "memorymap: " << (memorymap ? "true" : "false") << " source: \""
           << source << "\""
@@ -77,10 +96,21 @@ MappedFile* MappedFile::Map(std::istream* s, bool memorymap,
       int pagesize = sysconf(_SC_PAGESIZE);
       off_t offset = pos % pagesize;
       off_t upsize = size + offset;
-      void* map =
-          mmap(nullptr, upsize, PROT_READ, MAP_SHARED, fd, pos - offset);
+      int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+      if (advice == ADVICE_PREFAULT) flags |= MAP_POPULATE;
+#endif  // MAP_POPULATE
+      void* map = mmap(nullptr, upsize, PROT_READ, flags, fd, pos - offset);
       char* data = reinterpret_cast<char*>(map);
       if (close(fd) == 0 && map != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+        if (hugepages) Advise(map, upsize, MADV_HUGEPAGE, "MADV_HUGEPAGE");
+#endif  // MADV_HUGEPAGE
+        if (advice == ADVICE_RANDOM) {
+          Advise(map, upsize, MADV_RANDOM, "MADV_RANDOM");
+        } else if (advice == ADVICE_WILLNEED) {
+          Advise(map, upsize, MADV_WILLNEED, "MADV_WILLNEED");
+        }
         MemoryRegion region;
         region.mmap = map;
         region.size = upsize;
@@ -107,6 +137,9 @@ MappedFile* MappedFile::Map(std::istream* s, bool memorymap,
   // Read the file into the buffer in chunks not larger than kMaxReadChunk.
   std::unique_ptr<MappedFile> mf(Allocate(size));
   char* buffer = reinterpret_cast<char*>(mf->mutable_data());
+#ifdef MADV_HUGEPAGE
+  if (hugepages) Advise(buffer, size, MADV_HUGEPAGE, "MADV_HUGEPAGE");
+#endif  // MADV_HUGEPAGE
   while (size > 0) {
     const size_t next_size = std::min(size, kMaxReadChunk);
     std::streampos current_pos = s->tellg();
@@ -99,6 +99,8 @@ bool GetQueueType(const string &str, QueueType *queue_type) {
     *queue_type = FIFO_QUEUE;
   } else if (str == "lifo") {
     *queue_type = LIFO_QUEUE;
+  } else if (str == "radix") {
+    *queue_type = RADIX_QUEUE;
   } else if (str == "shortest") {
     *queue_type = SHORTEST_FIRST_QUEUE;
   } else if (str == "state") {
@@ -127,5 +129,18 @@ bool GetReplaceLabelType(const string &str, bool epsilon_on_replace,
   return true;
 }
 
+bool GetStateReorderType(const string &str, StateReorderType *reorder_type) {
+  if (str == "bfs") {
+    *reorder_type = BFS_STATE_REORDER;
+  } else if (str == "dfs") {
+    *reorder_type = DFS_STATE_REORDER;
+  } else if (str == "profile") {
+    *reorder_type = PROFILE_STATE_REORDER;
+  } else {
+    return false;
+  }
+  return true;
+}
+
 }  // namespace script
 }  // namespace fst
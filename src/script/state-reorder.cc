@@ -0,0 +1,37 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+#include <fst/script/state-reorder.h>
+
+namespace fst {
+namespace script {
+
+bool StateReorder(MutableFstClass *fst, StateReorderType type,
+                  const std::vector<size_t> *counts,
+                  std::vector<int64> *order) {
+  StateReorderInnerArgs iargs(fst, type, counts, order);
+  StateReorderArgs args(iargs);
+  Apply<Operation<StateReorderArgs>>("StateReorder", fst->ArcType(), &args);
+  return args.retval;
+}
+
+double ArcPageLocality(const FstClass &fst, size_t states_per_page) {
+  ArcPageLocalityInnerArgs iargs(fst, states_per_page);
+  ArcPageLocalityArgs args(iargs);
+  Apply<Operation<ArcPageLocalityArgs>>("ArcPageLocality", fst.ArcType(),
+                                        &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION(StateReorder, StdArc, StateReorderArgs);
+REGISTER_FST_OPERATION(StateReorder, LogArc, StateReorderArgs);
+REGISTER_FST_OPERATION(StateReorder, Log64Arc, StateReorderArgs);
+
+REGISTER_FST_OPERATION(ArcPageLocality, StdArc, ArcPageLocalityArgs);
+REGISTER_FST_OPERATION(ArcPageLocality, LogArc, ArcPageLocalityArgs);
+REGISTER_FST_OPERATION(ArcPageLocality, Log64Arc, ArcPageLocalityArgs);
+
+}  // namespace script
+}  // namespace fst
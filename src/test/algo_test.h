@@ -65,6 +65,47 @@ void LookAheadCompose(const Fst<StdArc> &ifst1, const Fst<StdArc> &ifst2,
   }
 }
 
+// Replace state table that stores whole stack prefixes and defines only the
+// required interface, so ReplaceFst has to fall back to GetStackPrefix() and
+// FindPrefixId() to push and pop prefixes.
+template <class A, class P = ssize_t>
+class FullPrefixReplaceStateTable
+    : public CompactHashStateTable<ReplaceStateTuple<typename A::StateId, P>,
+                                   ReplaceHash<typename A::StateId, P>> {
+ public:
+  typedef A Arc;
+  typedef typename A::StateId StateId;
+  typedef typename A::Label Label;
+  typedef P PrefixId;
+  typedef ReplaceStateTuple<StateId, P> StateTuple;
+  typedef CompactHashStateTable<StateTuple, ReplaceHash<StateId, PrefixId>>
+      StateTable;
+  typedef ReplaceStackPrefix<Label, StateId> StackPrefix;
+
+  using StateTable::FindState;
+  using StateTable::Tuple;
+
+  FullPrefixReplaceStateTable(
+      const std::vector<std::pair<Label, const Fst<A> *>> &fst_tuples,
+      Label root) {}
+
+  FullPrefixReplaceStateTable(const FullPrefixReplaceStateTable<A, P> &table)
+      : StateTable(), prefix_table_(table.prefix_table_) {}
+
+  PrefixId FindPrefixId(const StackPrefix &prefix) {
+    return prefix_table_.FindId(prefix);
+  }
+
+  const StackPrefix &GetStackPrefix(PrefixId id) const {
+    return prefix_table_.FindEntry(id);
+  }
+
+ private:
+  CompactHashBiTable<PrefixId, StackPrefix,
+                     ReplaceStackPrefixHash<Label, StateId>>
+      prefix_table_;
+};
+
 // This class tests a variety of identities and properties that must
 // hold for various algorithms on weighted FSTs.
 template <class Arc, class WeightGenerator>
@@ -89,6 +130,8 @@ class WeightedTester {
     TestSort(T1);
     TestOptimize(T1);
     TestSearch(T1);
+    TestReplace(T1, T2);
+    TestReplaceMatcher(T1, T2, T3);
   }
 
  private:
@@ -582,6 +625,23 @@ class WeightedTester {
       CHECK(Equiv(T, S1));
     }
 
+    {
+      VLOG(1) << "Check locality-reordered Fsts are equivalent to their input.";
+      VectorFst<Arc> S1(T);
+      CHECK(StateReorder(&S1, BFS_STATE_REORDER));
+      CHECK(Equiv(T, S1));
+
+      VectorFst<Arc> S2(T);
+      CHECK(StateReorder(&S2, DFS_STATE_REORDER));
+      CHECK(Equiv(T, S2));
+
+      VectorFst<Arc> S3(T);
+      std::vector<size_t> counts(S3.NumStates(), 0);
+      for (size_t s = 0; s < counts.size(); s += 2) counts[s] = 1;
+      CHECK(StateReorder(&S3, PROFILE_STATE_REORDER, &counts));
+      CHECK(Equiv(T, S3));
+    }
+
     {
       VLOG(1) << "Check reverse(reverse(T)) = T";
       for (int i = 0; i < 2; ++i) {
@@ -702,6 +762,15 @@ class WeightedTester {
         n = M.NumStates();
       }
 
+      {
+        VLOG(1) << "Check min(det(A)) with a flat partition has the same"
+                << " number of states and is equiv det(A)";
+        VectorFst<Arc> M(D);
+        Minimize<Arc, FlatPartition<StateId>>(&M);
+        CHECK(Equiv(D, M));
+        CHECK_EQ(n, M.NumStates());
+      }
+
       if (n && (wprops & kIdempotent) == kIdempotent &&
           A.Properties(kNoEpsilons, true)) {
         VLOG(1) << "Check that Revuz's algorithm leads to the"
@@ -878,6 +947,242 @@ class WeightedTester {
         }
       }
     }
+
+    TestRadixQueue(T, std::is_same<Weight, TropicalWeight>());
+  }
+
+  // Tests that shortest distances computed with RadixQueue are those
+  // computed with NaturalShortestFirstQueue; tropical weights only.
+  void TestRadixQueue(const Fst<Arc> &T, std::true_type) {
+    VLOG(1) << "Check radix queue distances";
+    typedef NaturalShortestFirstQueue<StateId, Weight> NaturalQueue;
+    typedef RadixQueue<StateId, Weight> Queue;
+    std::vector<Weight> ndistance;
+    NaturalQueue nqueue(ndistance);
+    ShortestDistanceOptions<Arc, NaturalQueue, AnyArcFilter<Arc>> nopts(
+        &nqueue, AnyArcFilter<Arc>());
+    ShortestDistance(T, &ndistance, nopts);
+    std::vector<Weight> distance;
+    Queue queue(distance);
+    ShortestDistanceOptions<Arc, Queue, AnyArcFilter<Arc>> opts(
+        &queue, AnyArcFilter<Arc>());
+    ShortestDistance(T, &distance, opts);
+    CHECK_EQ(distance.size(), ndistance.size());
+    for (size_t s = 0; s < distance.size(); ++s) {
+      CHECK(ApproxEqual(distance[s], ndistance[s], kTestDelta));
+    }
+
+    // A single SCC large enough for AutoQueue to pick RadixQueue.
+    VectorFst<Arc> ring;
+    const StateId kNumRingStates = 100;
+    for (StateId s = 0; s < kNumRingStates; ++s) ring.AddState();
+    ring.SetStart(0);
+    for (StateId s = 0; s < kNumRingStates; ++s) {
+      ring.AddArc(s, Arc(1, 1, Weight(rand() % 10),
+                         (s + 1) % kNumRingStates));
+      for (int i = 0; i < 3; ++i) {
+        ring.AddArc(s, Arc(1, 1, Weight(rand() % 10),
+                           rand() % kNumRingStates));
+      }
+    }
+    std::vector<Weight> rdistance;
+    ShortestDistance(ring, &rdistance);
+    ndistance.clear();
+    NaturalQueue rqueue(ndistance);
+    ShortestDistanceOptions<Arc, NaturalQueue, AnyArcFilter<Arc>> ropts(
+        &rqueue, AnyArcFilter<Arc>());
+    ShortestDistance(ring, &ndistance, ropts);
+    CHECK_EQ(rdistance.size(), ndistance.size());
+    for (size_t s = 0; s < rdistance.size(); ++s) {
+      CHECK(ApproxEqual(rdistance[s], ndistance[s], kTestDelta));
+    }
+  }
+
+  void TestRadixQueue(const Fst<Arc> &T, std::false_type) {}
+
+  // Tests replace-based operations on a grammar whose rules nest
+  // kReplaceDepth deep: rule i accepts T1 | rule(i + 1) T2 and the last
+  // rule accepts T1.
+  void TestReplace(const Fst<Arc> &T1, const Fst<Arc> &T2) {
+    const Label kNonTerminal = 1000;  // Beyond the random labels.
+    VectorFst<Arc> call;
+    call.AddState();
+    call.AddState();
+    call.SetStart(0);
+    call.SetFinal(1, Weight::One());
+    std::vector<VectorFst<Arc>> rules(kReplaceDepth, VectorFst<Arc>(T1));
+    for (int i = 0; i + 1 < kReplaceDepth; ++i) {
+      call.DeleteArcs(0);
+      call.AddArc(0, Arc(kNonTerminal + i + 1, kNonTerminal + i + 1,
+                         Weight::One(), 1));
+      VectorFst<Arc> recursion(call);
+      Concat(&recursion, T2);
+      Union(&rules[i], recursion);
+    }
+    std::vector<std::pair<Label, const Fst<Arc> *>> fst_tuples;
+    for (int i = 0; i < kReplaceDepth; ++i) {
+      fst_tuples.push_back(std::make_pair(kNonTerminal + i, &rules[i]));
+    }
+
+    // Expands the grammar bottom-up with the rational operations.
+    VectorFst<Arc> expanded(T1);
+    for (int i = kReplaceDepth - 2; i >= 0; --i) {
+      Concat(&expanded, T2);
+      Union(&expanded, T1);
+    }
+
+    VectorFst<Arc> replaced;
+    Replace(fst_tuples, &replaced, kNonTerminal, true);
+
+    {
+      VLOG(1) << "Check eager and delayed replace are equivalent.";
+      ReplaceFst<Arc> R(fst_tuples, ReplaceFstOptions<Arc>(kNonTerminal, true));
+      CHECK(Equiv(R, expanded));
+      CHECK(Equiv(replaced, expanded));
+      CHECK(Equal(replaced, VectorFst<Arc>(R)));
+    }
+
+    {
+      VLOG(1) << "Check delayed replace with garbage collection.";
+      typedef GCCacheStore<VectorCacheStore<CacheState<Arc>>> Store;
+      ReplaceFstOptions<Arc, DefaultReplaceStateTable<Arc>, Store> opts(
+          CacheOptions(true, 0), kNonTerminal);
+      opts.call_label_type = REPLACE_LABEL_NEITHER;
+      opts.call_output_label = 0;
+      ReplaceFst<Arc, DefaultReplaceStateTable<Arc>, Store> R(fst_tuples,
+                                                               opts);
+      CHECK(Equiv(R, expanded));
+      CHECK(Equal(replaced, VectorFst<Arc>(R)));
+    }
+
+    {
+      VLOG(1) << "Check delayed replace with a vector hash state table.";
+      typedef VectorHashReplaceStateTable<Arc> Table;
+      ReplaceFstOptions<Arc, Table> opts(kNonTerminal, true);
+      ReplaceFst<Arc, Table> R(fst_tuples, opts);
+      CHECK(Equiv(R, expanded));
+    }
+
+    {
+      VLOG(1) << "Check delayed replace with a full prefix state table.";
+      typedef FullPrefixReplaceStateTable<Arc> Table;
+      ReplaceFstOptions<Arc, Table> opts(kNonTerminal, true);
+      ReplaceFst<Arc, Table> R(fst_tuples, opts);
+      CHECK(Equiv(R, expanded));
+      CHECK(Equal(replaced, VectorFst<Arc>(R)));
+    }
+  }
+
+  // Tests the replace matcher against the fully expanded replace on a
+  // grammar whose rule i accepts (rule(i + 1) | epsilon | 1) T2 | T1, so
+  // only some component states have non-terminal arcs. The non-terminals
+  // are negative, which keeps the replace label-sorted with epsilon calls,
+  // and are looked up either by the dense array or by the hash.
+  void TestReplaceMatcher(const Fst<Arc> &T1, const Fst<Arc> &T2,
+                          const Fst<Arc> &T3) {
+    if (!(Weight::Properties() & kCommutative)) return;
+
+    for (int sparse = 0; sparse < 2; ++sparse) {
+      // A dense range with gaps, or labels far apart.
+      const Label kStride = sparse ? 1000003 : 2;
+      std::vector<Label> nonterminals;
+      for (int i = 0; i < kReplaceMatcherRules; ++i) {
+        nonterminals.push_back(-2 - i * kStride);
+      }
+      for (int input = 0; input < 2; ++input) {
+        const MatchType match_type = input ? MATCH_INPUT : MATCH_OUTPUT;
+        VLOG(1) << "Check replace matcher ("
+                << (sparse ? "sparse" : "dense") << " non-terminals, "
+                << (input ? "input" : "output") << " matching).";
+        std::vector<VectorFst<Arc>> rules(kReplaceMatcherRules);
+        std::vector<std::pair<Label, const Fst<Arc> *>> fst_tuples;
+        for (int i = 0; i < kReplaceMatcherRules; ++i) {
+          VectorFst<Arc> &rule = rules[i];
+          rule.AddState();
+          rule.AddState();
+          rule.SetStart(0);
+          rule.SetFinal(1, Weight::One());
+          if (i + 1 < kReplaceMatcherRules) {
+            rule.AddArc(0, Arc(nonterminals[i + 1], nonterminals[i + 1],
+                               Weight::One(), 1));
+          }
+          rule.AddArc(0, Arc(0, 0, Weight::One(), 1));
+          rule.AddArc(0, Arc(1, 1, Weight::One(), 1));
+          Concat(&rule, T2);
+          Union(&rule, T1);
+          if (input) {
+            ArcSort(&rule, ILabelCompare<Arc>());
+          } else {
+            ArcSort(&rule, OLabelCompare<Arc>());
+          }
+          fst_tuples.push_back(std::make_pair(nonterminals[i], &rule));
+        }
+
+        ReplaceFst<Arc> R(fst_tuples,
+                          ReplaceFstOptions<Arc>(nonterminals[0], true));
+        std::unique_ptr<MatcherBase<Arc>> replace_matcher(
+            R.InitMatcher(match_type));
+        CHECK(replace_matcher != nullptr);
+
+        // Copying R assigns every state an ID in R's state table, so the
+        // copy has the same state numbering as R.
+        VectorFst<Arc> V(R);
+        VectorFst<Arc> replaced;
+        Replace(fst_tuples, &replaced, nonterminals[0], true);
+        CHECK(Equal(V, replaced));
+
+        // Besides the terminals, probes labels inside the non-terminal
+        // range that are not non-terminals and a label above it.
+        std::set<Label> labels = {0, kNoLabel, -3, -500000, 1000000};
+        for (StateIterator<Fst<Arc>> siter(V); !siter.Done(); siter.Next()) {
+          for (ArcIterator<Fst<Arc>> aiter(V, siter.Value()); !aiter.Done();
+               aiter.Next()) {
+            const Arc &arc = aiter.Value();
+            labels.insert(input ? arc.ilabel : arc.olabel);
+          }
+        }
+        SortedMatcher<Fst<Arc>> sorted_matcher(V, match_type);
+        for (StateIterator<Fst<Arc>> siter(V); !siter.Done(); siter.Next()) {
+          const StateId s = siter.Value();
+          replace_matcher->SetState(s);
+          sorted_matcher.SetState(s);
+          for (const Label label : labels) {
+            std::vector<Arc> arcs;
+            if (replace_matcher->Find(label)) {
+              for (; !replace_matcher->Done(); replace_matcher->Next()) {
+                arcs.push_back(replace_matcher->Value());
+              }
+            }
+            if (sorted_matcher.Find(label)) {
+              for (; !sorted_matcher.Done(); sorted_matcher.Next()) {
+                const Arc &arc = sorted_matcher.Value();
+                auto it = arcs.begin();
+                while (it != arcs.end() &&
+                       !(it->ilabel == arc.ilabel &&
+                         it->olabel == arc.olabel &&
+                         it->nextstate == arc.nextstate &&
+                         it->weight == arc.weight)) {
+                  ++it;
+                }
+                CHECK(it != arcs.end());
+                arcs.erase(it);
+              }
+            }
+            CHECK(arcs.empty());
+          }
+        }
+
+        if (input) {
+          ComposeFst<Arc> C1(T3, R);
+          ComposeFst<Arc> C2(T3, replaced);
+          CHECK(Equiv(C1, C2));
+        } else {
+          ComposeFst<Arc> C1(R, T3);
+          ComposeFst<Arc> C2(replaced, T3);
+          CHECK(Equiv(C1, C2));
+        }
+      }
+    }
   }
 
   // Tests if two FSTS are equivalent by checking if random
@@ -978,6 +1283,10 @@ class WeightedTester {
   static const int kNumShortestStates;
   // Delta for equivalence tests.
   static const float kTestDelta;
+  // Number of rules in the replace test grammar.
+  static const int kReplaceDepth;
+  // Number of rules in the replace matcher test grammar.
+  static const int kReplaceMatcherRules;
 
   WeightedTester(const WeightedTester &) = delete;
   WeightedTester &operator=(const WeightedTester &) = delete;
@@ -998,6 +1307,12 @@ const int WeightedTester<A, WG>::kNumShortestStates = 10000;
 template <class A, class WG>
 const float WeightedTester<A, WG>::kTestDelta = .05;
 
+template <class A, class WG>
+const int WeightedTester<A, WG>::kReplaceDepth = 64;
+
+template <class A, class WG>
+const int WeightedTester<A, WG>::kReplaceMatcherRules = 8;
+
 // This class tests a variety of identities and properties that must
 // hold for various algorithms on unweighted FSAs and that are not tested
 // by WeightedTester. Only the specialization does anything interesting.
@@ -5,6 +5,9 @@
 
 #include "./fst_test.h"
 
+#include <memory>
+#include <sstream>
+#include <string>
 #include <utility>
 
 #include <fst/compact-fst.h>
@@ -12,6 +15,8 @@
 #include <fst/edit-fst.h>
 #include <fst/matcher-fst.h>
 
+DECLARE_string(fst_map_advice);  // defined in ../lib/fst.cc
+
 namespace fst {
 namespace {
 
@@ -84,6 +89,124 @@ static fst::FstRegisterer<ConstFst<StdArc, uint16>>
 static fst::FstRegisterer<
     CompactFst<StdArc, CustomCompactor<StdArc>, uint16>>
     CompactFst_StdArc_CustomCompactor_uint16_registerer;
+static fst::FstRegisterer<
+    CompactFst<StdArc, CustomCompactor<StdArc>, uint32,
+               VarintCompactStore<CustomCompactor<StdArc>::Element, uint32>>>
+    CompactFst_StdArc_CustomCompactor_varint_registerer;
+
+// Checks two varint stores of the same FST against the default store while
+// accessing them in alternation, as composition does. Then checks that
+// reading a truncated or corrupt varint FST fails instead of decoding past
+// its data.
+void TestVarintCompactStore() {
+  typedef CustomCompactor<StdArc> Compactor;
+  typedef DefaultCompactStore<Compactor::Element, uint32> DefaultStore;
+  typedef VarintCompactStore<Compactor::Element, uint32> VarintStore;
+  VectorFst<StdArc> fst;
+  const int kNumStates = 100;
+  for (int s = 0; s < kNumStates; ++s) fst.AddState();
+  fst.SetStart(0);
+  for (int s = 0; s < kNumStates; ++s) {
+    // Every third state has no compacted transitions at all.
+    if (s % 3 == 2) continue;
+    for (int i = 0; i < s % 5; ++i) {
+      fst.AddArc(s, StdArc(i + 1, 0, s + i, s));
+    }
+    if (s % 3 == 0) fst.SetFinal(s, s);
+  }
+  const Compactor compactor;
+  const DefaultStore expected(fst, compactor);
+  const VarintStore store1(fst, compactor);
+  const VarintStore store2(fst, compactor);
+  for (int s = 0; s < kNumStates; ++s) {
+    for (const VarintStore *store : {&store1, &store2}) {
+      CHECK_EQ(store->States(s), expected.States(s));
+      CHECK_EQ(store->States(s + 1), expected.States(s + 1));
+    }
+    for (size_t i = expected.States(s); i < expected.States(s + 1); ++i) {
+      for (const VarintStore *store : {&store1, &store2}) {
+        CHECK(store->Compacts(i) == expected.Compacts(i));
+      }
+    }
+  }
+  for (size_t i = expected.NumCompacts(); i > 0; --i) {
+    CHECK(store1.Compacts(i - 1) == expected.Compacts(i - 1));
+    CHECK(store2.Compacts(i - 1) == expected.Compacts(i - 1));
+  }
+
+  typedef CompactFst<StdArc, Compactor, uint32, VarintStore> VarintFst;
+  std::ostringstream ostrm;
+  CHECK(VarintFst(fst).Write(ostrm, FstWriteOptions("varint")));
+  const string data = ostrm.str();
+  // The store starts with its element and byte counts, then holds the
+  // sampled offsets, two per kSampleInterval (32) states.
+  const uint64 counts[2] = {store1.NumCompacts(), store1.NumBytes()};
+  const size_t pos = data.find(
+      string(reinterpret_cast<const char *>(counts), sizeof(counts)));
+  CHECK_NE(pos, string::npos);
+  const size_t samples = pos + sizeof(counts);
+  auto read = [](const string &bytes) {
+    std::istringstream istrm(bytes);
+    std::unique_ptr<VarintFst> result(
+        VarintFst::Read(istrm, FstReadOptions("varint")));
+    return result != nullptr;
+  };
+  CHECK(read(data));
+  CHECK(!read(data.substr(0, data.size() - 1)));
+  auto corrupt = [&data](size_t offset, uint64 value) {
+    string bytes = data;
+    bytes.replace(offset, sizeof(value),
+                  reinterpret_cast<const char *>(&value), sizeof(value));
+    return bytes;
+  };
+  CHECK(!read(corrupt(pos + sizeof(uint64), kNumStates - 1)));  // Bytes.
+  CHECK(!read(corrupt(samples + 2 * sizeof(uint64), store1.NumBytes())));
+  CHECK(!read(corrupt(samples + 5 * sizeof(uint64), 0)));  // First element.
+  CHECK(!read(corrupt(pos, uint64{1} << 40)));  // Element count.
+}
+
+// Reuses one compact string FST across strings of differing lengths, as
+// FAR compilation does, checking it against a fresh FST after each refill.
+// A safe copy shares the store, which must then be left intact.
+template <class S>
+void TestCompactStringRefill() {
+  typedef CompactFst<StdArc, StringCompactor<StdArc>, uint32, S> StringFst;
+  const std::vector<std::vector<StdArc::Label>> strings = {
+      {1, 2, 3}, {4}, {}, {5, 6, 7, 8, 9}, {10, 11}};
+  StringFst fst;
+  std::unique_ptr<StringFst> copy;
+  for (size_t i = 0; i < strings.size(); ++i) {
+    fst.SetCompactElements(strings[i].begin(), strings[i].end());
+    const StringFst expected(strings[i].begin(), strings[i].end());
+    CHECK(Equal(fst, expected));
+    if (copy) {
+      const StringFst previous(strings[i - 1].begin(), strings[i - 1].end());
+      CHECK(Equal(*copy, previous));
+    }
+    copy.reset(i % 2 ? nullptr : fst.Copy(true));
+  }
+}
+
+// Checks that FstReadOptions takes the map advice from --fst_map_advice,
+// reporting an unknown value once rather than on every construction.
+void TestMapAdviceFlag() {
+  const string flag = FLAGS_fst_map_advice;
+  std::ostringstream log;
+  std::streambuf *cerr_buf = std::cerr.rdbuf(log.rdbuf());
+  FLAGS_fst_map_advice = "bogus";
+  for (int i = 0; i < 3; ++i) {
+    CHECK_EQ(FstReadOptions().map_advice, MappedFile::ADVICE_NORMAL);
+  }
+  FLAGS_fst_map_advice = "random";
+  CHECK_EQ(FstReadOptions().map_advice, MappedFile::ADVICE_RANDOM);
+  CHECK_EQ(FstReadOptions("source").map_advice, MappedFile::ADVICE_RANDOM);
+  std::cerr.rdbuf(cerr_buf);
+  const string errors = log.str();
+  const size_t pos = errors.find("Unknown map advice bogus");
+  CHECK_NE(pos, string::npos);
+  CHECK_EQ(errors.find("Unknown map advice", pos + 1), string::npos);
+  FLAGS_fst_map_advice = flag;
+}
 
 }  // namespace
 }  // namespace fst
@@ -97,6 +220,12 @@ using fst::Fst;
 using fst::StdArc;
 using fst::CustomArc;
 using fst::CustomCompactor;
+using fst::VarintCompactStore;
+using fst::TestVarintCompactStore;
+using fst::TestCompactStringRefill;
+using fst::TestMapAdviceFlag;
+using fst::DefaultCompactStore;
+using fst::StringCompactor;
 using fst::StdArcLookAheadFst;
 using fst::EditFst;
 
@@ -183,6 +312,27 @@ int main(int argc, char **argv) {
     std_compact_tester.TestIO();
   }
 
+  // CompactFst<StdArc, CustomCompactor<StdArc>, uint32, VarintCompactStore>
+  {
+    FstTester<CompactFst<
+        StdArc, CustomCompactor<StdArc>, uint32,
+        VarintCompactStore<CustomCompactor<StdArc>::Element, uint32>>>
+        std_compact_tester;
+    std_compact_tester.TestBase();
+    std_compact_tester.TestExpanded();
+    std_compact_tester.TestCopy();
+    std_compact_tester.TestIO();
+    TestVarintCompactStore();
+  }
+
+  // CompactFst<StdArc, StringCompactor<StdArc>> reused across strings
+  {
+    TestCompactStringRefill<
+        DefaultCompactStore<StringCompactor<StdArc>::Element, uint32>>();
+    TestCompactStringRefill<
+        VarintCompactStore<StringCompactor<StdArc>::Element, uint32>>();
+  }
+
   // FstTester<StdArcLookAheadFst>
   {
     FstTester<StdArcLookAheadFst> std_matcher_tester;
@@ -201,6 +351,8 @@ int main(int argc, char **argv) {
     std_edit_tester.TestMutable();
   }
 
+  TestMapAdviceFlag();
+
   std::cout << "PASS" << std::endl;
 
   return 0;
@@ -0,0 +1,237 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for linear FSTs. Checks that files written by older
+// versions, whose feature tries use the hash map layout, are still read
+// correctly, that compiled tries are read back from their edge list, and
+// that LinearTagger agrees with the shortest path through the
+// composition with LinearTaggerFst.
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fst/extensions/linear/linear-fst-data-builder.h>
+#include <fst/extensions/linear/linear-fst.h>
+#include <fst/extensions/linear/linear-tagger.h>
+#include <fst/fstlib.h>
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "testdata"
+#endif
+
+DEFINE_string(testdata, TEST_DATA_DIR, "directory of the test data files");
+DEFINE_int32(max_length, 5, "maximum length of the tagged sentences");
+
+namespace fst {
+namespace {
+
+const size_t kNumClasses = 2;
+
+// Builds a tagger over words {1, 2, 3} and tags {1, 2} with a unigram,
+// a bigram and a look-ahead feature group. The models are the ones
+// written to the test data files with the file versions preceding the
+// compiled trie (tagger version 1, classifier version 0).
+LinearFstData<StdArc> *MakeTaggerData() {
+  LinearFstDataBuilder<StdArc> builder;
+  for (int word = 1; word <= 3; ++word) {
+    CHECK(builder.AddWord(word, std::vector<StdArc::Label>(1, word)));
+  }
+  const int unigram = builder.AddGroup(0);
+  const int bigram = builder.AddGroup(0);
+  const int lookahead = builder.AddGroup(1);
+  CHECK(builder.AddWeight(unigram, {1}, {1}, 1.5));
+  CHECK(builder.AddWeight(unigram, {1}, {2}, 2.25));
+  CHECK(builder.AddWeight(unigram, {2}, {2}, 0.5));
+  CHECK(builder.AddWeight(unigram, {3}, {1}, 0.75));
+  CHECK(builder.AddWeight(bigram, {}, {1, 1}, 1.0));
+  CHECK(builder.AddWeight(bigram, {}, {2, 1}, 0.25));
+  CHECK(builder.AddWeight(bigram, {2, 3}, {2, 2}, 3.0));
+  CHECK(builder.AddWeight(lookahead, {1, 2}, {1}, 0.125));
+  CHECK(builder.AddWeight(lookahead, {3, 1}, {2}, 2.0));
+  return builder.Dump();
+}
+
+// Builds a two-class classifier over words {1, 2, 3}.
+LinearFstData<StdArc> *MakeClassifierData() {
+  LinearClassifierFstDataBuilder<StdArc> builder(kNumClasses);
+  for (int word = 1; word <= 3; ++word) {
+    CHECK(builder.AddWord(word, std::vector<StdArc::Label>(1, word)));
+  }
+  const int group = builder.AddGroup();
+  CHECK(builder.AddWeight(group, {1}, 1, 0.5));
+  CHECK(builder.AddWeight(group, {2}, 2, 1.25));
+  CHECK(builder.AddWeight(group, {3}, 1, 2.0));
+  CHECK(builder.AddWeight(group, {3}, 2, 0.75));
+  return builder.Dump();
+}
+
+// Checks that the FST read from FILENAME is equal to FST.
+template <class F>
+void TestRead(const string &filename, const F &fst) {
+  const string path = FLAGS_testdata + "/" + filename;
+  VLOG(1) << "Check reading " << path;
+  std::unique_ptr<F> read_fst(F::Read(path));
+  CHECK(read_fst);
+  VectorFst<StdArc> vfst(fst);
+  VectorFst<StdArc> read_vfst(*read_fst);
+  CHECK(!read_vfst.Properties(kError, false));
+  CHECK(Equal(vfst, read_vfst));
+}
+
+// Checks that FST survives a round trip through the current file version.
+template <class F>
+void TestWriteRead(const F &fst) {
+  std::stringstream strm;
+  CHECK(fst.Write(strm, FstWriteOptions("linear_test")));
+  std::unique_ptr<F> read_fst(F::Read(strm, FstReadOptions("linear_test")));
+  CHECK(read_fst);
+  CHECK(Equal(VectorFst<StdArc>(fst), VectorFst<StdArc>(*read_fst)));
+}
+
+// Checks that a compiled trie topology survives a round trip through its
+// edge list, which is written in a canonical order, and that corrupt edge
+// lists are rejected.
+void TestTrieTopology() {
+  typedef CompiledTrieTopology<int, std::hash<int>> Topology;
+  Topology topology;
+  for (int label = 1; label <= 100; ++label) {
+    const int child = topology.Insert(topology.Root(), label);
+    topology.Insert(child, label);
+  }
+  std::stringstream strm;
+  topology.Write(strm);
+  const string written = strm.str();
+  Topology read_topology;
+  CHECK(read_topology.Read(strm));
+  CHECK(read_topology == topology);
+  CHECK_EQ(read_topology.NumNodes(), topology.NumNodes());
+
+  // The edges are written sorted by parent and label.
+  std::stringstream edges(written);
+  int64 num_edges;
+  ReadType(edges, &num_edges);
+  CHECK_EQ(num_edges, topology.NumNodes() - 1);
+  int prev_parent = -1;
+  int prev_label = 0;
+  for (int64 i = 0; i < num_edges; ++i) {
+    int parent, label, child;
+    ReadType(edges, &parent);
+    ReadType(edges, &label);
+    ReadType(edges, &child);
+    CHECK(edges);
+    CHECK(parent > prev_parent ||
+          (parent == prev_parent && label > prev_label));
+    prev_parent = parent;
+    prev_label = label;
+  }
+  std::stringstream rewritten;
+  read_topology.Write(rewritten);
+  CHECK(rewritten.str() == written);
+
+  // An edge to a node Id that does not exist, then a repeated edge.
+  const bool fst_error_fatal = FLAGS_fst_error_fatal;
+  FLAGS_fst_error_fatal = false;
+  for (const int child : {5, 1}) {
+    std::stringstream corrupt;
+    WriteType(corrupt, static_cast<int64>(2));
+    for (int i = 0; i < 2; ++i) {
+      WriteType(corrupt, topology.Root());
+      WriteType(corrupt, 1);
+      WriteType(corrupt, child + i);
+    }
+    CHECK(!Topology().Read(corrupt));
+  }
+  FLAGS_fst_error_fatal = fst_error_fatal;
+}
+
+// Builds the string acceptor of LABELS.
+void MakeString(const std::vector<StdArc::Label> &labels,
+                VectorFst<StdArc> *fst) {
+  fst->DeleteStates();
+  StdArc::StateId s = fst->AddState();
+  fst->SetStart(s);
+  for (const auto label : labels) {
+    const StdArc::StateId d = fst->AddState();
+    fst->AddArc(s, StdArc(label, label, TropicalWeight::One(), d));
+    s = d;
+  }
+  fst->SetFinal(s, TropicalWeight::One());
+}
+
+// Returns the weight of the shortest path through the composition of the
+// sentence WORDS with FST, restricted to the output TAGS if non-null.
+TropicalWeight ComposeWeight(const LinearTaggerFst<StdArc> &fst,
+                             const std::vector<StdArc::Label> &words,
+                             const std::vector<StdArc::Label> *tags) {
+  VectorFst<StdArc> sentence;
+  MakeString(words, &sentence);
+  VectorFst<StdArc> lattice(ComposeFst<StdArc>(sentence, fst));
+  if (tags) {
+    VectorFst<StdArc> output;
+    MakeString(*tags, &output);
+    ArcSort(&lattice, OLabelCompare<StdArc>());
+    lattice = ComposeFst<StdArc>(lattice, output);
+  }
+  return ShortestDistance(lattice);
+}
+
+// Checks that LinearTagger finds a shortest path through the composition
+// with FST on all sentences of at most FLAGS_max_length words. The tags are
+// checked by their weight, since the model has ties.
+void TestTagger(const LinearTaggerFst<StdArc> &fst) {
+  LinearTagger<StdArc> tagger(fst);
+  std::vector<StdArc::Label> words;
+  for (;;) {
+    std::vector<StdArc::Label> tags;
+    TropicalWeight weight;
+    const bool tagged = tagger.Tag(words, &tags, &weight);
+    const TropicalWeight expected = ComposeWeight(fst, words, nullptr);
+    CHECK_EQ(tagged, expected != TropicalWeight::Zero());
+    if (tagged) {
+      CHECK_EQ(tags.size(), words.size());
+      CHECK(ApproxEqual(weight, expected));
+      CHECK(ApproxEqual(ComposeWeight(fst, words, &tags), expected));
+    }
+    // Next sentence over the words {1, 2, 3}, in order of length.
+    size_t i = 0;
+    while (i < words.size() && words[i] == 3) words[i++] = 1;
+    if (i < words.size()) {
+      ++words[i];
+    } else if (static_cast<int>(words.size()) < FLAGS_max_length) {
+      words.push_back(1);
+    } else {
+      break;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  using fst::LinearClassifierFst;
+  using fst::LinearTaggerFst;
+  using fst::StdArc;
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  fst::TestTrieTopology();
+
+  LinearTaggerFst<StdArc> tagger(fst::MakeTaggerData());
+  fst::TestRead("linear_tagger_v1.fst", tagger);
+  fst::TestWriteRead(tagger);
+  fst::TestTagger(tagger);
+
+  LinearClassifierFst<StdArc> classifier(fst::MakeClassifierData(),
+                                         fst::kNumClasses);
+  fst::TestRead("linear_classifier_v0.fst", classifier);
+  fst::TestWriteRead(classifier);
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
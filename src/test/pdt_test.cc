@@ -0,0 +1,376 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for PDT expansion and shortest path. The test PDT for
+// expansion has an unbounded stack, so only the best-first expansion can
+// handle it. The shortest path is checked on random PDTs with a bounded
+// stack against the shortest path of their expansion, and the search data
+// table it uses is checked against std::map. Composition with open-paren
+// lookahead is checked against composition without it. The PDT and MPDT
+// paren stacks are checked against std::map.
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <fst/extensions/mpdt/mpdt.h>
+#include <fst/extensions/pdt/compose.h>
+#include <fst/extensions/pdt/expand.h>
+#include <fst/extensions/pdt/pdt.h>
+#include <fst/extensions/pdt/replace.h>
+#include <fst/extensions/pdt/shortest-path.h>
+#include <fst/fstlib.h>
+
+DEFINE_int32(max_depth, 4, "maximum recursion depth tested");
+DEFINE_int32(seed, 403, "random seed");
+DEFINE_int32(repeat, 10, "number of random PDTs tested per size");
+
+namespace fst {
+namespace {
+
+const StdArc::Label kA = 1;
+const StdArc::Label kB = 2;
+const StdArc::Label kC = 3;
+const StdArc::Label kOpen = 100;
+const StdArc::Label kClose = 101;
+const StdArc::Label kNonterminal = 1000;
+
+// Builds the PDT for S -> a S b | c, with weight 1 per recursion, so that
+// a^n c b^n has weight n and stack depth n.
+void MakePdt(VectorFst<StdArc> *pdt,
+             std::vector<std::pair<StdArc::Label, StdArc::Label>> *parens) {
+  for (int s = 0; s < 4; ++s) pdt->AddState();
+  pdt->SetStart(0);
+  pdt->AddArc(0, StdArc(kC, kC, 0.0, 2));
+  pdt->AddArc(0, StdArc(kA, kA, 1.0, 1));
+  pdt->AddArc(1, StdArc(kOpen, kOpen, 0.0, 0));
+  pdt->AddArc(2, StdArc(kClose, kClose, 0.0, 3));
+  pdt->AddArc(3, StdArc(kB, kB, 0.0, 2));
+  pdt->SetFinal(2, 0.0);
+  parens->clear();
+  parens->push_back(std::make_pair(kOpen, kClose));
+}
+
+// Builds the acceptor of a^n c b^n, for n = 0, ..., DEPTH.
+void MakeExpected(int depth, VectorFst<StdArc> *fst) {
+  fst->DeleteStates();
+  StdArc::StateId start = fst->AddState();
+  fst->SetStart(start);
+  for (int n = 0; n <= depth; ++n) {
+    StdArc::StateId s = start;
+    for (int i = 0; i < 2 * n + 1; ++i) {
+      StdArc::Label label = i < n ? kA : (i == n ? kC : kB);
+      StdArc::StateId d = fst->AddState();
+      fst->AddArc(s, StdArc(label, label, i == 0 && n > 0 ? n : 0.0, d));
+      s = d;
+    }
+    fst->SetFinal(s, 0.0);
+  }
+}
+
+// Expands with OPTS and checks that the result is equivalent to the
+// recursion up to DEPTH.
+void TestExpand(const Fst<StdArc> &pdt,
+                const std::vector<std::pair<StdArc::Label, StdArc::Label>>
+                    &parens,
+                const PdtExpandOptions<StdArc> &opts, int depth) {
+  VectorFst<StdArc> ofst;
+  Expand(pdt, parens, &ofst, opts);
+  CHECK(!ofst.Properties(kError, false));
+  RmEpsilon(&ofst);
+  VectorFst<StdArc> expected;
+  MakeExpected(depth, &expected);
+  VectorFst<StdArc> dofst;
+  Determinize(ofst, &dofst);
+  VectorFst<StdArc> dexpected;
+  Determinize(expected, &dexpected);
+  CHECK(Equivalent(dofst, dexpected));
+}
+
+// Checks the search data table used by PdtShortestPath against std::map
+// under random insertions and erasures.
+void TestSearchTable() {
+  const int kNumKeys = 512;
+  PdtSearchTable<int, int, std::hash<int>> table;
+  std::map<int, int> expected;
+  for (int i = 0; i < 64 * kNumKeys; ++i) {
+    const int key = rand() % kNumKeys;
+    if (rand() % 3 == 0) {
+      table.Erase(key);
+      expected.erase(key);
+    } else {
+      *table.FindOrInsert(key) = i;
+      expected[key] = i;
+    }
+    if (i % kNumKeys == 0) {
+      CHECK_EQ(table.Size(), expected.size());
+      for (int k = 0; k < kNumKeys; ++k) {
+        const int *data = table.Find(k);
+        auto it = expected.find(k);
+        if (it == expected.end()) {
+          CHECK(data == nullptr);
+        } else {
+          CHECK(data != nullptr);
+          CHECK_EQ(*data, it->second);
+        }
+      }
+    }
+  }
+}
+
+TropicalWeight RandomWeight() { return TropicalWeight(rand() % 64 / 4.0); }
+
+// Checks PdtStack with NUM_PARENS parens against std::map. Pushing the
+// parens on a few stacks in random order grows their child blocks, whose
+// freed predecessors are reused by the next stacks. With more than 64 parens
+// the children are kept in the hash map instead.
+void TestPdtStack(int num_parens) {
+  typedef PdtStack<StdArc::StateId, StdArc::Label> Stack;
+  std::vector<std::pair<StdArc::Label, StdArc::Label>> parens;
+  for (int i = 0; i < num_parens; ++i) {
+    parens.push_back(std::make_pair(kOpen + 2 * i, kOpen + 2 * i + 1));
+  }
+  Stack stack(parens);
+  // Child stack ID by parent stack ID and paren ID.
+  std::map<std::pair<Stack::StackId, int>, Stack::StackId> children;
+  std::vector<Stack::StackId> parents(1, 0);
+  for (size_t p = 0; p < parents.size() && p < 4; ++p) {
+    std::vector<int> order(num_parens);
+    for (int i = 0; i < num_parens; ++i) order[i] = i;
+    for (int i = num_parens - 1; i > 0; --i) {
+      std::swap(order[i], order[rand() % (i + 1)]);
+    }
+    for (const int i : order) {
+      const Stack::StackId child = stack.Find(parents[p], parens[i].first);
+      CHECK_EQ(child, stack.NumStacks() - 1);
+      children[std::make_pair(parents[p], i)] = child;
+      parents.push_back(child);
+    }
+  }
+  CHECK_EQ(stack.NumStacks(), children.size() + 1);
+  for (const auto &kv : children) {
+    const Stack::StackId parent = kv.first.first;
+    const int i = kv.first.second;
+    const Stack::StackId child = kv.second;
+    CHECK_EQ(stack.Find(parent, parens[i].first), child);
+    CHECK_EQ(stack.Top(child), i);
+    CHECK_EQ(stack.Pop(child), parent);
+    CHECK_EQ(stack.Find(child, parens[i].second), parent);
+    const int j = (i + 1) % num_parens;
+    CHECK_EQ(stack.Find(child, parens[j].second), -1);
+    CHECK_EQ(stack.Find(child, kA), child);
+  }
+  CHECK_EQ(stack.NumStacks(), children.size() + 1);
+}
+
+// Checks that a copy of an MPdtStack finds the same stack IDs as the original,
+// also after the original is destroyed, and that both can be destroyed.
+void TestMPdtStack() {
+  typedef MPdtStack<StdArc::StateId, StdArc::Label> Stack;
+  const int kNumParens = 8;
+  std::vector<std::pair<StdArc::Label, StdArc::Label>> parens;
+  std::vector<int> assignments;
+  for (int i = 0; i < kNumParens; ++i) {
+    parens.push_back(std::make_pair(kOpen + 2 * i, kOpen + 2 * i + 1));
+    assignments.push_back(i % 2 + 1);
+  }
+  std::unique_ptr<Stack> stack(new Stack(parens, assignments));
+  std::vector<Stack::StackId> ids;
+  Stack::StackId id = 0;
+  for (int i = 0; i < kNumParens; ++i) {
+    id = stack->Find(id, parens[i].first);
+    CHECK_GT(id, 0);
+    ids.push_back(id);
+  }
+  std::unique_ptr<Stack> copy(new Stack(*stack));
+  CHECK_EQ(copy->NumStacks(), stack->NumStacks());
+  for (int i = kNumParens - 1; i >= 0; --i) {
+    CHECK_EQ(copy->Top(ids[i]), stack->Top(ids[i]));
+    const Stack::StackId parent = i > 0 ? ids[i - 1] : 0;
+    CHECK_EQ(copy->Find(ids[i], parens[i].second),
+             stack->Find(ids[i], parens[i].second));
+    CHECK_EQ(copy->Find(parent, parens[i].first), ids[i]);
+  }
+  const Stack::StackId pushed = stack->Find(0, parens[1].first);
+  stack.reset();
+  CHECK_EQ(copy->Find(0, parens[1].first), pushed);
+  CHECK_EQ(copy->Find(pushed, parens[1].second), 0);
+  copy.reset();
+}
+
+// Builds a random cyclic acceptor for nonterminal I of NUM_NONTERMINALS. The
+// nonterminals form a binary tree, nonterminal I calling 2I + 1 and 2I + 2
+// once each, so that the stack of the replaced PDT is bounded.
+void MakeNonterminal(int i, int num_nonterminals, VectorFst<StdArc> *fst) {
+  const int kNumStates = 12;
+  for (int s = 0; s < kNumStates; ++s) fst->AddState();
+  fst->SetStart(0);
+  fst->SetFinal(kNumStates - 1, RandomWeight());
+  for (int s = 0; s < kNumStates; ++s) {
+    if (s + 1 < kNumStates) {
+      fst->AddArc(s, StdArc(kA, kA, RandomWeight(), s + 1));
+    }
+    for (int j = 0; j < 2; ++j) {
+      const StdArc::Label label = kA + rand() % 3;
+      fst->AddArc(s, StdArc(label, label, RandomWeight(), rand() % kNumStates));
+    }
+  }
+  for (int child = 2 * i + 1; child <= 2 * i + 2; ++child) {
+    if (child >= num_nonterminals) break;
+    const StdArc::Label label = kNonterminal + child;
+    fst->AddArc(rand() % kNumStates,
+                StdArc(label, label, RandomWeight(), rand() % kNumStates));
+  }
+}
+
+// Builds a random PDT with a bounded stack by replacing NUM_NONTERMINALS
+// random nonterminals.
+void MakeRandomPdt(int num_nonterminals, VectorFst<StdArc> *pdt,
+                   std::vector<std::pair<StdArc::Label, StdArc::Label>>
+                       *parens) {
+  std::vector<std::unique_ptr<VectorFst<StdArc>>> fsts;
+  std::vector<std::pair<StdArc::Label, const Fst<StdArc> *>> fst_array;
+  for (int i = 0; i < num_nonterminals; ++i) {
+    fsts.emplace_back(new VectorFst<StdArc>());
+    MakeNonterminal(i, num_nonterminals, fsts.back().get());
+    fst_array.emplace_back(kNonterminal + i, fsts.back().get());
+  }
+  Replace(fst_array, pdt, parens, kNonterminal);
+}
+
+// Checks that the shortest path of a random PDT with NUM_NONTERMINALS
+// nonterminals (and as many start states) has the weight of the shortest
+// path of its expansion, and that it is a path of the expansion. With more
+// than 16 start states, the search data is kept in the hash table, whose
+// entries are erased by the path GC.
+void TestShortestPath(int num_nonterminals) {
+  VectorFst<StdArc> pdt;
+  std::vector<std::pair<StdArc::Label, StdArc::Label>> parens;
+  MakeRandomPdt(num_nonterminals, &pdt, &parens);
+
+  VectorFst<StdArc> pdt_path;
+  ShortestPath(pdt, parens, &pdt_path);
+  CHECK(!pdt_path.Properties(kError, false));
+
+  VectorFst<StdArc> expanded;
+  Expand(pdt, parens, &expanded);
+  VectorFst<StdArc> path;
+  ShortestPath(expanded, &path);
+  const TropicalWeight weight = ShortestDistance(path);
+  CHECK(weight != TropicalWeight::Zero());
+  CHECK(ApproxEqual(ShortestDistance(pdt_path), weight));
+
+  ArcSort(&expanded, ILabelCompare<StdArc>());
+  ComposeFst<StdArc> compose(pdt_path, expanded);
+  CHECK(ShortestDistance(compose) != TropicalWeight::Zero());
+}
+
+// Returns the number of states and arcs of the connected expansion of the
+// PDT, i.e., of the states and arcs on its successful paths.
+std::pair<StdArc::StateId, size_t> ExpandedSize(
+    const Fst<StdArc> &pdt,
+    const std::vector<std::pair<StdArc::Label, StdArc::Label>> &parens) {
+  VectorFst<StdArc> expanded;
+  Expand(pdt, parens, &expanded);
+  CHECK(!expanded.Properties(kError, false));
+  size_t narcs = 0;
+  for (StateIterator<VectorFst<StdArc>> siter(expanded); !siter.Done();
+       siter.Next()) {
+    narcs += expanded.NumArcs(siter.Value());
+  }
+  return std::make_pair(expanded.NumStates(), narcs);
+}
+
+// Checks that composition with open-paren lookahead keeps the successful
+// paths of the composition without it, with the PDT on either side of a random
+// acceptor sorted on the matching side. The outputs are not connected, so
+// that the states the lookahead prunes are not trimmed from both.
+void TestCompose(int num_nonterminals) {
+  VectorFst<StdArc> pdt;
+  std::vector<std::pair<StdArc::Label, StdArc::Label>> parens;
+  MakeRandomPdt(num_nonterminals, &pdt, &parens);
+  const int kNumStates = 4;
+  VectorFst<StdArc> fst;
+  for (int s = 0; s < kNumStates; ++s) fst.AddState();
+  fst.SetStart(0);
+  for (int s = 0; s < kNumStates; ++s) {
+    if (rand() % 2) fst.SetFinal(s, RandomWeight());
+    for (int j = rand() % 5; j > 0; --j) {
+      const StdArc::Label label = kA + rand() % 3;
+      fst.AddArc(s, StdArc(label, label, RandomWeight(), rand() % kNumStates));
+    }
+  }
+  ArcSort(&fst, ILabelCompare<StdArc>());
+  VectorFst<StdArc> ofst;
+  VectorFst<StdArc> lookahead_ofst;
+  Compose(pdt, parens, fst, &ofst, PdtComposeOptions(false));
+  Compose(pdt, parens, fst, &lookahead_ofst,
+          PdtComposeOptions(false, PAREN_FILTER, true));
+  CHECK_LE(lookahead_ofst.NumStates(), ofst.NumStates());
+  CHECK(ExpandedSize(lookahead_ofst, parens) == ExpandedSize(ofst, parens));
+
+  ArcSort(&fst, OLabelCompare<StdArc>());
+  Compose(fst, pdt, parens, &ofst, PdtComposeOptions(false));
+  Compose(fst, pdt, parens, &lookahead_ofst,
+          PdtComposeOptions(false, PAREN_FILTER, true));
+  CHECK_LE(lookahead_ofst.NumStates(), ofst.NumStates());
+  CHECK(ExpandedSize(lookahead_ofst, parens) == ExpandedSize(ofst, parens));
+}
+
+}  // namespace
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  using fst::PdtExpandOptions;
+  using fst::StdArc;
+  using fst::TropicalWeight;
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  fst::VectorFst<StdArc> pdt;
+  std::vector<std::pair<StdArc::Label, StdArc::Label>> parens;
+  fst::MakePdt(&pdt, &parens);
+
+  for (int depth = 0; depth <= FLAGS_max_depth; ++depth) {
+    // The threshold keeps exactly the paths with weight at most 'depth'.
+    TropicalWeight threshold(depth + 0.5);
+    VLOG(1) << "Check best-first expansion at depth " << depth;
+    fst::TestExpand(pdt, parens,
+                    PdtExpandOptions<StdArc>(true, false, threshold, true),
+                    depth);
+
+    VLOG(1) << "Check best-first expansion with max stack depth " << depth;
+    fst::TestExpand(pdt, parens,
+                    PdtExpandOptions<StdArc>(true, false,
+                                             TropicalWeight(FLAGS_max_depth +
+                                                            0.5),
+                                             true, depth),
+                    depth);
+  }
+
+  srand(FLAGS_seed);
+  VLOG(1) << "Check search data table";
+  fst::TestSearchTable();
+  VLOG(1) << "Check paren stack with bitmap-indexed children";
+  fst::TestPdtStack(64);
+  VLOG(1) << "Check paren stack with hashed children";
+  fst::TestPdtStack(65);
+  VLOG(1) << "Check copied multi-stack paren stack";
+  fst::TestMPdtStack();
+  for (int i = 0; i < FLAGS_repeat; ++i) {
+    VLOG(1) << "Check shortest path with dense search data";
+    fst::TestShortestPath(7);
+    VLOG(1) << "Check shortest path with hashed search data";
+    fst::TestShortestPath(40);
+    VLOG(1) << "Check composition with open-paren lookahead";
+    fst::TestCompose(15);
+  }
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
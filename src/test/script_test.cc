@@ -0,0 +1,175 @@
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for the script layer. Checks that arcs added in bulk
+// through MutableFstClass::AddArcs are exported unchanged by GetArcs, at the
+// precision of the arc type, and that invalid arrays add no arcs. Also checks
+// that Resolve answers repeated lookups from its cache without mixing up
+// operation names or arc types.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <fst/fstlib.h>
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+namespace {
+
+// Adds a three-state chain to FST in bulk and checks GetArcs against it.
+void TestBulkArcs(const string &arc_type) {
+  VectorFstClass fst(arc_type);
+  CHECK_EQ(fst.AddStates(3), 0);
+  CHECK_EQ(fst.NumStates(), 3);
+  // 0.1 is not representable exactly, so a float round trip changes it.
+  const std::vector<int64> states = {0, 0, 1};
+  const std::vector<int64> ilabels = {1, 2, 3};
+  const std::vector<int64> olabels = {4, 5, 6};
+  const std::vector<double> weights = {0.1, 2.5, 0.0};
+  const std::vector<int64> nextstates = {1, 2, 2};
+  CHECK(fst.AddArcs(states, ilabels, olabels, weights, nextstates));
+  CHECK_EQ(fst.NumArcs(0), 2);
+  CHECK_EQ(fst.NumArcs(1), 1);
+
+  std::vector<int64> ostates, oilabels, oolabels, onextstates;
+  std::vector<double> oweights;
+  CHECK(fst.GetArcs(&ostates, &oilabels, &oolabels, &oweights, &onextstates));
+  CHECK(ostates == states);
+  CHECK(oilabels == ilabels);
+  CHECK(oolabels == olabels);
+  CHECK(onextstates == nextstates);
+  for (size_t i = 0; i < weights.size(); ++i) {
+    if (arc_type == Log64Arc::Type()) {
+      CHECK_EQ(oweights[i], weights[i]);
+    } else {
+      CHECK_EQ(oweights[i], static_cast<float>(weights[i]));
+    }
+  }
+
+  // Out-of-range source or destination states and unequal lengths are
+  // rejected without adding any arc.
+  FLAGS_fst_error_fatal = false;
+  CHECK(!fst.AddArcs({0}, {1}, {1}, {}, {3}));
+  CHECK(!fst.AddArcs({0}, {1}, {1}, {}, {-1}));
+  CHECK(!fst.AddArcs({0, 3}, {1, 1}, {1, 1}, {}, {1, 1}));
+  CHECK(!fst.AddArcs({0}, {1, 2}, {1}, {}, {1}));
+  FLAGS_fst_error_fatal = true;
+  CHECK_EQ(fst.NumArcs(0), 2);
+  CHECK_EQ(fst.NumArcs(1), 1);
+  CHECK_EQ(fst.NumArcs(2), 0);
+}
+
+// Operation arguments recording the arc type an operation was instantiated
+// for.
+struct ArcTypeArgs {
+  string arc_type;
+};
+
+template <class Arc>
+void ArcTypeOp(ArcTypeArgs *args) {
+  args->arc_type = Arc::Type();
+}
+
+// Operation package whose register counts its lookups, so that the test can
+// tell cache hits from register lookups. "ArcType" is defined for StdArc and
+// LogArc; "Swapped" maps each of these arc types to the other one.
+struct CountingOperation {
+  typedef ArcTypeArgs Args;
+  typedef void (*OpType)(ArcTypeArgs *args);
+
+  class Register {
+   public:
+    static Register *GetRegister() {
+      static Register *reg = new Register;
+      return reg;
+    }
+
+    OpType GetOperation(const string &op_name, const string &arc_type) {
+      ++lookups_;
+      const bool swapped = op_name == "Swapped";
+      if (!swapped && op_name != "ArcType") return nullptr;
+      if (arc_type == StdArc::Type()) {
+        return swapped ? ArcTypeOp<LogArc> : ArcTypeOp<StdArc>;
+      }
+      if (arc_type == LogArc::Type()) {
+        return swapped ? ArcTypeOp<StdArc> : ArcTypeOp<LogArc>;
+      }
+      return nullptr;
+    }
+
+    int Lookups() const { return lookups_; }
+
+   private:
+    int lookups_ = 0;
+  };
+};
+
+// Resolves OP_NAME for ARC_TYPE, runs it and returns the arc type it was
+// instantiated for.
+string ResolvedArcType(const string &op_name, const string &arc_type) {
+  const auto op = Resolve<CountingOperation>(op_name, arc_type);
+  CHECK(op);
+  ArcTypeArgs args;
+  op(&args);
+  return args.arc_type;
+}
+
+void TestResolveCache() {
+  const auto *reg = CountingOperation::Register::GetRegister();
+  CHECK_EQ(ResolvedArcType("ArcType", StdArc::Type()), StdArc::Type());
+  CHECK_EQ(reg->Lookups(), 1);
+  // The same operation again is answered from the cache.
+  CHECK_EQ(ResolvedArcType("ArcType", StdArc::Type()), StdArc::Type());
+  CHECK_EQ(reg->Lookups(), 1);
+  // A different arc type or operation name is looked up and cached on its own.
+  CHECK_EQ(ResolvedArcType("ArcType", LogArc::Type()), LogArc::Type());
+  CHECK_EQ(reg->Lookups(), 2);
+  CHECK_EQ(ResolvedArcType("Swapped", StdArc::Type()), LogArc::Type());
+  CHECK_EQ(reg->Lookups(), 3);
+  for (int i = 0; i < 2; ++i) {
+    CHECK_EQ(ResolvedArcType("ArcType", StdArc::Type()), StdArc::Type());
+    CHECK_EQ(ResolvedArcType("ArcType", LogArc::Type()), LogArc::Type());
+    CHECK_EQ(ResolvedArcType("Swapped", StdArc::Type()), LogArc::Type());
+  }
+  CHECK_EQ(reg->Lookups(), 3);
+  // Failed lookups return a null handle and are not cached.
+  CHECK(!Resolve<CountingOperation>("ArcType", Log64Arc::Type()));
+  CHECK(!Resolve<CountingOperation>("ArcType", Log64Arc::Type()));
+  CHECK_EQ(reg->Lookups(), 5);
+
+  // Operations in a real register resolve to the instantiation for the arc
+  // type asked for, also when resolved again.
+  for (int i = 0; i < 2; ++i) {
+    for (const auto &arc_type : {StdArc::Type(), LogArc::Type()}) {
+      ArcTypeArgs args;
+      Apply<Operation<ArcTypeArgs>>("ArcTypeOp", arc_type, &args);
+      CHECK_EQ(args.arc_type, arc_type);
+    }
+  }
+}
+
+REGISTER_FST_OPERATION(ArcTypeOp, StdArc, ArcTypeArgs);
+REGISTER_FST_OPERATION(ArcTypeOp, LogArc, ArcTypeArgs);
+
+}  // namespace
+}  // namespace script
+}  // namespace fst
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  VLOG(1) << "Check bulk arcs with single-precision weights";
+  fst::script::TestBulkArcs(fst::StdArc::Type());
+  VLOG(1) << "Check bulk arcs with double-precision weights";
+  fst::script::TestBulkArcs(fst::Log64Arc::Type());
+  VLOG(1) << "Check resolved operation cache";
+  fst::script::TestResolveCache();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}